@@ -0,0 +1,151 @@
+/****************************************
+ * AntColonySystem.cu                   *
+ * Peter Ahrens                         *
+ * Performs specific ACS procedures     *
+ ****************************************/
+
+#include "AntColonySystem.h"
+//constructor: Nothing is allocated, since the rules only use the colony's scratch. AntSystem sets the defaults.
+template <typename Base>
+colonySystem<Base>::colonySystem(thrust::device_vector<float>& newDistances, float* newXcoords, float* newYcoords, int newNumCities, int newNumAnts)
+  : Base(newDistances, newXcoords, newYcoords, newNumCities, newNumAnts)
+{
+}
+
+template <typename Base>
+const char* colonySystem<Base>::name()
+{
+  return "ACS";
+}
+
+//rulesMemory: Returns 0. The rules lay pheromone through the colony's scratch buffers, which estimateMemory already counts.
+template <typename Base>
+size_t colonySystem<Base>::rulesMemory(int numCities, int numAnts, int ranks)
+{
+  return 0;
+}
+
+//resetRules: Restores the default q0, kept as the colony's exploitation, and xi.
+template <typename Base>
+void colonySystem<Base>::resetRules()
+{
+  exploitation = ACS_Q0;
+  xi = ACS_XI;
+}
+
+//configureRules: Takes q0 from -q0 and xi from -xi, leaving the defaults for any that are missing.
+template <typename Base>
+void colonySystem<Base>::configureRules(int argc, char* argv[])
+{
+  for(int i = 0; i < argc;i++){
+    if (std::string(argv[i]) == "-q0"){
+      setQ0(atof(argv[i+1]));
+    }
+    if (std::string(argv[i]) == "-xi"){
+      setXi(atof(argv[i+1]));
+    }
+  }
+}
+
+//computeParameters: Gives the colony candidate lists if it has none, which also makes it build its tours with the fused construction, where q0 is drawn.
+//Then computes the initial pheromone level, 1/(numCities*greedy length), as described by Marco Dorigo.
+template <typename Base>
+void colonySystem<Base>::computeParameters()
+{
+  if(numCandidates <= 0){
+    numCandidates = ACS_CANDIDATES;
+  }
+  initialPheromone = 1.0f / (numCities * greedyDistance());
+}
+
+//updatePheromones: Runs the local update, then the global update. Nothing evaporates everywhere, so the levels are never rescaled.
+//The ants build their tours at once, so the local update comes after construction rather than after each step, and each edge is moved once however many ants took it.
+template <typename Base>
+void colonySystem<Base>::updatePheromones()
+{
+  //local update: the candidate edges the ants took move towards the initial level
+  int numEdges = computeCandidateEdges(antTours,ACInt2);
+  blendPheromones(ACInt2,numEdges,1.0f-xi,initialPheromone);
+  //global update: the edges of the global best tour evaporate and gain pheromone
+  computeEdges(globBestTour,ACInt);
+  numEdges = numCities;
+  if(matrixFree){
+    //the edges off the candidate lists all share the spare slot, which is left alone
+    numEdges = thrust::remove_if(exec,
+				 ACInt.begin(),
+				 ACInt.begin() + numCities,
+				 isX(numCities * numCandidates)) - ACInt.begin();
+  }
+  blendPheromones(ACInt,numEdges,1.0f-rho,1.0f/globBestDist);
+}
+
+template <typename Base>
+void colonySystem<Base>::setQ0(float newQ0)
+{
+  exploitation = newQ0;
+}
+
+template <typename Base>
+void colonySystem<Base>::setXi(float newXi)
+{
+  xi = newXi;
+}
+
+template <typename Base>
+float colonySystem<Base>::getQ0()
+{
+  return exploitation;
+}
+
+template <typename Base>
+float colonySystem<Base>::getXi()
+{
+  return xi;
+}
+
+template <typename Base>
+int colonySystem<Base>::getRanks()
+{
+  return 0;
+}
+
+template <typename Base>
+void colonySystem<Base>::printRules()
+{
+}
+
+template <typename Base>
+void colonySystem<Base>::resizeRules()
+{
+}
+
+//The colonies Setup picks from, as in Colony.cu. AntSystem is defined in its header, so only the rules are instantiated here.
+template class colonySystem<Colony<int,float,deviceBackend> >;
+template class colonySystem<Colony<unsigned short,float,deviceBackend> >;
+template class colonySystem<Colony<int,compactFloat,deviceBackend> >;
+template class colonySystem<Colony<unsigned short,compactFloat,deviceBackend> >;
+#ifdef HOST_BACKENDS
+template class colonySystem<Colony<int,float,cppBackend> >;
+template class colonySystem<Colony<unsigned short,float,cppBackend> >;
+template class colonySystem<Colony<int,compactFloat,cppBackend> >;
+template class colonySystem<Colony<unsigned short,compactFloat,cppBackend> >;
+template class colonySystem<Colony<int,float,ompBackend> >;
+template class colonySystem<Colony<unsigned short,float,ompBackend> >;
+template class colonySystem<Colony<int,compactFloat,ompBackend> >;
+template class colonySystem<Colony<unsigned short,compactFloat,ompBackend> >;
+template class colonySystem<Colony<int,float,tbbBackend> >;
+template class colonySystem<Colony<unsigned short,float,tbbBackend> >;
+template class colonySystem<Colony<int,compactFloat,tbbBackend> >;
+template class colonySystem<Colony<unsigned short,compactFloat,tbbBackend> >;
+#endif
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
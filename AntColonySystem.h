@@ -0,0 +1,67 @@
+/****************************************
+ * AntColonySystem.h                    *
+ * Peter Ahrens                         *
+ * Performs specific ACS procedures     *
+ ****************************************/
+
+#ifndef ANTCOLONYSYSTEM_H
+#define ANTCOLONYSYSTEM_H
+#include "AntSystem.h"
+
+//Ant Colony System Values
+#define ACS_Q0 0.9f // Default chance that an ant takes its most probable candidate outright.
+#define ACS_XI 0.1f // Default share of the initial level a taken edge moves towards in the local update.
+#define ACS_CANDIDATES 15 // Length of the candidate lists if none were asked for, since the local update only covers candidate edges.
+
+//colonySystem: The rules of an Ant Colony System, for AntSystem. Ants take their most probable candidate with chance q0 and draw by roulette otherwise.
+//Every candidate edge the ants took then moves towards the initial level, which keeps them from all taking the same tour, and only the edges of the global best tour evaporate and gain pheromone.
+template <typename Base>
+class colonySystem : public Base{
+ public:
+  colonySystem(thrust::device_vector<float>& newDistances, float* newXcoords, float* newYcoords, int newNumCities, int newNumAnts);
+  static const char* name(); // ACS.
+  static size_t rulesMemory(int numCities, int numAnts, int ranks); // 0, since the rules only use the colony's scratch.
+  void setQ0(float newQ0);
+  void setXi(float newXi);
+  float getQ0();
+  float getXi();
+ protected:
+  void resetRules(); // Restores the default q0 and xi.
+  void configureRules(int argc, char* argv[]); // Takes q0 from -q0 and xi from -xi.
+  void computeParameters(); // Makes sure there are candidate lists, then computes the initial pheromone level.
+  void updatePheromones(); // Runs the local update on every candidate edge the ants took, then the global update on the global best tour.
+  int getRanks(); // 0, since only the global best tour lays pheromone.
+  void printRules(); // Nothing, since the rules use the colony's scratch.
+  void resizeRules(); // Nothing, since the rules use the colony's scratch.
+  //the Colony members used here, since names are not looked up in a base that depends on the template parameters
+  using Base::numCities;
+  using Base::numCandidates;
+  using Base::matrixFree;
+  using Base::rho;
+  using Base::initialPheromone;
+  using Base::exploitation;
+  using Base::globBestDist;
+  using Base::antTours;
+  using Base::globBestTour;
+  using Base::ACInt;
+  using Base::ACInt2;
+  using Base::computeEdges;
+  using Base::computeCandidateEdges;
+  using Base::blendPheromones;
+  using Base::greedyDistance;
+  using Base::exec;
+  float xi;
+};
+
+#endif
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
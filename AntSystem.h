@@ -0,0 +1,159 @@
+/****************************************
+ * AntSystem.h                          *
+ * Peter Ahrens                         *
+ * Runs a Colony under variant rules    *
+ ****************************************/
+
+#ifndef ANTSYSTEM_H
+#define ANTSYSTEM_H
+#include "Colony.h"
+
+//AntSystem: A Colony run under the pheromone rules of one ACO variant. Rules is a class template that takes the Colony it extends as its base, such as rankBased, maxMin or colonySystem, and provides:
+//name(), the variant's name in checkpoints. resetRules(), which restores the variant's defaults. configureRules(argc, argv), which applies the variant's own options.
+//computeParameters(), which sets initialPheromone and may change the modes before initialize lays the colony out. updatePheromones(), which lays pheromone on the measured tours.
+//getRanks(), which is recorded in checkpoints. printRules(), which prints the variant's buffers. resizeRules(), which sizes the variant's buffers once edits have changed the number of cities.
+//A static rulesMemory(numCities, numAnts, ranks), which estimateMemory adds for the variant's buffers.
+//The rules are bound at compile time, so a forage makes no virtual calls. Setup picks the variant at run time by which AntSystem it builds.
+template <template <typename> class Rules, typename City = int, typename Level = float, typename Backend = deviceBackend>
+class AntSystem : public Rules<Colony<City,Level,Backend> >{
+ public:
+  AntSystem(thrust::device_vector<float>& newDistances, float* newXcoords, float* newYcoords, int newNumCities, int newNumAnts); // Allocates memory and sets the defaults of the colony and the rules.
+  void reset(float* newXcoords, float* newYcoords); // Runs the Colony reset and restores the defaults of the rules, for a new instance of the same size.
+  void initialize(); // Computes the parameters of the rules, then runs the Colony initialize.
+  void forage(); // Main ACO loop. Builds and measures the tours, then lays pheromone by the rules.
+  void configure(int argc, char* argv[]); // Applies the parameter options given on the command line, those of the rules last.
+  void getState(colonyState& state); // Runs Colony getState, then records the variant and its ranks.
+  bool setState(const colonyState& state); // Checks that the variant and its ranks match, then runs Colony setState.
+  void printMemory(); // Prints the buffers of the rules, then runs Colony printMemory.
+  void finishEdits(); // Runs Colony finishEdits, then sizes the buffers of the rules, if an edit changed the number of cities.
+};
+
+//constructor: Allocates memory and sets the defaults of the colony, then of the rules.
+template <template <typename> class Rules, typename City, typename Level, typename Backend>
+AntSystem<Rules,City,Level,Backend>::AntSystem(thrust::device_vector<float>& newDistances, float* newXcoords, float* newYcoords, int newNumCities, int newNumAnts)
+  : Rules<Colony<City,Level,Backend> >(newDistances, newXcoords, newYcoords, newNumCities, newNumAnts)
+{
+  this->resetRules();
+}
+
+//reset: Runs the Colony reset, then restores the defaults of the rules, which computeParameters may have changed for the last instance.
+template <template <typename> class Rules, typename City, typename Level, typename Backend>
+void AntSystem<Rules,City,Level,Backend>::reset(float* newXcoords, float* newYcoords)
+{
+  Colony<City,Level,Backend>::reset(newXcoords, newYcoords);
+  this->resetRules();
+}
+
+//initialize: Computes the parameters of the rules first, since they may change the modes the Colony initialize lays the colony out for.
+template <template <typename> class Rules, typename City, typename Level, typename Backend>
+void AntSystem<Rules,City,Level,Backend>::initialize()
+{
+  this->computeParameters();
+  Colony<City,Level,Backend>::initialize();
+}
+
+//forage: Main ACO loop. Builds, improves and measures the tours, then lays pheromone by the rules, which refresh the probabilities of the edges they change.
+template <template <typename> class Rules, typename City, typename Level, typename Backend>
+void AntSystem<Rules,City,Level,Backend>::forage()
+{
+  finishEdits(); //in case the last edits were left unfinished
+  if(this->profiler){
+    this->profiler->startIteration();
+  }
+  this->buildTours();
+  this->profileStart(PHASE_UPDATE);
+  this->updatePheromones();
+  this->profileStop(PHASE_UPDATE, 16.0*this->numAnts*this->numCities); //dominated by finding the edges of every tour
+  if(this->profiler){
+    this->profiler->endIteration();
+  }
+}
+
+//configure: Applies the parameter options given on the command line, leaving the defaults for any that are missing. The rules apply theirs last.
+template <template <typename> class Rules, typename City, typename Level, typename Backend>
+void AntSystem<Rules,City,Level,Backend>::configure(int argc, char* argv[])
+{
+  for(int i = 0; i < argc;i++){
+    if (std::string(argv[i]) == "-b"){
+      this->setBeta(atof(argv[i+1]));
+    }
+    if (std::string(argv[i]) == "-r"){
+      this->setRho(atof(argv[i+1]));
+    }
+    if (std::string(argv[i]) == "-seed"){
+      this->setSeed(strtoul(argv[i+1],NULL,10));
+    }
+    if (std::string(argv[i]) == "-ls"){
+      this->setLocalSearch(true);
+    }
+    if (std::string(argv[i]) == "-fused"){
+      this->setFused(true);
+    }
+    if (std::string(argv[i]) == "-cand"){
+      this->setNumCandidates(atoi(argv[i+1]));
+    }
+    if (std::string(argv[i]) == "-initTour"){
+      this->setInitialTour(std::string(argv[i+1]) == "curve" ? TOUR_CURVE : TOUR_NEAREST);
+    }
+    if (std::string(argv[i]) == "-seedTour"){
+      this->setSeedTour(true);
+    }
+  }
+  this->configureRules(argc, argv);
+}
+
+//getState: Runs Colony getState, then records the variant and its ranks, which the pheromones were laid with.
+template <template <typename> class Rules, typename City, typename Level, typename Backend>
+void AntSystem<Rules,City,Level,Backend>::getState(colonyState& state)
+{
+  Colony<City,Level,Backend>::getState(state);
+  strncpy(state.header.variant, this->name(), sizeof(state.header.variant));
+  state.header.ranks = this->getRanks();
+}
+
+//setState: Refuses a state saved by another variant or with other ranks, then runs Colony setState.
+template <template <typename> class Rules, typename City, typename Level, typename Backend>
+bool AntSystem<Rules,City,Level,Backend>::setState(const colonyState& state)
+{
+  if(strncmp(state.header.variant, this->name(), sizeof(state.header.variant)) != 0){
+    cout << "Checkpoint was taken by " << std::string(state.header.variant, strnlen(state.header.variant, sizeof(state.header.variant))) << ", not " << this->name() << "\n";
+    return false;
+  }
+  if(state.header.ranks != this->getRanks()){
+    cout << "Checkpoint was taken with w " << state.header.ranks << ", not " << this->getRanks() << "\n";
+    return false;
+  }
+  return Colony<City,Level,Backend>::setState(state);
+}
+
+//printMemory: Prints the buffers of the rules, then runs Colony printMemory.
+template <template <typename> class Rules, typename City, typename Level, typename Backend>
+void AntSystem<Rules,City,Level,Backend>::printMemory()
+{
+  this->printRules();
+  Colony<City,Level,Backend>::printMemory();
+}
+
+//finishEdits: Runs Colony finishEdits, then sizes the buffers of the rules for the new number of cities. The rules keep their parameters, since a few cities hardly change the initial pheromone level.
+template <template <typename> class Rules, typename City, typename Level, typename Backend>
+void AntSystem<Rules,City,Level,Backend>::finishEdits()
+{
+  if(!this->resized){
+    return;
+  }
+  Colony<City,Level,Backend>::finishEdits();
+  this->resizeRules();
+}
+
+#endif
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
@@ -0,0 +1,306 @@
+/****************************************
+ * AntsBench.cpp                        *
+ * Peter Ahrens                         *
+ * Benchmarks the colony on one backend *
+ ****************************************/
+
+//Usage: AntsBench [-out file] [-dir directory] [-maxCities n] [-iter n] [-maxTime s] [-m ants] [-gap fraction] [-ref file] [-commit id] [-compact] [-wideCities] [colony options]
+//Writes seeded uniform, clustered and grid EUC_2D instances of 100 to 20000 cities, runs a fixed seed colony on each and appends one CSV row per instance to the results file.
+//Only the rank-based variant is benchmarked, so -aco is not taken and the MMAS and ACS sources are not built in.
+//Each instance runs in its own process, so the peak RSS of a row is that instance's alone. Build it once per backend with make bench, which runs all of them into the same file.
+
+#include "RankBasedAntSystem.h"
+#include "TSPReader.h"
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+//Bench Values
+#define BENCH_SIDE 1000000 // Instances lie in a square of this side.
+#define BENCH_SPACING 100 // Distance between neighbouring grid cities.
+#define BENCH_DENSE_LIMIT 5000 // Larger instances run matrix-free, since the dense matrices would not fit beside the pheromones.
+#define BENCH_SEED 1 // Seed of both the instances and the colonies.
+#define BHH_CONSTANT 0.7124 // Optimal tours of n uniform cities in area A tend to BHH_CONSTANT * sqrt(n * A).
+#define GREEDY_EXCESS 1.25 // Typical ratio of a greedy tour to an optimal one.
+
+//benchInstance: One generated instance with an estimate of its optimal tour length.
+struct benchInstance
+{
+  string kind;
+  string name;
+  int numCities;
+  double reference;
+  string referenceSource; // "exact", "bhh", "greedy" or "file", how reference was found.
+};
+
+//nextRandom: Steps a 64 bit linear congruential generator and returns a number in [0, 1). Unlike rand(), it gives the same instances on every machine.
+static double nextRandom(unsigned long long& state)
+{
+  state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//writeInstance: Writes a uniform, clustered or grid EUC_2D instance with about numCities cities and fills in its name, size and reference length.
+//Grids round numCities to an even number of rows, so a boustrophedon tour of numCities * BENCH_SPACING is optimal.
+static bool writeInstance(string dir, string kind, int numCities, benchInstance& instance)
+{
+  unsigned long long state = BENCH_SEED + numCities;
+  vector<double> X, Y;
+  instance.kind = kind;
+  instance.referenceSource = "greedy";
+  if(kind == "grid"){
+    int rows = (int)(sqrt((double)numCities) + 0.5);
+    rows += rows % 2;
+    int cols = numCities / rows;
+    for(int r = 0; r < rows; r++){
+      for(int c = 0; c < cols; c++){
+	X.push_back(c * BENCH_SPACING);
+	Y.push_back(r * BENCH_SPACING);
+      }
+    }
+    instance.reference = (double)rows * cols * BENCH_SPACING;
+    instance.referenceSource = "exact";
+  }else if(kind == "clustered"){
+    int numClusters = max(1, numCities / 100);
+    double spread = BENCH_SIDE / (4 * sqrt((double)numClusters));
+    vector<double> CX, CY;
+    for(int k = 0; k < numClusters; k++){
+      CX.push_back(nextRandom(state) * BENCH_SIDE);
+      CY.push_back(nextRandom(state) * BENCH_SIDE);
+    }
+    for(int i = 0; i < numCities; i++){
+      int k = (int)(nextRandom(state) * numClusters);
+      //Box-Muller
+      double radius = spread * sqrt(-2 * log(1 - nextRandom(state)));
+      double angle = 2 * M_PI * nextRandom(state);
+      X.push_back(min((double)BENCH_SIDE, max(0.0, CX[k] + radius * cos(angle))));
+      Y.push_back(min((double)BENCH_SIDE, max(0.0, CY[k] + radius * sin(angle))));
+    }
+    instance.reference = 0; //filled in from the greedy tour once a colony has read it
+  }else{
+    for(int i = 0; i < numCities; i++){
+      X.push_back(nextRandom(state) * BENCH_SIDE);
+      Y.push_back(nextRandom(state) * BENCH_SIDE);
+    }
+    instance.reference = BHH_CONSTANT * sqrt((double)numCities * BENCH_SIDE * BENCH_SIDE);
+    instance.referenceSource = "bhh";
+  }
+  instance.numCities = X.size();
+  instance.name = kind + Comm::intToString(instance.numCities);
+  string filen = dir + "/" + instance.name + ".tsp";
+  FILE* f = fopen(filen.c_str(), "w");
+  if(!f){
+    return false;
+  }
+  fprintf(f, "NAME : %s\nCOMMENT : excellants bench, seed %d\nTYPE : TSP\nDIMENSION : %d\nEDGE_WEIGHT_TYPE : EUC_2D\nNODE_COORD_SECTION\n", instance.name.c_str(), BENCH_SEED, instance.numCities);
+  for(int i = 0; i < instance.numCities; i++){
+    fprintf(f, "%d %.0f %.0f\n", i + 1, X[i], Y[i]);
+  }
+  fprintf(f, "EOF\n");
+  fclose(f);
+  return true;
+}
+
+//backendName: Names the thrust backend this build runs on.
+static string backendName()
+{
+#if THRUST_DEVICE_SYSTEM == THRUST_DEVICE_SYSTEM_CUDA
+  return "CUDA";
+#elif THRUST_DEVICE_SYSTEM == THRUST_DEVICE_SYSTEM_OMP
+  return "OMP";
+#elif THRUST_DEVICE_SYSTEM == THRUST_DEVICE_SYSTEM_TBB
+  return "TBB";
+#else
+  return "CPP";
+#endif
+}
+
+//timestamp: Returns the local date and time, so rows from different runs can be told apart.
+static string timestamp()
+{
+  char buffer[32];
+  time_t seconds = time(0);
+  strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", localtime(&seconds));
+  return buffer;
+}
+
+//runInstance: Solves one instance for maxIter iterations or maxTime seconds with tours stored as City and pheromones as Level, and appends its row to the results file. Runs in the child process of its instance.
+template <typename City, typename Level>
+static bool runInstance(string dir, benchInstance instance, string out, string commit, int m, int maxIter, int maxTime, double gap, int argc, char* argv[])
+{
+  string filen = dir + "/" + instance.name + ".tsp";
+  bool dense = instance.numCities <= BENCH_DENSE_LIMIT;
+  TSPReader t;
+  if(!t.read(&filen[0], dense)){
+    return false;
+  }
+  m = min(m, t.getNumNodes());
+  RankBasedAntSystem<City,Level> antHill(t.getDistances(), t.getXcoords(), t.getYcoords(), t.getNumNodes(), m);
+  Profiler profiler;
+  antHill.configure(argc, argv);
+  antHill.setSeed(BENCH_SEED);
+  antHill.setProfiler(&profiler);
+  double t0 = Profiler::now();
+  antHill.initialize();
+  double t1 = Profiler::now();
+  if(instance.reference <= 0){
+    instance.reference = antHill.getGreedyDistance() / GREEDY_EXCESS;
+  }
+  double toGap = -1;
+  int i = 0;
+  for(bool stopping = false; !stopping;){
+    antHill.forage();
+    i++;
+    double elapsed = Profiler::now() - t1;
+    if(toGap < 0 && antHill.getGlobBestDist() <= instance.reference * (1 + gap)){
+      toGap = elapsed;
+    }
+    if(i >= maxIter || (maxTime != 0 && elapsed > maxTime)){
+      stopping = true;
+    }
+  }
+  double seconds = Profiler::now() - t1;
+  double construction = profiler.getSeconds(PHASE_START) + profiler.getSeconds(PHASE_STEP) + profiler.getSeconds(PHASE_SELECT);
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  ofstream results(out.c_str(), ios_base::out | ios_base::app);
+  if(!results){
+    cout << "Unable to open results file " << out << "\n";
+    return false;
+  }
+  results << timestamp() << "," << commit << "," << backendName() << "," << instance.name << "," << instance.kind << "," << instance.numCities << "," << m << ","
+	  << (dense ? "dense" : "matrix-free") << (sizeof(City) < sizeof(int) ? " short" : "") << (sizeof(Level) < sizeof(float) ? " compact" : "") << "," << antHill.getNumCandidates() << "," << t1 - t0 << "," << i << "," << seconds << "," << i / seconds << ","
+	  << construction * 1e9 / ((double)i * m * instance.numCities) << "," << usage.ru_maxrss << "," << antHill.getGlobBestDist() << ","
+	  << instance.reference << "," << instance.referenceSource << "," << antHill.getGlobBestDist() / instance.reference - 1 << "," << toGap << "\n";
+  cout << std::left << setw(8) << backendName() << setw(16) << instance.name << setw(12) << i / seconds << setw(14) << construction * 1e9 / ((double)i * m * instance.numCities)
+       << setw(12) << usage.ru_maxrss << setw(12) << antHill.getGlobBestDist() / instance.reference - 1 << toGap << "\n" << flush;
+  return true;
+}
+
+//readReferences: Reads "name length" lines, such as best known tour lengths, which replace the estimated references.
+static void readReferences(string filen, map<string, double>& references)
+{
+  ifstream f(filen.c_str());
+  if(!f){
+    cout << "Unable to open reference file " << filen << "\n";
+    return;
+  }
+  string name;
+  double length;
+  while(f >> name >> length){
+    references[name] = length;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  string out = "bench.csv";
+  string dir = "/tmp/excellants-bench";
+  string commit = "unknown";
+  int maxCities = 20000;
+  int maxIter = 20;
+  int maxTime = 60;
+  int m = 32;
+  double gap = 0.05;
+  map<string, double> references;
+  bool compact = false;
+  bool shortCities = true;
+  for(int i = 0; i < argc; i++){
+    if (string(argv[i]) == "-compact"){
+      compact = true;
+    }
+    if (string(argv[i]) == "-wideCities"){
+      shortCities = false;
+    }
+  }
+  for(int i = 0; i + 1 < argc; i++){
+    if (string(argv[i]) == "-out"){
+      out = argv[i+1];
+    }
+    if (string(argv[i]) == "-dir"){
+      dir = argv[i+1];
+    }
+    if (string(argv[i]) == "-commit"){
+      commit = argv[i+1];
+    }
+    if (string(argv[i]) == "-maxCities"){
+      maxCities = atoi(argv[i+1]);
+    }
+    if (string(argv[i]) == "-iter"){
+      maxIter = atoi(argv[i+1]);
+    }
+    if (string(argv[i]) == "-maxTime"){
+      maxTime = atoi(argv[i+1]);
+    }
+    if (string(argv[i]) == "-m"){
+      m = atoi(argv[i+1]);
+    }
+    if (string(argv[i]) == "-gap"){
+      gap = atof(argv[i+1]);
+    }
+    if (string(argv[i]) == "-ref"){
+      readReferences(argv[i+1], references);
+    }
+  }
+  mkdir(dir.c_str(), 0755);
+  ifstream existing(out.c_str());
+  if(!existing || existing.peek() == EOF){
+    ofstream results(out.c_str(), ios_base::out | ios_base::app);
+    results << "Date,Commit,Backend,Instance,Kind,Cities,Ants,Storage,Candidates,Init_Seconds,Iterations,Seconds,Iter_per_s,Construct_ns_per_ant_step,Peak_RSS_KB,Best,Reference,Reference_Source,Gap,Seconds_to_Gap\n";
+  }
+  existing.close();
+  cout << std::left << setw(8) << "Backend" << setw(16) << "Instance" << setw(12) << "Iter/s" << setw(14) << "ns/ant-step" << setw(12) << "RSS(KB)" << setw(12) << "Gap" << "To gap(s)\n";
+  const char* kinds[] = {"uniform", "clustered", "grid"};
+  const int sizes[] = {100, 1000, 5000, 20000};
+  for(int s = 0; s < 4 && sizes[s] <= maxCities; s++){
+    for(int k = 0; k < 3; k++){
+      benchInstance instance;
+      if(!writeInstance(dir, kinds[k], sizes[s], instance)){
+	cout << "Unable to write to " << dir << "\n";
+	return 1;
+      }
+      if(references.count(instance.name)){
+	instance.reference = references[instance.name];
+	instance.referenceSource = "file";
+      }
+      pid_t child = fork();
+      if(child == 0){
+	//the same storage types Setup would pick
+	bool ok;
+	if(compact){
+	  ok = shortCities && instance.numCities <= CITY_SHORT_MAX ? runInstance<unsigned short,compactFloat>(dir, instance, out, commit, m, maxIter, maxTime, gap, argc, argv)
+	    : runInstance<int,compactFloat>(dir, instance, out, commit, m, maxIter, maxTime, gap, argc, argv);
+	}else{
+	  ok = shortCities && instance.numCities <= CITY_SHORT_MAX ? runInstance<unsigned short,float>(dir, instance, out, commit, m, maxIter, maxTime, gap, argc, argv)
+	    : runInstance<int,float>(dir, instance, out, commit, m, maxIter, maxTime, gap, argc, argv);
+	}
+	_exit(ok ? 0 : 1);
+      }
+      int status = 0;
+      if(child < 0 || waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0){
+	cout << "Failed on " << instance.name << "\n";
+      }
+    }
+  }
+  return 0;
+}
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
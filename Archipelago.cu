@@ -0,0 +1,392 @@
+/****************************************
+ * Archipelago.cu                       *
+ * Peter Ahrens                         *
+ * Runs colonies side by side           *
+ ****************************************/
+
+#include "Archipelago.h"
+
+//IslandTask: What the thread of one island needs to find its island.
+struct IslandTask
+{
+  Archipelago* archipelago;
+  int k;
+};
+
+//constructor: Sets defaults. The islands are built by initialize or by each forked process.
+Archipelago::Archipelago(TSPReader& newReader, int newNumIslands, int newNumAnts, int newArgc, char** newArgv)
+  : reader(newReader)
+{
+  numIslands = newNumIslands;
+  numAnts = newNumAnts;
+  argc = newArgc;
+  argv = newArgv;
+  seed = time(NULL);
+  for(int i = 0; i < argc; i++){
+    if (std::string(argv[i]) == "-seed"){
+      seed = strtoul(argv[i+1],NULL,10);
+    }
+  }
+  interval = 10;//default
+  ring = true;
+  globBestDist = std::numeric_limits<float>::max();
+  reps = 0;
+  stopping = false;
+  out = 0;
+  pthread_mutex_init(&lock, NULL);
+}
+
+Archipelago::~Archipelago()
+{
+  for(int k = 0; k < islands.size(); k++){
+    delete islands[k];
+  }
+  pthread_mutex_destroy(&lock);
+}
+
+//setMigration: Sets how many iterations pass between exchanges, 0 for none, and whether tours go round a ring or to every island.
+void Archipelago::setMigration(int newInterval, bool newRing)
+{
+  interval = newInterval;
+  ring = newRing;
+}
+
+//initialize: Builds and initializes every island on this process. They all read the reader's distance matrix, and the later islands reuse the candidate lists and greedy distance of the first.
+void Archipelago::initialize()
+{
+  for(int k = 0; k < numIslands; k++){
+    islands.push_back(buildIsland(k));
+  }
+  reader.updateCache(islands[0]->getCandidates(),islands[0]->getNumCandidates(),islands[0]->getGreedyDistance(),islands[0]->getInitialTour());
+}
+
+//buildIsland: Builds, configures and initializes island k with its own seed.
+RankBasedAntSystem<>* Archipelago::buildIsland(int k)
+{
+  RankBasedAntSystem<>* antHill = new RankBasedAntSystem<>(reader.getDistances(),reader.getXcoords(),reader.getYcoords(),reader.getNumNodes(),numAnts);
+  antHill->configure(argc,argv);
+  antHill->setSeed(seed + k);
+  antHill->setExplicitWeights(reader.getExplicitWeights());
+  if(islands.size() > 0){
+    antHill->setCandidates(islands[0]->getCandidates(),islands[0]->getNumCandidates());
+    antHill->setGreedyDistance(islands[0]->getGreedyDistance());
+  }else{
+    antHill->setCandidates(reader.getCandidates(),reader.getNumCandidates());
+    antHill->setGreedyDistance(reader.getGreedyDistance(antHill->getInitialTour()));
+  }
+  antHill->initialize();
+  return antHill;
+}
+
+//runThreads: Runs every island on its own thread until a stopping condition is met. Island 0 runs on the calling thread and writes the output.
+void Archipelago::runThreads(Writer& O, std::string ACO, int newMaxIter, int newMaxTime, int newMaxReps)
+{
+  out = &O;
+  maxIter = newMaxIter;
+  maxTime = newMaxTime;
+  maxReps = newMaxReps;
+  stopping = false;
+  reps = 0;
+  emigrantTours.resize(numIslands);
+  emigrantDists.resize(numIslands);
+  out->writeHeader(islands[0]->getBeta(),islands[0]->getRho(),numAnts,ACO,reader.getName(),islands[0]->getLocalSearch());
+  startTime = now();
+  pthread_barrier_init(&barrier, NULL, numIslands);
+  std::vector<pthread_t> threads(numIslands);
+  std::vector<IslandTask> tasks(numIslands);
+  for(int k = 1; k < numIslands; k++){
+    tasks[k].archipelago = this;
+    tasks[k].k = k;
+    pthread_create(&threads[k], NULL, islandThread, &tasks[k]);
+  }
+  runIsland(0);
+  for(int k = 1; k < numIslands; k++){
+    pthread_join(threads[k], NULL);
+  }
+  pthread_barrier_destroy(&barrier);
+}
+
+void* Archipelago::islandThread(void* arg)
+{
+  IslandTask* task = (IslandTask*)arg;
+  task->archipelago->runIsland(task->k);
+  return NULL;
+}
+
+//runIsland: The loop run by the thread of island k. Every iteration checks whether the island is done, by reaching maxIter itself or by seeing another island stop the run, and a done island goes straight to an exchange instead of foraging on to the next one.
+//The islands only stop together at an exchange, so that none waits at a barrier the others have left. A done island forages no more while it waits for the rest.
+void Archipelago::runIsland(int k)
+{
+  RankBasedAntSystem<>& antHill = *islands[k];
+  double t2, t3;
+  bool done = false;
+  t3 = now();
+  for(int i = 0; ; i++){
+    if(!done){
+      t2 = t3;
+      antHill.forage();
+      t3 = now();
+      pthread_mutex_lock(&lock);
+      if(k == 0){
+	reps++;
+      }
+      if(antHill.getGlobBestDist() < globBestDist){
+	globBestDist = antHill.getGlobBestDist();
+	globBestTour = antHill.getGlobBestTour();
+	reps = 0;
+      }
+      if(k == 0){
+	out->write(i, antHill.getIterBestDist(), globBestDist, t3 - startTime, t3 - t2, antHill.getLocalSearch() ? antHill.getLocalSearchTime() : -1);
+	if(checkStop(i, t3 - startTime)){
+	  stopping = true;
+	}
+      }
+      done = stopping || (maxIter != 0 && i >= maxIter);
+      pthread_mutex_unlock(&lock);
+    }
+    if(interval > 0 && (done || (i + 1) % interval == 0)){
+      pthread_barrier_wait(&barrier);
+      emigrantTours[k] = antHill.getGlobBestTour();
+      emigrantDists[k] = antHill.getGlobBestDist();
+      bool stop = stopping; //no island forages between the barriers, so all of them read the same value
+      pthread_barrier_wait(&barrier);
+      if(stop){
+	break;
+      }
+      int from = chooseEmigrant(k, emigrantDists);
+      if(from != k){
+	antHill.immigrate(emigrantTours[from], emigrantDists[from]);
+      }
+    }else if(interval <= 0 && done){
+      break;
+    }
+  }
+}
+
+//runProcesses: Forks a process for every island and relays tours between them over pipes until a stopping condition is met. The islands are built in the children, after the fork.
+void Archipelago::runProcesses(Writer& O, std::string ACO, int newMaxIter, int newMaxTime, int newMaxReps)
+{
+  out = &O;
+  maxIter = newMaxIter;
+  maxTime = newMaxTime;
+  maxReps = newMaxReps;
+  reps = 0;
+  int report = interval > 0 ? interval : 10; //without exchanges the children still report their bests this often
+  std::vector<Comm*> comms;
+  std::vector<pid_t> pIDs;
+  std::vector<int> pipes;
+  cout << flush; //the children would write out anything left in the buffer again
+  signal(SIGPIPE, SIG_IGN); //a child that has gone makes send fail instead of ending the parent
+  for(int k = 0; k < numIslands; k++){
+    int parentPipe[] = {-1,-1};  // parent -> child
+    int childPipe[] = {-1,-1};  // child -> parent
+    if ( pipe(parentPipe) < 0  ||  pipe(childPipe) < 0 ){
+      cout << "Failed to create pipe\n";
+      break;
+    }
+    pid_t pID = fork();
+    if(pID == 0){//child
+      close(parentPipe[1]);
+      close(childPipe[0]);
+      for(int j = 0; j < pipes.size(); j++){ //the other islands' pipes, so they see the parent close them
+	close(pipes[j]);
+      }
+      Comm C(parentPipe[0],childPipe[1]);
+      runChild(k, C, report);
+    }else if(pID < 0){//fail
+      cout << "Failed to fork\n";
+      break;
+    }
+    close(parentPipe[0]);
+    close(childPipe[1]);
+    comms.push_back(new Comm(childPipe[0],parentPipe[1]));
+    pIDs.push_back(pID);
+    pipes.push_back(childPipe[0]);
+    pipes.push_back(parentPipe[1]);
+  }
+  //island 0 sends its parameters before it starts
+  std::string params = comms.size() > 0 ? comms[0]->recieve() : "";
+  if(params != ""){
+    float beta, rho;
+    int localSearch;
+    sscanf(params.c_str(), "%f:%f:%d", &beta, &rho, &localSearch);
+    out->writeHeader(beta,rho,numAnts,ACO,reader.getName(),localSearch != 0);
+  }
+  startTime = now();
+  double t2, t3;
+  t3 = startTime;
+  std::vector<thrust::host_vector<int> > tours(comms.size());
+  std::vector<float> dists(comms.size());
+  bool stop = comms.size() < numIslands || params == ""; //if so, the children are stopped after their first report
+  for(int round = 0; ; round++){
+    t2 = t3;
+    float iterBest = std::numeric_limits<float>::max();
+    for(int k = 0; k < comms.size(); k++){
+      std::string message = comms[k]->recieve();
+      if(message == ""){ //the child has gone
+	stop = true;
+	dists[k] = std::numeric_limits<float>::max();
+	continue;
+      }
+      size_t colon = message.find(':');
+      iterBest = std::min(iterBest, (float)atof(message.substr(0, colon).c_str()));
+      dists[k] = unpackTour(message.substr(colon + 1), tours[k]);
+    }
+    t3 = now();
+    int iter = (round + 1) * report - 1;
+    if(maxIter != 0 && iter > maxIter){ //the children cut the last interval short
+      iter = maxIter;
+    }
+    int iters = iter - round * report + 1;
+    reps += iters;
+    for(int k = 0; k < comms.size(); k++){
+      if(dists[k] < globBestDist){
+	globBestDist = dists[k];
+	globBestTour = tours[k];
+	reps = 0;
+      }
+    }
+    out->write(iter, iterBest, globBestDist, t3 - startTime, (t3 - t2) / iters);
+    stop = stop || checkStop(iter, t3 - startTime);
+    for(int k = 0; k < comms.size(); k++){
+      if(stop){
+	comms[k]->send("STOP");
+      }else if(interval > 0){
+	int from = chooseEmigrant(k, dists);
+	comms[k]->send(from != k ? packTour(dists[from], tours[from]) : "GO");
+      }else{
+	comms[k]->send("GO");
+      }
+    }
+    if(stop){
+      break;
+    }
+  }
+  //closing the pipes also stops any child that has not been told to
+  for(int i = 0; i < pipes.size(); i++){
+    close(pipes[i]);
+  }
+  for(int k = 0; k < comms.size(); k++){
+    waitpid(pIDs[k], NULL, 0);
+    delete comms[k];
+  }
+}
+
+//runChild: The loop run by the process of island k. Every report iterations, and once more at maxIter, it sends its bests to the parent and waits for an immigrant, "GO" or "STOP".
+void Archipelago::runChild(int k, Comm& C, int report)
+{
+  RankBasedAntSystem<>* antHill = buildIsland(k);
+  if(k == 0){
+    reader.updateCache(antHill->getCandidates(),antHill->getNumCandidates(),antHill->getGreedyDistance(),antHill->getInitialTour());
+    std::ostringstream params;
+    params << antHill->getBeta() << ":" << antHill->getRho() << ":" << antHill->getLocalSearch();
+    C.send(params.str());
+  }
+  for(int i = 0; ; i++){
+    antHill->forage();
+    if((i + 1) % report == 0 || (maxIter != 0 && i >= maxIter)){ //the last report comes at maxIter, not at the end of its interval
+      std::ostringstream message;
+      message << std::setprecision(9) << antHill->getIterBestDist() << ":" << packTour(antHill->getGlobBestDist(),antHill->getGlobBestTour());
+      C.send(message.str());
+      std::string reply = C.recieve();
+      if(reply == "STOP" || reply == ""){
+	break;
+      }
+      if(reply != "GO"){
+	thrust::host_vector<int> tour;
+	float dist = unpackTour(reply, tour);
+	antHill->immigrate(tour, dist);
+      }
+    }
+  }
+  delete antHill;
+  exit(0);
+}
+
+//chooseEmigrant: Returns the island whose tour island k receives, the one before it in a ring, or else the island with the best tour.
+int Archipelago::chooseEmigrant(int k, const std::vector<float>& dists)
+{
+  if(ring){
+    return (k + numIslands - 1) % numIslands;
+  }
+  return std::min_element(dists.begin(), dists.end()) - dists.begin();
+}
+
+//checkStop: Checks the stopping conditions against the best tour of the whole archipelago.
+bool Archipelago::checkStop(int iter, double time)
+{
+  if(maxTime != 0 && time > maxTime){
+    return true;
+  }
+  if(maxIter != 0 && iter >= maxIter){
+    return true;
+  }
+  if(maxReps != 0 && reps >= maxReps){
+    return true;
+  }
+  return false;
+}
+
+double Archipelago::getGlobBestDist()
+{
+  return globBestDist;
+}
+
+std::string Archipelago::getTour()
+{
+  std::string result;
+  for(int i = 0; i < globBestTour.size(); i++){
+    result += Comm::intToString(globBestTour[i]) + ",";
+  }
+  return result;
+}
+
+//now: Returns the wall clock time in seconds. clock() would add up the time of every thread.
+double Archipelago::now()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+//packTour: Writes a tour length and the tour as "length:city,city,...,".
+std::string Archipelago::packTour(float dist, const thrust::host_vector<int>& tour)
+{
+  std::ostringstream oss;
+  oss << std::setprecision(9) << dist << ":";
+  for(int i = 0; i < tour.size(); i++){
+    oss << tour[i] << ",";
+  }
+  return oss.str();
+}
+
+//unpackTour: Reads a message written by packTour into tour, and returns the length.
+float Archipelago::unpackTour(const std::string& message, thrust::host_vector<int>& tour)
+{
+  const char* p = message.c_str();
+  char* end;
+  float dist = strtod(p, &end);
+  tour.clear();
+  p = end;
+  while(*p == ':' || *p == ','){
+    p++;
+    int city = strtol(p, &end, 10);
+    if(end == p){
+      break;
+    }
+    tour.push_back(city);
+    p = end;
+  }
+  return dist;
+}
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
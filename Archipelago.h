@@ -0,0 +1,79 @@
+/****************************************
+ * Archipelago.h                        *
+ * Peter Ahrens                         *
+ * Runs colonies side by side           *
+ ****************************************/
+
+#ifndef ARCHIPELAGO_H
+#define ARCHIPELAGO_H
+#include "RankBasedAntSystem.h"
+#include "TSPReader.h"
+#include "Writer.h"
+#include "Comm.h"
+#include <vector>
+#include <limits>
+#include <cstdio>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+
+//Archipelago: Runs several independent RankBasedAntSystem islands, each with its own seed, either on threads that share the reader's distance matrix or in forked processes.
+//Every few iterations each island sends its best tour on, to the next island in a ring or to all of them, and an island that receives a better tour lays pheromone on it as its global best.
+class Archipelago
+{
+ public:
+  Archipelago(TSPReader& newReader, int newNumIslands, int newNumAnts, int newArgc, char** newArgv); // Sets defaults. The islands are built by initialize or by each forked process.
+  ~Archipelago();
+  void setMigration(int newInterval, bool newRing); // Sets how many iterations pass between exchanges, 0 for none, and whether tours go round a ring or to every island.
+  void initialize(); // Builds and initializes every island on this process, so they can run on threads.
+  void runThreads(Writer& O, std::string ACO, int maxIter, int maxTime, int maxReps); // Runs every island on its own thread until a stopping condition is met.
+  void runProcesses(Writer& O, std::string ACO, int maxIter, int maxTime, int maxReps); // Forks a process for every island and relays tours between them over pipes until a stopping condition is met.
+  double getGlobBestDist();
+  std::string getTour();
+ private:
+  RankBasedAntSystem<>* buildIsland(int k); // Builds, configures and initializes island k with its own seed.
+  void runIsland(int k); // The loop run by the thread of island k.
+  static void* islandThread(void* arg);
+  void runChild(int k, Comm& C, int report); // The loop run by the process of island k, which reports to the parent every report iterations. It never returns.
+  int chooseEmigrant(int k, const std::vector<float>& dists); // Returns the island whose tour island k receives.
+  bool checkStop(int iter, double time); // Checks the stopping conditions against the best tour of the whole archipelago.
+  static double now();
+  static std::string packTour(float dist, const thrust::host_vector<int>& tour);
+  static float unpackTour(const std::string& message, thrust::host_vector<int>& tour);
+  TSPReader& reader;
+  int numIslands;
+  int numAnts;
+  int argc;
+  char** argv;
+  unsigned int seed; // Island k is seeded with seed + k.
+  int interval;
+  bool ring;
+  int maxIter;
+  int maxTime;
+  int maxReps;
+  double startTime;
+  Writer* out;
+  std::vector<RankBasedAntSystem<>*> islands;
+  std::vector<thrust::host_vector<int> > emigrantTours; // The tour each island offers at an exchange.
+  std::vector<float> emigrantDists;
+  thrust::host_vector<int> globBestTour; // The best tour of any island.
+  float globBestDist;
+  int reps; // Iterations of island 0 since globBestDist improved.
+  bool stopping;
+  pthread_mutex_t lock; // Guards the archipelago bests, stopping and the Writer.
+  pthread_barrier_t barrier;
+};
+
+#endif
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
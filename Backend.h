@@ -0,0 +1,80 @@
+/****************************************
+ * Backend.h                            *
+ * Peter Ahrens                         *
+ * Backends a colony can run on         *
+ ****************************************/
+
+#ifndef BACKEND_H
+#define BACKEND_H
+#include <thrust/execution_policy.h>
+#include <string>
+#include <type_traits>
+#ifdef HOST_BACKENDS
+#include <thrust/system/cpp/execution_policy.h>
+#include <thrust/system/omp/execution_policy.h>
+#include <thrust/system/tbb/execution_policy.h>
+#include <omp.h>
+#include <tbb/global_control.h>
+#endif
+
+//A backend names the thrust execution policy every algorithm of a colony runs under, as the type of thrust's public policy object so no thrust internals are named, and sets how many threads that policy may use.
+//Builds with HOST_BACKENDS keep their vectors in host memory, which the cpp, omp and tbb policies can all work on, so one binary can run any of them.
+
+//deviceBackend: The backend the build was compiled for with THRUST_DEVICE_SYSTEM.
+struct deviceBackend
+{
+  typedef std::remove_const<decltype(thrust::device)>::type policy;
+  static std::string name() { return "device"; }
+  static int maxThreads() { return 1; }
+  static void setThreads(int threads) {}
+};
+
+#ifdef HOST_BACKENDS
+//cppBackend: Runs every algorithm serially on the calling thread, which wins on small instances where waking threads costs more than the work.
+struct cppBackend
+{
+  typedef std::remove_const<decltype(thrust::cpp::par)>::type policy;
+  static std::string name() { return "cpp"; }
+  static int maxThreads() { return 1; }
+  static void setThreads(int threads) {}
+};
+
+//ompBackend: Runs algorithms on OpenMP threads.
+struct ompBackend
+{
+  typedef std::remove_const<decltype(thrust::omp::par)>::type policy;
+  static std::string name() { return "omp"; }
+  static int maxThreads() { return omp_get_num_procs(); }
+  static void setThreads(int threads)
+  {
+    omp_set_num_threads(threads > 0 ? threads : omp_get_num_procs());
+  }
+};
+
+//tbbBackend: Runs algorithms as TBB tasks, on at most the threads set.
+struct tbbBackend
+{
+  typedef std::remove_const<decltype(thrust::tbb::par)>::type policy;
+  static std::string name() { return "tbb"; }
+  static int maxThreads() { return omp_get_num_procs(); }
+  static void setThreads(int threads)
+  {
+    static tbb::global_control* limit = 0; //the limit holds while the object lives
+    delete limit;
+    limit = new tbb::global_control(tbb::global_control::max_allowed_parallelism, threads > 0 ? threads : omp_get_num_procs());
+  }
+};
+#endif
+
+#endif
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
@@ -0,0 +1,72 @@
+/****************************************
+ * BatchCheck.cpp                       *
+ * Peter Ahrens                         *
+ * Checks the batch pheromone update    *
+ ****************************************/
+
+//Usage: BatchCheck
+//Runs one batch iteration over two small seeded instances and checks that evaporation scales the pheromones rather than clearing them. Exits nonzero if a check fails.
+
+#include "BatchColony.h"
+#include <cstdio>
+
+//Check Values
+#define CHECK_SEED 1 // Seed of both the instances and the colony.
+#define CHECK_SIDE 1000 // Instances lie in a square of this side.
+
+//addInstance: Appends the distance matrix of numCities seeded uniform cities to distances, with FLT_MAX on the diagonal as TSPReader writes it.
+static void addInstance(int numCities, unsigned long long state, thrust::host_vector<float>& distances, thrust::host_vector<int>& sizes)
+{
+  std::vector<double> X, Y;
+  for(int i = 0; i < numCities; i++){
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    X.push_back((state >> 11) * (CHECK_SIDE / 9007199254740992.0));
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    Y.push_back((state >> 11) * (CHECK_SIDE / 9007199254740992.0));
+  }
+  for(int i = 0; i < numCities; i++){
+    for(int j = 0; j < numCities; j++){
+      distances.push_back(i == j ? FLT_MAX : sqrt((X[i] - X[j]) * (X[i] - X[j]) + (Y[i] - Y[j]) * (Y[i] - Y[j])));
+    }
+  }
+  sizes.push_back(numCities);
+}
+
+//checkPheromonesKept: One forage must leave every pheromone positive, since evaporation multiplies by 1-rho and deposits only add.
+static bool checkPheromonesKept()
+{
+  thrust::host_vector<float> distances;
+  thrust::host_vector<int> sizes;
+  addInstance(12, CHECK_SEED, distances, sizes);
+  addInstance(20, CHECK_SEED + 1, distances, sizes);
+  BatchColony colony(distances, sizes, 0);
+  colony.setSeed(CHECK_SEED);
+  colony.initialize();
+  colony.forage();
+  thrust::host_vector<float> pheromones = colony.getPheromones();
+  for(int k = 0; k < pheromones.size(); k++){
+    if(!(pheromones[k] > 0)){
+      cout << "Pheromone " << k << " is " << pheromones[k] << " after one batch iteration\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  bool passed = checkPheromonesKept();
+  cout << (passed ? "Batch pheromone update kept the pheromones\n" : "Batch pheromone update lost the pheromones\n");
+  return passed ? 0 : 1;
+}
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
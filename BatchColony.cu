@@ -0,0 +1,424 @@
+/****************************************
+ * BatchColony.cu                       *
+ * Peter Ahrens                         *
+ * Solves many small instances at once  *
+ ****************************************/
+
+#include "BatchColony.h"
+
+//Constructor: Sets defaults, lays out the instances one after another and computes each one's greedy tour on the host.
+BatchColony::BatchColony(const thrust::host_vector<float>& newDistances, const thrust::host_vector<int>& newNumCities, int newNumAnts)
+{
+  //defaults
+  beta = 5;
+  rho = 0.1;
+  w = 6;
+  maxReps = 0;
+  seed = time(NULL);
+  iteration = 0;
+  //lay out the instances
+  numInstances = newNumCities.size();
+  thrust::host_vector<int> cities = newNumCities;
+  thrust::host_vector<int> matrix(numInstances);
+  thrust::host_vector<int> ants(numInstances);
+  thrust::host_vector<int> tours(numInstances);
+  thrust::host_vector<int> cityStart(numInstances);
+  totalMatrix = 0;
+  totalAnts = 0;
+  totalTours = 0;
+  totalCities = 0;
+  for(int b = 0; b < numInstances; b++){
+    int n = cities[b];
+    int m = newNumAnts > 0 ? newNumAnts : n;
+    matrix[b] = totalMatrix;
+    ants[b] = totalAnts;
+    tours[b] = totalTours;
+    cityStart[b] = totalCities;
+    totalMatrix += n*n;
+    totalAnts += m;
+    totalTours += m*n;
+    totalCities += n;
+    if(m < w){
+      w = m;
+    }
+    if(n < w){
+      w = n;
+    }
+  }
+  //greedy tours, nearest neighbour from city 0
+  greedyLengths = thrust::host_vector<float>(numInstances);
+  for(int b = 0; b < numInstances; b++){
+    int n = cities[b];
+    const float* d = &newDistances[matrix[b]];
+    std::vector<bool> visited(n,false);
+    int i = 0;
+    float length = 0;
+    visited[0] = true;
+    for(int x = 1; x < n; x++){
+      int j = -1;
+      for(int k = 0; k < n; k++){
+	if(!visited[k] && (j < 0 || d[i*n + k] < d[i*n + j])){
+	  j = k;
+	}
+      }
+      length += d[i*n + j];
+      visited[j] = true;
+      i = j;
+    }
+    greedyLengths[b] = length + d[i*n];
+  }
+  distances.assign(newDistances.begin(),newDistances.begin() + totalMatrix);
+  heuristics = thrust::device_vector<float>(totalMatrix);
+  pheromones = thrust::device_vector<float>(totalMatrix);
+  probabilities = thrust::device_vector<float>(totalMatrix);
+  //instance vars
+  instCities = cities;
+  instMatrix = matrix;
+  instAnts = ants;
+  instTours = tours;
+  instCityStart = cityStart;
+  instActive = thrust::device_vector<int>(numInstances);
+  instReps = thrust::device_vector<int>(numInstances);
+  instIterations = thrust::device_vector<int>(numInstances);
+  instIterBest = thrust::device_vector<float>(numInstances);
+  instIterBestAnt = thrust::device_vector<int>(numInstances);
+  instGlobBest = thrust::device_vector<float>(numInstances);
+  bestTours = thrust::device_vector<int>(totalCities);
+  //ant vars
+  antInstance = thrust::device_vector<int>(totalAnts);
+  antDistances = thrust::device_vector<float>(totalAnts);
+  antWeights = thrust::device_vector<float>(totalAnts);
+  antOrder = thrust::device_vector<int>(totalAnts);
+  antTours = thrust::device_vector<int>(totalTours);
+  places = thrust::device_vector<int>(totalTours);
+  //maps and keys
+  tourAnt = thrust::device_vector<int>(totalTours);
+  cityInstance = thrust::device_vector<int>(totalCities);
+  //scratch variables
+  AInt = thrust::device_vector<int>(totalAnts);
+  AFloat = thrust::device_vector<float>(totalAnts);
+  EInt = thrust::device_vector<int>(totalTours + totalCities);
+  EInt2 = thrust::device_vector<int>(totalTours + totalCities);
+  EFloat = thrust::device_vector<float>(totalTours + totalCities);
+  EFloat2 = thrust::device_vector<float>(totalTours + totalCities);
+}
+
+//configure: Applies the parameter options given on the command line, leaving the defaults for any that are missing.
+void BatchColony::configure(int argc, char* argv[])
+{
+  for(int i = 0; i < argc;i++){
+    if (std::string(argv[i]) == "-b"){
+      setBeta(atof(argv[i+1]));
+    }
+    if (std::string(argv[i]) == "-r"){
+      setRho(atof(argv[i+1]));
+    }
+    if (std::string(argv[i]) == "-seed"){
+      setSeed(strtoul(argv[i+1],NULL,10));
+    }
+    if (std::string(argv[i]) == "-w"){
+      setW(atoi(argv[i+1]));
+    }
+  }
+}
+
+//initialize: Creates maps and keys, resets every instance and lays its initial pheromone with the formula described by Marco Dorigo.
+void BatchColony::initialize()
+{
+  iteration = 0;
+  //create maps and keys
+  //antInstance, the last instance starting at or before each ant
+  thrust::upper_bound(instAnts.begin(),
+		      instAnts.end(),
+		      thrust::make_counting_iterator(0),
+		      thrust::make_counting_iterator(totalAnts),
+		      antInstance.begin());
+  thrust::transform(antInstance.begin(),
+		    antInstance.end(),
+		    thrust::make_constant_iterator(-1),
+		    antInstance.begin(),
+		    thrust::plus<int>());
+  //tourAnt, each ant tour is one row of its instance's cities, so the rows start at the running sum of the ants' city counts
+  thrust::gather(antInstance.begin(),
+		 antInstance.end(),
+		 instCities.begin(),
+		 AInt.begin());
+  thrust::exclusive_scan(AInt.begin(),
+			 AInt.end(),
+			 AInt.begin());
+  thrust::upper_bound(AInt.begin(),
+		      AInt.end(),
+		      thrust::make_counting_iterator(0),
+		      thrust::make_counting_iterator(totalTours),
+		      tourAnt.begin());
+  thrust::transform(tourAnt.begin(),
+		    tourAnt.end(),
+		    thrust::make_constant_iterator(-1),
+		    tourAnt.begin(),
+		    thrust::plus<int>());
+  //cityInstance
+  thrust::upper_bound(instCityStart.begin(),
+		      instCityStart.end(),
+		      thrust::make_counting_iterator(0),
+		      thrust::make_counting_iterator(totalCities),
+		      cityInstance.begin());
+  thrust::transform(cityInstance.begin(),
+		    cityInstance.end(),
+		    thrust::make_constant_iterator(-1),
+		    cityInstance.begin(),
+		    thrust::plus<int>());
+  //reset the instances
+  thrust::fill(instActive.begin(),instActive.end(),1);
+  thrust::fill(instReps.begin(),instReps.end(),0);
+  thrust::fill(instIterations.begin(),instIterations.end(),0);
+  thrust::fill(instGlobBest.begin(),instGlobBest.end(),std::numeric_limits<float>::max());
+  thrust::fill(bestTours.begin(),bestTours.end(),0);
+  //ACO Initialize
+  thrust::transform(distances.begin(),
+		    distances.end(),
+		    heuristics.begin(),
+		    heuristic_functor(beta));
+  thrust::host_vector<float> initialPheromones(numInstances);
+  for(int b = 0; b < numInstances; b++){
+    initialPheromones[b] = 0.5*w*(w-1)/(rho*greedyLengths[b]);
+  }
+  thrust::host_vector<int> cities = instCities;
+  thrust::host_vector<int> matrix = instMatrix;
+  for(int b = 0; b < numInstances; b++){
+    thrust::fill_n(pheromones.begin() + matrix[b],
+		   cities[b]*cities[b],
+		   initialPheromones[b]);
+  }
+  thrust::transform(pheromones.begin(),
+		    pheromones.end(),
+		    heuristics.begin(),
+		    probabilities.begin(),
+		    thrust::multiplies<float>());
+}
+
+//forage: Main batch loop. Every running instance constructs and measures its tours, records its bests and ranks its ants, then all their pheromones and probabilities are updated in one pass.
+void BatchColony::forage()
+{
+  //construct
+  thrust::transform(thrust::make_counting_iterator(0),
+		    thrust::make_counting_iterator(totalAnts),
+		    AInt.begin(),
+		    batchConstruct(thrust::raw_pointer_cast(&probabilities[0]),
+				   thrust::raw_pointer_cast(&antTours[0]),
+				   thrust::raw_pointer_cast(&places[0]),
+				   thrust::raw_pointer_cast(&antInstance[0]),
+				   thrust::raw_pointer_cast(&instCities[0]),
+				   thrust::raw_pointer_cast(&instMatrix[0]),
+				   thrust::raw_pointer_cast(&instAnts[0]),
+				   thrust::raw_pointer_cast(&instTours[0]),
+				   thrust::raw_pointer_cast(&instActive[0]),
+				   seed,
+				   iteration));
+  iteration++;
+  //measure
+  thrust::transform(thrust::make_counting_iterator(0),
+		    thrust::make_counting_iterator(totalAnts),
+		    antDistances.begin(),
+		    batchTourLength(thrust::raw_pointer_cast(&distances[0]),
+				    thrust::raw_pointer_cast(&antTours[0]),
+				    thrust::raw_pointer_cast(&antInstance[0]),
+				    thrust::raw_pointer_cast(&instCities[0]),
+				    thrust::raw_pointer_cast(&instMatrix[0]),
+				    thrust::raw_pointer_cast(&instAnts[0]),
+				    thrust::raw_pointer_cast(&instTours[0]),
+				    thrust::raw_pointer_cast(&instActive[0])));
+  //find the iteration best of every instance
+  thrust::reduce_by_key(antInstance.begin(),
+			antInstance.end(),
+			thrust::make_zip_iterator(thrust::make_tuple(antDistances.begin(),thrust::make_counting_iterator(0))),
+			thrust::make_discard_iterator(),
+			thrust::make_zip_iterator(thrust::make_tuple(instIterBest.begin(),instIterBestAnt.begin())),
+			thrust::equal_to<int>(),
+			minFirst());
+  //record the bests, and stop the instances that stopped improving
+  thrust::transform(thrust::make_counting_iterator(0),
+		    thrust::make_counting_iterator(numInstances),
+		    instGlobBest.begin(),
+		    batchRecord(thrust::raw_pointer_cast(&instIterBest[0]),
+				thrust::raw_pointer_cast(&instIterBestAnt[0]),
+				thrust::raw_pointer_cast(&instGlobBest[0]),
+				thrust::raw_pointer_cast(&instReps[0]),
+				thrust::raw_pointer_cast(&instIterations[0]),
+				thrust::raw_pointer_cast(&instActive[0]),
+				thrust::raw_pointer_cast(&antTours[0]),
+				thrust::raw_pointer_cast(&bestTours[0]),
+				thrust::raw_pointer_cast(&instCities[0]),
+				thrust::raw_pointer_cast(&instAnts[0]),
+				thrust::raw_pointer_cast(&instTours[0]),
+				thrust::raw_pointer_cast(&instCityStart[0]),
+				maxReps));
+  //rank the ants within their instances, by distance then stably by instance
+  thrust::sequence(antOrder.begin(),
+		   antOrder.end());
+  AFloat.assign(antDistances.begin(),antDistances.end());
+  thrust::stable_sort_by_key(AFloat.begin(),
+			     AFloat.end(),
+			     antOrder.begin());
+  thrust::gather(antOrder.begin(),
+		 antOrder.end(),
+		 antInstance.begin(),
+		 AInt.begin());
+  thrust::stable_sort_by_key(AInt.begin(),
+			     AInt.end(),
+			     antOrder.begin());
+  //determine ant pheromone levels
+  thrust::transform(thrust::make_counting_iterator(0),
+		    thrust::make_counting_iterator(totalAnts),
+		    thrust::make_permutation_iterator(antWeights.begin(),antOrder.begin()),
+		    batchWeight(thrust::raw_pointer_cast(&antOrder[0]),
+				thrust::raw_pointer_cast(&antDistances[0]),
+				thrust::raw_pointer_cast(&antInstance[0]),
+				thrust::raw_pointer_cast(&instAnts[0]),
+				thrust::raw_pointer_cast(&instActive[0]),
+				w));
+  //evaporate, a full sweep since the blocks are small
+  thrust::transform(pheromones.begin(),
+		    pheromones.end(),
+		    thrust::make_constant_iterator(1.0f-rho),
+		    pheromones.begin(),
+		    thrust::multiplies<float>());
+  //collect the edges of every tour and best tour with their deposits
+  thrust::transform(thrust::make_counting_iterator(0),
+		    thrust::make_counting_iterator(totalTours),
+		    EInt.begin(),
+		    batchEdge(thrust::raw_pointer_cast(&antTours[0]),
+			      thrust::raw_pointer_cast(&tourAnt[0]),
+			      thrust::raw_pointer_cast(&antInstance[0]),
+			      thrust::raw_pointer_cast(&instCities[0]),
+			      thrust::raw_pointer_cast(&instMatrix[0]),
+			      thrust::raw_pointer_cast(&instAnts[0]),
+			      thrust::raw_pointer_cast(&instTours[0])));
+  thrust::gather(tourAnt.begin(),
+		 tourAnt.end(),
+		 antWeights.begin(),
+		 EFloat.begin());
+  thrust::transform(thrust::make_counting_iterator(0),
+		    thrust::make_counting_iterator(totalCities),
+		    thrust::make_zip_iterator(thrust::make_tuple(EInt.begin() + totalTours,EFloat.begin() + totalTours)),
+		    batchBestEdge(thrust::raw_pointer_cast(&bestTours[0]),
+				  thrust::raw_pointer_cast(&cityInstance[0]),
+				  thrust::raw_pointer_cast(&instCities[0]),
+				  thrust::raw_pointer_cast(&instMatrix[0]),
+				  thrust::raw_pointer_cast(&instCityStart[0]),
+				  thrust::raw_pointer_cast(&instActive[0]),
+				  thrust::raw_pointer_cast(&instGlobBest[0]),
+				  w));
+  //keep only the edges that get pheromone, and sum those shared by several tours
+  int numEdges = thrust::copy_if(thrust::make_zip_iterator(thrust::make_tuple(EInt.begin(),EFloat.begin())),
+				 thrust::make_zip_iterator(thrust::make_tuple(EInt.end(),EFloat.end())),
+				 EFloat.begin(),
+				 thrust::make_zip_iterator(thrust::make_tuple(EInt2.begin(),EFloat2.begin())),
+				 isPositive()) - thrust::make_zip_iterator(thrust::make_tuple(EInt2.begin(),EFloat2.begin()));
+  thrust::sort_by_key(EInt2.begin(),
+		      EInt2.begin() + numEdges,
+		      EFloat2.begin());
+  numEdges = thrust::reduce_by_key(EInt2.begin(),
+				   EInt2.begin() + numEdges,
+				   EFloat2.begin(),
+				   EInt.begin(),
+				   EFloat.begin()).first - EInt.begin();
+  //lay Pheromone
+  thrust::transform(thrust::make_permutation_iterator(pheromones.begin(),EInt.begin()),
+		    thrust::make_permutation_iterator(pheromones.begin(),EInt.begin() + numEdges),
+		    EFloat.begin(),
+		    thrust::make_permutation_iterator(pheromones.begin(),EInt.begin()),
+		    thrust::plus<float>());
+  thrust::transform(pheromones.begin(),
+		    pheromones.end(),
+		    heuristics.begin(),
+		    probabilities.begin(),
+		    thrust::multiplies<float>());
+}
+
+void BatchColony::setRho(float newRho)
+{
+  rho = newRho;
+}
+
+void BatchColony::setBeta(float newBeta)
+{
+  beta = newBeta;
+}
+
+//setW: Sets the number of ranked ants, kept no larger than the smallest instance or ant count.
+void BatchColony::setW(int newW)
+{
+  thrust::host_vector<int> cities = instCities;
+  thrust::host_vector<int> ants = instAnts;
+  for(int b = 0; b < numInstances; b++){
+    int m = (b + 1 < numInstances ? ants[b + 1] : totalAnts) - ants[b];
+    newW = std::min(newW, std::min(m, (int)cities[b]));
+  }
+  w = newW;
+}
+
+void BatchColony::setSeed(unsigned int newSeed)
+{
+  seed = newSeed;
+}
+
+void BatchColony::setMaxReps(int newMaxReps)
+{
+  maxReps = newMaxReps;
+}
+
+double BatchColony::getRho()
+{
+  return rho;
+}
+
+double BatchColony::getBeta()
+{
+  return beta;
+}
+
+int BatchColony::getNumInstances()
+{
+  return numInstances;
+}
+
+int BatchColony::getNumActive()
+{
+  return thrust::reduce(instActive.begin(),instActive.end());
+}
+
+thrust::host_vector<float> BatchColony::getGlobBestDists()
+{
+  return instGlobBest;
+}
+
+thrust::host_vector<int> BatchColony::getIterations()
+{
+  return instIterations;
+}
+
+thrust::host_vector<float> BatchColony::getPheromones()
+{
+  return pheromones;
+}
+
+std::string BatchColony::getTour(int b)
+{
+  thrust::host_vector<int> tour(bestTours.begin() + instCityStart[b], bestTours.begin() + instCityStart[b] + instCities[b]);
+  std::string result;
+  for(int i = 0; i < tour.size(); i++){
+    result += Comm::intToString(tour[i]) + ",";
+  }
+  return result;
+}
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
@@ -0,0 +1,279 @@
+/****************************************
+ * BatchColony.h                        *
+ * Peter Ahrens                         *
+ * Solves many small instances at once  *
+ ****************************************/
+
+#ifndef BATCHCOLONY_H
+#define BATCHCOLONY_H
+#include "Colony.h"
+#include <vector>
+
+//batchConstruct: Builds the tour of one ant of the batch with tourConstruct, on the probability block and tour rows of the ant's instance.
+struct batchConstruct : public thrust::unary_function<int,int>
+{
+  const float* probabilities;
+  int* antTours;
+  int* places;
+  const int* antInstance;
+  const int* instCities;
+  const int* instMatrix;
+  const int* instAnts;
+  const int* instTours;
+  const int* instActive;
+  const unsigned int seed;
+  const unsigned int iteration;
+  batchConstruct (const float* _probabilities, int* _antTours, int* _places, const int* _antInstance, const int* _instCities, const int* _instMatrix, const int* _instAnts, const int* _instTours, const int* _instActive, unsigned int _seed, unsigned int _iteration) : probabilities ( _probabilities ), antTours ( _antTours ), places ( _places ), antInstance ( _antInstance ), instCities ( _instCities ), instMatrix ( _instMatrix ), instAnts ( _instAnts ), instTours ( _instTours ), instActive ( _instActive ), seed ( _seed ), iteration ( _iteration ) {}
+  __host__ __device__
+    int operator()(const int ant) const
+  {
+    const int b = antInstance[ant];
+    if(!instActive[b]){
+      return -1;
+    }
+    return tourConstruct<int,float>(probabilities + instMatrix[b], 0, 0, 0, antTours + instTours[b], places + instTours[b], instCities[b], 0, seed + b, iteration)(ant - instAnts[b]);
+  }
+};
+
+//batchTourLength: Computes the length of the tour of one ant of the batch. Ants of finished instances get FLT_MAX, so they never rank.
+struct batchTourLength : public thrust::unary_function<int,float>
+{
+  const float* distances;
+  const int* antTours;
+  const int* antInstance;
+  const int* instCities;
+  const int* instMatrix;
+  const int* instAnts;
+  const int* instTours;
+  const int* instActive;
+  batchTourLength (const float* _distances, const int* _antTours, const int* _antInstance, const int* _instCities, const int* _instMatrix, const int* _instAnts, const int* _instTours, const int* _instActive) : distances ( _distances ), antTours ( _antTours ), antInstance ( _antInstance ), instCities ( _instCities ), instMatrix ( _instMatrix ), instAnts ( _instAnts ), instTours ( _instTours ), instActive ( _instActive ) {}
+  __host__ __device__
+    float operator()(const int ant) const
+  {
+    const int b = antInstance[ant];
+    if(!instActive[b]){
+      return FLT_MAX;
+    }
+    const int n = instCities[b];
+    const int* tour = antTours + instTours[b] + (ant - instAnts[b]) * n;
+    const float* d = distances + instMatrix[b];
+    float length = d[tour[n - 1] * n + tour[0]];
+    for(int i = 0; i < n - 1; i++){
+      length += d[tour[i] * n + tour[i + 1]];
+    }
+    return length;
+  }
+};
+
+//minFirst: Keeps whichever of two (distance, ant) pairs has the smaller distance.
+struct minFirst : public thrust::binary_function<thrust::tuple<float,int>,thrust::tuple<float,int>,thrust::tuple<float,int> >
+{
+  __host__ __device__
+    thrust::tuple<float,int> operator()(const thrust::tuple<float,int> tup1, const thrust::tuple<float,int> tup2) const
+  {
+    return tup2.get<0>() < tup1.get<0>() ? tup2 : tup1;
+  }
+};
+
+//batchRecord: Updates the records of one instance from its iteration best, and returns its global best distance. An instance stops once maxReps iterations pass without improvement.
+struct batchRecord : public thrust::unary_function<int,float>
+{
+  const float* instIterBest;
+  const int* instIterBestAnt;
+  const float* instGlobBest;
+  int* instReps;
+  int* instIterations;
+  int* instActive;
+  const int* antTours;
+  int* bestTours;
+  const int* instCities;
+  const int* instAnts;
+  const int* instTours;
+  const int* instCityStart;
+  const int maxReps;
+  batchRecord (const float* _instIterBest, const int* _instIterBestAnt, const float* _instGlobBest, int* _instReps, int* _instIterations, int* _instActive, const int* _antTours, int* _bestTours, const int* _instCities, const int* _instAnts, const int* _instTours, const int* _instCityStart, int _maxReps) : instIterBest ( _instIterBest ), instIterBestAnt ( _instIterBestAnt ), instGlobBest ( _instGlobBest ), instReps ( _instReps ), instIterations ( _instIterations ), instActive ( _instActive ), antTours ( _antTours ), bestTours ( _bestTours ), instCities ( _instCities ), instAnts ( _instAnts ), instTours ( _instTours ), instCityStart ( _instCityStart ), maxReps ( _maxReps ) {}
+  __host__ __device__
+    float operator()(const int b) const
+  {
+    if(!instActive[b]){
+      return instGlobBest[b];
+    }
+    instIterations[b]++;
+    if(instIterBest[b] < instGlobBest[b]){
+      const int n = instCities[b];
+      const int* tour = antTours + instTours[b] + (instIterBestAnt[b] - instAnts[b]) * n;
+      for(int i = 0; i < n; i++){
+	bestTours[instCityStart[b] + i] = tour[i];
+      }
+      instReps[b] = 0;
+      return instIterBest[b];
+    }
+    instReps[b]++;
+    if(maxReps != 0 && instReps[b] >= maxReps){
+      instActive[b] = 0;
+    }
+    return instGlobBest[b];
+  }
+};
+
+//batchWeight: Computes the pheromone weight of the ant at position i of the ants sorted by instance, then by distance. The w-1 best ants of each running instance get the rank-based weights, the others nothing.
+struct batchWeight : public thrust::unary_function<int,float>
+{
+  const int* order;
+  const float* antDistances;
+  const int* antInstance;
+  const int* instAnts;
+  const int* instActive;
+  const int w;
+  batchWeight (const int* _order, const float* _antDistances, const int* _antInstance, const int* _instAnts, const int* _instActive, int _w) : order ( _order ), antDistances ( _antDistances ), antInstance ( _antInstance ), instAnts ( _instAnts ), instActive ( _instActive ), w ( _w ) {}
+  __host__ __device__
+    float operator()(const int i) const
+  {
+    const int ant = order[i];
+    const int b = antInstance[ant];
+    const int rank = i - instAnts[b];
+    if(!instActive[b] || rank >= w - 1){
+      return 0;
+    }
+    return (w - 1 - rank) / antDistances[ant];
+  }
+};
+
+//batchEdge: Finds the index into the pheromones of the batch of the edge leaving element e of the ant tours.
+struct batchEdge : public thrust::unary_function<int,int>
+{
+  const int* antTours;
+  const int* tourAnt;
+  const int* antInstance;
+  const int* instCities;
+  const int* instMatrix;
+  const int* instAnts;
+  const int* instTours;
+  batchEdge (const int* _antTours, const int* _tourAnt, const int* _antInstance, const int* _instCities, const int* _instMatrix, const int* _instAnts, const int* _instTours) : antTours ( _antTours ), tourAnt ( _tourAnt ), antInstance ( _antInstance ), instCities ( _instCities ), instMatrix ( _instMatrix ), instAnts ( _instAnts ), instTours ( _instTours ) {}
+  __host__ __device__
+    int operator()(const int e) const
+  {
+    const int ant = tourAnt[e];
+    const int b = antInstance[ant];
+    const int n = instCities[b];
+    const int start = instTours[b] + (ant - instAnts[b]) * n;
+    const int next = e + 1 < start + n ? e + 1 : start;
+    return instMatrix[b] + antTours[e] * n + antTours[next];
+  }
+};
+
+//batchBestEdge: Finds the index into the pheromones of the batch of the edge leaving element c of the best tours, and the weight it is laid with.
+struct batchBestEdge : public thrust::unary_function<int,thrust::tuple<int,float> >
+{
+  const int* bestTours;
+  const int* cityInstance;
+  const int* instCities;
+  const int* instMatrix;
+  const int* instCityStart;
+  const int* instActive;
+  const float* instGlobBest;
+  const int w;
+  batchBestEdge (const int* _bestTours, const int* _cityInstance, const int* _instCities, const int* _instMatrix, const int* _instCityStart, const int* _instActive, const float* _instGlobBest, int _w) : bestTours ( _bestTours ), cityInstance ( _cityInstance ), instCities ( _instCities ), instMatrix ( _instMatrix ), instCityStart ( _instCityStart ), instActive ( _instActive ), instGlobBest ( _instGlobBest ), w ( _w ) {}
+  __host__ __device__
+    thrust::tuple<int,float> operator()(const int c) const
+  {
+    const int b = cityInstance[c];
+    const int n = instCities[b];
+    const int start = instCityStart[b];
+    const int next = c + 1 < start + n ? c + 1 : start;
+    return thrust::make_tuple(instMatrix[b] + bestTours[c] * n + bestTours[next], instActive[b] ? w / instGlobBest[b] : 0.0f);
+  }
+};
+
+//isPositive: Checks if a value is greater than zero.
+struct isPositive
+{
+  __host__ __device__
+  bool operator()(const float x) const
+  {
+    return x > 0;
+  }
+};
+
+//BatchColony: A Rank-Based Ant System over many instances at once. Every instance has its own block of the pheromones and its own ants, best tour and stopping state, and each step runs over all the instances in one pass.
+class BatchColony
+{
+ public:
+  BatchColony(const thrust::host_vector<float>& newDistances, const thrust::host_vector<int>& newNumCities, int newNumAnts); // Takes the distance matrices of the instances one after another. If newNumAnts is not positive, every instance gets one ant per city.
+  void configure(int argc, char* argv[]); // Applies the parameter options given on the command line.
+  void initialize(); // Creates maps and keys, and sets every instance's initial pheromone from its greedy tour.
+  void forage(); // Constructs, measures and ranks the tours of every running instance, then updates their pheromones and probabilities.
+  void setRho(float newRho);
+  void setBeta(float newBeta);
+  void setW(int newW);
+  void setSeed(unsigned int newSeed);
+  void setMaxReps(int newMaxReps); // An instance stops once this many iterations pass without improving its best tour, or never if 0.
+  double getRho();
+  double getBeta();
+  int getNumInstances();
+  int getNumActive(); // Returns how many instances are still running.
+  thrust::host_vector<float> getGlobBestDists();
+  thrust::host_vector<int> getIterations(); // Returns the number of iterations each instance has run.
+  thrust::host_vector<float> getPheromones(); // Returns a host copy of the pheromone blocks of every instance, one after another.
+  std::string getTour(int b);
+ private:
+  //world vars
+  int numInstances;
+  int totalMatrix;
+  int totalAnts;
+  int totalTours;
+  int totalCities;
+  float beta;
+  float rho;
+  int w;
+  int maxReps;
+  unsigned int seed;
+  unsigned int iteration;
+  thrust::host_vector<float> greedyLengths; // Greedy tour length of each instance, for its initial pheromone.
+  thrust::device_vector<float> distances;
+  thrust::device_vector<float> heuristics;
+  thrust::device_vector<float> pheromones;
+  thrust::device_vector<float> probabilities;
+  //instance vars, indexed by instance
+  thrust::device_vector<int> instCities;
+  thrust::device_vector<int> instMatrix; // Offset of the instance's block in distances, pheromones and probabilities.
+  thrust::device_vector<int> instAnts; // Index of the instance's first ant.
+  thrust::device_vector<int> instTours; // Offset of the instance's first ant tour in antTours.
+  thrust::device_vector<int> instCityStart; // Offset of the instance's best tour in bestTours.
+  thrust::device_vector<int> instActive;
+  thrust::device_vector<int> instReps;
+  thrust::device_vector<int> instIterations;
+  thrust::device_vector<float> instIterBest;
+  thrust::device_vector<int> instIterBestAnt;
+  thrust::device_vector<float> instGlobBest;
+  thrust::device_vector<int> bestTours;
+  //ant vars
+  thrust::device_vector<int> antInstance;
+  thrust::device_vector<float> antDistances;
+  thrust::device_vector<float> antWeights;
+  thrust::device_vector<int> antOrder;
+  thrust::device_vector<int> antTours;
+  thrust::device_vector<int> places;
+  //maps and keys
+  thrust::device_vector<int> tourAnt; // The ant of every element of antTours.
+  thrust::device_vector<int> cityInstance; // The instance of every element of bestTours.
+  //scratch variables
+  thrust::device_vector<int> AInt;
+  thrust::device_vector<float> AFloat;
+  thrust::device_vector<int> EInt; // Sized for every edge of every ant tour and best tour.
+  thrust::device_vector<int> EInt2;
+  thrust::device_vector<float> EFloat;
+  thrust::device_vector<float> EFloat2;
+};
+#endif
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
@@ -0,0 +1,127 @@
+/****************************************
+ * Checkpoint.cpp                       *
+ * Peter Ahrens                         *
+ * Saves and restores colony state      *
+ ****************************************/
+
+#include "Checkpoint.h"
+
+//Constructor: Sets defaults. Nothing is written until save.
+Checkpointer::Checkpointer(string newFileName)
+{
+  fileName = newFileName;
+  started = false;
+  busy = 0;
+}
+
+//Destructor: Waits for a write in progress, so the checkpoint is never left half renamed.
+Checkpointer::~Checkpointer()
+{
+  wait();
+}
+
+//save: Takes state and starts a thread writing it. If the last write is still going, the state is left alone and false is returned, so the caller never waits on the disk.
+bool Checkpointer::save(colonyState& state)
+{
+  if(!ready()){
+    return false;
+  }
+  wait(); //the last thread has finished, this only reclaims it
+  pending.header = state.header;
+  pending.pheromones.swap(state.pheromones);
+  pending.globBestTour.swap(state.globBestTour);
+  pending.candidates.swap(state.candidates);
+  busy = 1;
+  started = pthread_create(&thread, NULL, writeThread, this) == 0;
+  if(!started){
+    busy = 0;
+    return write();
+  }
+  return true;
+}
+
+//ready: Returns true if no write is in progress. Check it before filling a state, so the copy off the device is not wasted on a save that would be refused.
+bool Checkpointer::ready()
+{
+  return !__atomic_load_n(&busy, __ATOMIC_ACQUIRE);
+}
+
+//wait: Waits for a write in progress.
+void Checkpointer::wait()
+{
+  if(started){
+    pthread_join(thread, NULL);
+    started = false;
+  }
+}
+
+void* Checkpointer::writeThread(void* arg)
+{
+  Checkpointer* checkpointer = (Checkpointer*)arg;
+  checkpointer->write();
+  __atomic_store_n(&checkpointer->busy, 0, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+//write: Writes pending to a temporary file, then renames it over the checkpoint. Returns false if any of it fails, leaving the old checkpoint.
+bool Checkpointer::write()
+{
+  string temporary = fileName + ".tmp";
+  FILE* f = fopen(temporary.c_str(), "wb");
+  if(!f){
+    cout << "Unable to write checkpoint " << temporary << "\n";
+    return false;
+  }
+  checkpointHeader& header = pending.header;
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.numPheromones = pending.pheromones.size();
+  header.numCandidateEntries = pending.candidates.size();
+  bool written = fwrite(&header, sizeof(header), 1, f) == 1 &&
+    fwrite(&pending.pheromones[0], sizeof(float), header.numPheromones, f) == (size_t)header.numPheromones &&
+    fwrite(&pending.globBestTour[0], sizeof(int), header.numCities, f) == (size_t)header.numCities &&
+    (header.numCandidateEntries == 0 || fwrite(&pending.candidates[0], sizeof(int), header.numCandidateEntries, f) == (size_t)header.numCandidateEntries);
+  written = fclose(f) == 0 && written;
+  if(!written || rename(temporary.c_str(), fileName.c_str()) != 0){
+    cout << "Unable to write checkpoint " << fileName << "\n";
+    remove(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+//load: Reads a checkpoint written by save. Returns false if it is missing, is not a checkpoint or is cut short.
+bool Checkpointer::load(string filen, colonyState& state)
+{
+  FILE* f = fopen(filen.c_str(), "rb");
+  if(!f){
+    cout << "Unable to open checkpoint " << filen << "\n";
+    return false;
+  }
+  checkpointHeader& header = state.header;
+  bool read = fread(&header, sizeof(header), 1, f) == 1 && memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) == 0 &&
+    header.numCities > 0 && header.numPheromones > 0 && header.numCandidateEntries >= 0;
+  if(read){
+    state.pheromones.resize(header.numPheromones);
+    state.globBestTour.resize(header.numCities);
+    state.candidates.resize(header.numCandidateEntries);
+    read = fread(&state.pheromones[0], sizeof(float), header.numPheromones, f) == (size_t)header.numPheromones &&
+      fread(&state.globBestTour[0], sizeof(int), header.numCities, f) == (size_t)header.numCities &&
+      (header.numCandidateEntries == 0 || fread(&state.candidates[0], sizeof(int), header.numCandidateEntries, f) == (size_t)header.numCandidateEntries);
+  }
+  fclose(f);
+  if(!read){
+    cout << filen << " is not a whole checkpoint\n";
+  }
+  return read;
+}
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
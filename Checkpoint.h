@@ -0,0 +1,85 @@
+/****************************************
+ * Checkpoint.h                         *
+ * Peter Ahrens                         *
+ * Saves and restores colony state      *
+ ****************************************/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+#include <thrust/host_vector.h>
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <pthread.h>
+using namespace std;
+
+//Checkpoint Values
+#define CHECKPOINT_MAGIC "EXCKPT02" // First 8 bytes of a checkpoint file.
+
+//checkpointHeader: The fixed part of a checkpoint, written as is.
+struct checkpointHeader
+{
+  char magic[8];
+  int numCities;
+  int numAnts;
+  int matrixFree;
+  int numCandidates;
+  char variant[8]; // Name of the rules the pheromones were laid by, RBAS, MMAS or ACS.
+  int ranks; // w of a rank-based colony, 0 for the other variants.
+  int reps;
+  unsigned int seed;
+  unsigned int iteration; // Counter of the random numbers, so a resumed run draws what an uninterrupted one would.
+  float beta;
+  float rho;
+  float pheromoneScale;
+  float globBestDist;
+  float greedyLength;
+  int loopIteration; // Iteration of the main loop the checkpoint was taken after.
+  double elapsed; // Wall clock seconds the run had taken, so a time limit covers the resumed run too.
+  long numPheromones;
+  long numCandidateEntries;
+};
+
+//colonyState: Everything a colony needs to carry on where it was, as filled in by getState.
+struct colonyState
+{
+  checkpointHeader header;
+  thrust::host_vector<float> pheromones;
+  thrust::host_vector<int> globBestTour;
+  thrust::host_vector<int> candidates; // Only checked on restore, since matrix-free pheromones are stored in candidate order.
+};
+
+//Checkpointer: Writes colony states to a file from a background thread, so the main loop only pays for copying the state off the device.
+//Each state is written to a temporary file that is then renamed over the checkpoint, so a crash mid write leaves the previous checkpoint whole.
+class Checkpointer
+{
+ public:
+  Checkpointer(string newFileName); // Sets defaults. Nothing is written until save.
+  ~Checkpointer(); // Waits for a write in progress.
+  bool save(colonyState& state); // Takes state, leaving it empty, and starts writing it. Returns false without taking it if the last write has not finished.
+  bool ready(); // Returns true if the last write has finished, so save would take a state now.
+  void wait(); // Waits for a write in progress.
+  static bool load(string filen, colonyState& state); // Reads a checkpoint. Returns false if it is missing or damaged.
+ private:
+  static void* writeThread(void* arg);
+  bool write(); // Writes pending to the checkpoint file.
+  string fileName;
+  colonyState pending;
+  pthread_t thread;
+  bool started; // Set while there is a thread to join.
+  int busy; // Set while a write is in progress, cleared by the write thread.
+};
+
+#endif
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
@@ -0,0 +1,212 @@
+/****************************************
+ * CityGrid.cpp                         *
+ * Peter Ahrens                         *
+ * Buckets cities for neighbour queries *
+ ****************************************/
+
+#include "CityGrid.h"
+
+//Constructor: Buckets the cities into square cells holding about two cities each.
+CityGrid::CityGrid(const float* newXcoords, const float* newYcoords, int newNumCities)
+{
+  Xcoords = newXcoords;
+  Ycoords = newYcoords;
+  numCities = newNumCities;
+  minX = minY = FLT_MAX;
+  float maxX = -FLT_MAX;
+  float maxY = -FLT_MAX;
+  for(int i = 0; i < numCities; i++){
+    minX = fminf(minX, Xcoords[i]);
+    minY = fminf(minY, Ycoords[i]);
+    maxX = fmaxf(maxX, Xcoords[i]);
+    maxY = fmaxf(maxY, Ycoords[i]);
+  }
+  float side = fmaxf(maxX - minX, maxY - minY);
+  cellSize = side / ceilf(sqrtf(numCities / 2.0f));
+  if(cellSize <= 0){
+    cellSize = 1;
+  }
+  cols = (int)((maxX - minX) / cellSize) + 1;
+  rows = (int)((maxY - minY) / cellSize) + 1;
+  //counting sort of the cities by cell
+  cellStart.assign(cols * rows + 1, 0);
+  cellCities.resize(numCities);
+  for(int i = 0; i < numCities; i++){
+    cellStart[cellOf(Xcoords[i], Ycoords[i]) + 1]++;
+  }
+  for(int c = 0; c < cols * rows; c++){
+    cellStart[c + 1] += cellStart[c];
+  }
+  std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+  for(int i = 0; i < numCities; i++){
+    cellCities[fill[cellOf(Xcoords[i], Ycoords[i])]++] = i;
+  }
+}
+
+//nearest: Writes the k nearest other cities to city into result, nearest first. Searches rings of cells outward until no closer city can remain.
+void CityGrid::nearest(int city, int k, int* result)
+{
+  std::vector<float> best(k, FLT_MAX);
+  int found = 0;
+  int cell = cellOf(Xcoords[city], Ycoords[city]);
+  int cx = cell % cols;
+  int cy = cell / cols;
+  for(int r = 0; r <= cols || r <= rows; r++){
+    //every city in ring r is at least (r - 1) * cellSize away
+    if(found == k && best[k - 1] <= (r - 1) * cellSize){
+      break;
+    }
+    for(int y = cy - r; y <= cy + r; y++){
+      if(y < 0 || y >= rows){
+	continue;
+      }
+      for(int x = cx - r; x <= cx + r; x += (y == cy - r || y == cy + r) ? 1 : 2 * r){
+	if(x >= 0 && x < cols){
+	  int c = y * cols + x;
+	  for(int i = cellStart[c]; i < cellStart[c + 1]; i++){
+	    int j = cellCities[i];
+	    if(j == city){
+	      continue;
+	    }
+	    float d = distance(city, j);
+	    if(found < k || d < best[k - 1]){
+	      //insert j into the sorted result
+	      int p = found < k ? found++ : k - 1;
+	      while(p > 0 && best[p - 1] > d){
+		best[p] = best[p - 1];
+		result[p] = result[p - 1];
+		p--;
+	      }
+	      best[p] = d;
+	      result[p] = j;
+	    }
+	  }
+	}
+	if(r == 0){
+	  break;
+	}
+      }
+    }
+  }
+}
+
+//distance: Returns the euclidean distance between two cities.
+float CityGrid::distance(int i, int j)
+{
+  float dx = Xcoords[i] - Xcoords[j];
+  float dy = Ycoords[i] - Ycoords[j];
+  return sqrtf(dx * dx + dy * dy);
+}
+
+//nearestTour: Writes a nearest neighbour tour from start into tour. Visited cities are swapped out of the live part of their cell, and each search stops at the first ring of cells that cannot hold anything closer.
+void CityGrid::nearestTour(int start, int* tour)
+{
+  std::vector<int> live(cellCities);
+  std::vector<int> cellCount(cols * rows);
+  std::vector<int> where(numCities); // Position of each city in live.
+  for(int c = 0; c < cols * rows; c++){
+    cellCount[c] = cellStart[c + 1] - cellStart[c];
+    for(int i = cellStart[c]; i < cellStart[c + 1]; i++){
+      where[live[i]] = i;
+    }
+  }
+  int current = start;
+  for(int x = 0; x < numCities; x++){
+    tour[x] = current;
+    //take current out of its cell
+    int c = cellOf(Xcoords[current], Ycoords[current]);
+    int last = cellStart[c] + --cellCount[c];
+    int moved = live[last];
+    live[where[current]] = moved;
+    where[moved] = where[current];
+    live[last] = current;
+    where[current] = last;
+    if(x == numCities - 1){
+      break;
+    }
+    int cx = c % cols;
+    int cy = c / cols;
+    int next = -1;
+    float best = FLT_MAX;
+    for(int r = 0; r <= cols || r <= rows; r++){
+      if(next >= 0 && best <= (r - 1) * cellSize){
+	break;
+      }
+      for(int y = cy - r; y <= cy + r; y++){
+	if(y < 0 || y >= rows){
+	  continue;
+	}
+	for(int x2 = cx - r; x2 <= cx + r; x2 += (y == cy - r || y == cy + r) ? 1 : 2 * r){
+	  if(x2 >= 0 && x2 < cols){
+	    int cell = y * cols + x2;
+	    for(int i = cellStart[cell]; i < cellStart[cell] + cellCount[cell]; i++){
+	      float d = distance(current, live[i]);
+	      if(d < best){
+		best = d;
+		next = live[i];
+	      }
+	    }
+	  }
+	  if(r == 0){
+	    break;
+	  }
+	}
+      }
+    }
+    current = next;
+  }
+}
+
+//curveTour: Writes the cities into tour in the order a Hilbert curve visits them, which is within a constant factor of optimal on uniform instances and takes one sort.
+void CityGrid::curveTour(int* tour)
+{
+  const unsigned int side = 1 << 16;
+  float scale = (side - 1) / fmaxf(cellSize * fmaxf(cols, rows), FLT_MIN);
+  std::vector<std::pair<unsigned long long, int> > order(numCities);
+  for(int i = 0; i < numCities; i++){
+    unsigned int x = (unsigned int)((Xcoords[i] - minX) * scale);
+    unsigned int y = (unsigned int)((Ycoords[i] - minY) * scale);
+    //distance along the curve, by rotating each quadrant into place
+    unsigned long long d = 0;
+    for(unsigned int s = side / 2; s > 0; s /= 2){
+      unsigned int rx = (x & s) > 0;
+      unsigned int ry = (y & s) > 0;
+      d += (unsigned long long)s * s * ((3 * rx) ^ ry);
+      if(ry == 0){
+	if(rx == 1){
+	  x = side - 1 - x;
+	  y = side - 1 - y;
+	}
+	unsigned int t = x;
+	x = y;
+	y = t;
+      }
+    }
+    order[i] = std::make_pair(d, i);
+  }
+  std::sort(order.begin(), order.end());
+  for(int i = 0; i < numCities; i++){
+    tour[i] = order[i].second;
+  }
+}
+
+//cellOf: Returns the cell containing the given point.
+int CityGrid::cellOf(float x, float y)
+{
+  int cx = (int)((x - minX) / cellSize);
+  int cy = (int)((y - minY) / cellSize);
+  if(cx >= cols) cx = cols - 1;
+  if(cy >= rows) cy = rows - 1;
+  return cy * cols + cx;
+}
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
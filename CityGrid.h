@@ -0,0 +1,49 @@
+/****************************************
+ * CityGrid.h                           *
+ * Peter Ahrens                         *
+ * Buckets cities for neighbour queries *
+ ****************************************/
+
+#ifndef CITYGRID_H
+#define CITYGRID_H
+#include <vector>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <utility>
+
+//CityGrid: A uniform grid over the city coordinates, used to find nearest neighbours without a distance matrix.
+class CityGrid
+{
+ public:
+  CityGrid(const float* newXcoords, const float* newYcoords, int newNumCities); // Buckets the cities into square cells holding about two cities each.
+  void nearest(int city, int k, int* result); // Writes the k nearest other cities to city into result, nearest first.
+  float distance(int i, int j); // Returns the euclidean distance between two cities.
+  void nearestTour(int start, int* tour); // Writes a nearest neighbour tour from start into tour, taking each visited city out of its cell so later searches skip it.
+  void curveTour(int* tour); // Writes the cities into tour in the order a Hilbert curve over the bounding square visits them.
+ private:
+  int cellOf(float x, float y); // Returns the cell containing the given point.
+  const float* Xcoords;
+  const float* Ycoords;
+  int numCities;
+  float minX;
+  float minY;
+  float cellSize;
+  int cols;
+  int rows;
+  std::vector<int> cellStart; // cellCities[cellStart[c]] to cellCities[cellStart[c+1]-1] are the cities in cell c.
+  std::vector<int> cellCities;
+};
+
+#endif
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
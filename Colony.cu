@@ -6,241 +6,666 @@
 
 #include "Colony.h"
 
-//Constructor: Sets defaults and allocates memory.
-Colony::Colony(thrust::host_vector<float> newDistances, int newNumCities, int newNumAnts)
+//Constructor: Allocates memory and sets defaults. Scratch memory waits for initialize, when the modes it depends on are known. The distance matrix is read in place from newDistances, so colonies built on the same matrix share it.
+template <typename City, typename Level, typename Backend>
+Colony<City,Level,Backend>::Colony(thrust::device_vector<float>& newDistances, float* newXcoords, float* newYcoords, int newNumCities, int newNumAnts)
+  : distances(newDistances.size() == 0 ? candidateLengths : newDistances)
 {
-  //defaults
-  beta = 5;
-  rho = 0.1;
   //world vars
-  reps = 0;
-  distances.assign(newDistances.begin(),newDistances.end());
   numCities = newNumCities;
-  probabilities = thrust::device_vector<float>(numCities*numCities);
-  pheromones = thrust::device_vector<float>(numCities*numCities);
+  matrixFree = newDistances.size() == 0;
+  keysBuilt = false;
+  resized = false;
+  profiler = 0;
+  if(!matrixFree){ //matrix-free storage is allocated by computeCandidates once numCandidates is known
+    probabilities = thrust::device_vector<Level>(numCities*numCities);
+    pheromones = thrust::device_vector<Level>(numCities*numCities);
+  }
   //ant vars
   numAnts = newNumAnts;
   antDistances = thrust::device_vector<float>(numAnts);
-  antVisits = thrust::device_vector<float>(numCities*numAnts);
-  toVisit = thrust::device_vector<int>(numCities*numAnts);
-  antTours = thrust::device_vector<int>(numCities*numAnts);
-  iterBestDist = std::numeric_limits<float>::max() - 1;
-  globBestDist = std::numeric_limits<float>::max();
-  iterBestTour = thrust::device_vector<int>(numCities);
-  globBestTour = thrust::device_vector<int>(numCities);
+  antTours = thrust::device_vector<City>(numCities*numAnts);
+  iterBestTour = thrust::device_vector<City>(numCities);
+  globBestTour = thrust::device_vector<City>(numCities);
   //maps and keys
   ACMapF = thrust::device_vector<int>(numAnts);
   ACMapL = thrust::device_vector<int>(numAnts);
-  tourMap = thrust::device_vector<int>(numAnts);
   distMap = thrust::device_vector<int>(numCities*numAnts);
   ACKey = thrust::device_vector<int>(numAnts*numCities);
-  ARepeatCMap = thrust::device_vector<int>(numAnts*numCities);
-  CCKey = thrust::device_vector<int>(numCities*numCities);
-  //scratch variables
-  AFloat = thrust::device_vector<float>(numAnts);
-  CInt = thrust::device_vector<int>(numCities);
-  CInt2 = thrust::device_vector<int>(numCities);
-  AInt = thrust::device_vector<int>(numAnts);
-  ACInt = thrust::device_vector<int>(numAnts*numCities);
-  ACInt2 = thrust::device_vector<int>(numAnts*numCities);
-  ACInt3 = thrust::device_vector<int>(numAnts*numCities);
-  ACFloat = thrust::device_vector<float>(numAnts*numCities);
-  CCFloat = thrust::device_vector<float>(numCities*numCities);
-  AUnsignedInt = thrust::device_vector<unsigned int>(numAnts);
-  //Random numbers
-  ARandom = thrust::device_vector<unsigned int>(numAnts);
-  ACRandom = thrust::device_vector<unsigned int>(numAnts*numCities);
-}
-
-//initialize: Initializes data, creates maps and keys, performs standard ACO initialization steps etc. 
-void Colony::initialize()
-{
-  //seed the random numbers
-  thrust::transform(thrust::make_counting_iterator(0),
-		    thrust::make_counting_iterator(numAnts*numCities),
-		    thrust::make_counting_iterator(time(NULL)),ACRandom.begin(),thrust::multiplies<int>());
-  thrust::transform(thrust::make_counting_iterator(0),
-		    thrust::make_counting_iterator(numAnts),
-		    thrust::make_counting_iterator(time(NULL)),
-		    ARandom.begin(),
-		    thrust::multiplies<int>());
-  //constant seeds
-  //thrust::transform(thrust::make_counting_iterator(0),thrust::make_counting_iterator(numAnts*numCities),thrust::make_constant_iterator(1),ACRandom.begin(),thrust::multiplies<int>());
-  //thrust::transform(thrust::make_counting_iterator(0),thrust::make_counting_iterator(numAnts),thrust::make_constant_iterator(1),ARandom.begin(),thrust::multiplies<int>());
-  thrust::transform(ACRandom.begin(),
-		    ACRandom.end(),
-		    ACRandom.begin(),
-		    randStep());
-  thrust::transform(ARandom.begin(),
-		    ARandom.end(),
-		    ARandom.begin(),
-		    randStep());
-  //create maps and keys
-  //CCKey
-  thrust::sequence(ACInt.begin(),
-		   ACInt.begin() + numCities, 
-		   0,
-		   numCities);
-  thrust::scatter(thrust::make_constant_iterator(1,0),
-		  thrust::make_constant_iterator(1,numCities),
-		  ACInt.begin(),
-		  CCKey.begin());
-  thrust::inclusive_scan(CCKey.begin(),
-			 CCKey.end(),
-			 CCKey.begin());
+  reset(newXcoords, newYcoords);
+}
+
+//reset: Sets defaults and forgets the instance, for a new one of the same size whose distances have been copied into the matrix this colony reads.
+//Every buffer and the maps and keys are kept, so the next initialize only performs the ACO initialization.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::reset(float* newXcoords, float* newYcoords)
+{
+  //defaults
+  beta = 5;
+  rho = 0.1;
+  fused = false;
+  numCandidates = matrixFree ? 10 : 0;
+  numNeighbors = 0;
+  localSearch = false;
+  localSearchTime = 0;
+  greedyLength = -1;
+  initialTour = TOUR_NEAREST;
+  seedTour = false;
+  explicitWeights = false;
+  greedyTour.clear();
+  pheromoneScale = 1;
+  seed = time(NULL);
+  iteration = 0;
+  exploitation = 0;
+  //world vars
+  reps = 0;
+  Xcoords.assign(newXcoords,newXcoords + numCities);
+  Ycoords.assign(newYcoords,newYcoords + numCities);
+  heuristics.clear();
+  candidates.clear();
+  //ant vars
+  iterBestDist = std::numeric_limits<float>::max() - 1;
+  globBestDist = std::numeric_limits<float>::max();
+}
+
+//initialize: Initializes data, creates maps and keys, performs standard ACO initialization steps etc. The rules of the variant have already set initialPheromone.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::initialize()
+{
+  //random numbers are drawn on demand, counting from the first iteration
+  iteration = 0;
+  //create maps and keys, which only depend on numCities and numAnts
+  if(!keysBuilt){
+    buildKeys();
+  }
+  //scratch buffers, laid out for the construction and local search in use
+  bool stepwise = !fused && numCandidates <= 0 && !matrixFree;
+  allocateScratch();
+  //ARepeatCMap, only read by the stepwise construction
+  if(stepwise && ARepeatCMap.size() == 0){
+    ARepeatCMap = thrust::device_vector<int>(numAnts*numCities);
+    buildRepeatMap();
+  }
+  //candidate lists
+  if(matrixFree && numCandidates <= 0){
+    numCandidates = 10;
+  }
+  if(numCandidates > 0 || localSearch){
+    computeCandidates();
+  }
+  //ACO Initialize
+  thrust::fill(exec,
+	       pheromones.begin(),
+	       pheromones.end(),
+	       initialPheromone);
+  pheromoneScale = 1;
+  computeProbabilities();
+  //the initial tour is the incumbent, so the first deposits already lay it
+  if(seedTour){
+    greedyDistance();
+    globBestTour = greedyTour;
+    globBestDist = greedyLength;
+  }
+}
+
+//buildKeys: Creates the maps and keys, which only depend on numCities and numAnts.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::buildKeys()
+{
   //ACMapF
-  thrust::sequence(ACMapF.begin(),
+  thrust::sequence(exec,
+		   ACMapF.begin(),
 		   ACMapF.end(),
 		   0,
 		   numCities);
   //ACMapL
-  thrust::transform(ACMapF.begin(),
+  thrust::transform(exec,
+		    ACMapF.begin(),
 		    ACMapF.end(),
 		    thrust::make_constant_iterator(numCities-1),
 		    ACMapL.begin(), 
 		    thrust::plus<int>());
-  //ACKey
-  thrust::scatter(thrust::make_constant_iterator(1,0),
+  //ACKey, cleared first since an edit rebuilds it in place
+  thrust::fill(exec,
+	       ACKey.begin(),
+	       ACKey.end(),
+	       0);
+  thrust::scatter(exec,
+		  thrust::make_constant_iterator(1,0),
 		  thrust::make_constant_iterator(1,numAnts),
 		  ACMapF.begin(),
 		  ACKey.begin());
-  thrust::inclusive_scan(ACKey.begin(),
+  thrust::inclusive_scan(exec,
+			 ACKey.begin(),
 			 ACKey.end(),
 			 ACKey.begin());
-  thrust::transform(ACKey.begin(), 
+  thrust::transform(exec,
+		    ACKey.begin(), 
 		    ACKey.end(), 
 		    thrust::make_constant_iterator(-1), 
 		    ACKey.begin(),
 		    thrust::plus<int>());
   //distMap
-  thrust::fill(distMap.begin(),
+  thrust::fill(exec,
+	       distMap.begin(),
 	       distMap.end(),
 	       1);
-  thrust::inclusive_scan_by_key(ACKey.begin(),
+  thrust::inclusive_scan_by_key(exec,
+				ACKey.begin(),
 				ACKey.end(),
 				distMap.begin(), 
 				distMap.begin());
-  thrust::scatter(thrust::make_constant_iterator(0,0),
+  thrust::scatter(exec,
+		  thrust::make_constant_iterator(0,0),
 		  thrust::make_constant_iterator(0,numAnts),
 		  ACMapL.begin(),
 		  distMap.begin());
-  thrust::transform(ACKey.begin(),
+  thrust::transform(exec,
+		    ACKey.begin(),
 		    ACKey.end(),
 		    distMap.begin(),
 		    distMap.begin(),
 		    saxpy_functor(numCities));
-  //ARepeatCMap
-  thrust::exclusive_scan_by_key(ACKey.begin(),
+  keysBuilt = true;
+}
+
+//buildRepeatMap: Numbers the entries of each ant's row of ACKey from 0, which the stepwise construction starts its list of cities to visit from.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::buildRepeatMap()
+{
+  thrust::exclusive_scan_by_key(exec,
+				ACKey.begin(),
 				ACKey.end(),
 				thrust::make_constant_iterator(1),
 				ARepeatCMap.begin());
-  //ACO Initialize
-  computeParameters();
-  thrust::fill(pheromones.begin(),
-	       pheromones.end(),
-	       initialPheromone);
-  computeProbabilities();
 }
 
-//forage: Main ACO loop. Performs the solution constructruction step, then updates distances, pheromones, probabilities.
-void Colony::forage()
+//reserveScratch: Reserves every scratch buffer with the parts of a forage it is live in. The stepwise construction's buffers and the local search's are only reserved if they run.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::reserveScratch(ScratchArena& arena, int numCities, int numAnts, bool stepwise, bool localSearch)
+{
+  arena.reserve("AFloat", numAnts, LIFE_CONSTRUCT | LIFE_SEARCH | LIFE_UPDATE);
+  arena.reserve("AInt", numAnts, LIFE_CONSTRUCT);
+  arena.reserve("ACInt", numAnts*numCities, LIFE_ALWAYS);
+  arena.reserve("ACInt2", numAnts*numCities, (stepwise ? LIFE_CONSTRUCT : 0) | LIFE_UPDATE);
+  arena.reserve("ACFloat", numAnts*numCities, LIFE_MEASURE | LIFE_UPDATE);
+  if(stepwise){
+    arena.reserve("AUnsignedInt", numAnts, LIFE_CONSTRUCT);
+    arena.reserve("tourMap", numAnts, LIFE_CONSTRUCT);
+    arena.reserve("antVisits", numAnts*numCities, LIFE_CONSTRUCT);
+    arena.reserve("toVisit", ((size_t)numAnts*numCities*sizeof(City) + 3)/4, LIFE_CONSTRUCT); //a narrow City packs several into a word
+  }
+  if(localSearch){
+    arena.reserve("ACInt3", numAnts*numCities, LIFE_SEARCH);
+  }
+}
+
+//allocateScratch: Lays out the scratch arena for the current construction and local search, and points the scratch buffers into it.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::allocateScratch()
+{
+  arena.clear();
+  reserveScratch(arena, numCities, numAnts, !fused && numCandidates <= 0 && !matrixFree, localSearch);
+  arena.allocate();
+  AFloat = arena.get<float>("AFloat");
+  AInt = arena.get<int>("AInt");
+  AUnsignedInt = arena.get<unsigned int>("AUnsignedInt");
+  tourMap = arena.get<int>("tourMap");
+  ACInt = arena.get<int>("ACInt");
+  ACInt2 = arena.get<int>("ACInt2");
+  ACInt3 = arena.get<int>("ACInt3");
+  ACFloat = arena.get<float>("ACFloat");
+  antVisits = arena.get<float>("antVisits");
+  toVisit = arena.get<City>("toVisit");
+}
+
+//estimateMemory: Returns the peak device bytes a colony with these settings and storage types needs, counting the distance matrix it reads, its scratch arena and the buffers rules gives for its variant.
+//Sorting the rows of an explicit matrix for candidate lists briefly takes three more numCities*numCities buffers in initialize, which is the peak if it happens.
+template <typename City, typename Level, typename Backend>
+size_t Colony<City,Level,Backend>::estimateMemory(int numCities, int numAnts, bool matrixFree, int numCandidates, bool fused, bool localSearch, bool explicitWeights, rulesMemoryFunction rules, int ranks)
+{
+  size_t n = numCities;
+  size_t m = numAnts;
+  bool stepwise = !fused && numCandidates <= 0 && !matrixFree;
+  size_t bytes = 0;
+  if(matrixFree){
+    size_t c = std::min(numCandidates > 0 ? numCandidates : 10, numCities - 1);
+    bytes += (8 + 2*sizeof(Level))*(n*c + 1) + sizeof(City)*n*c; //lengths, heuristics, pheromones, probabilities and candidates
+  }else{
+    bytes += (8 + 2*sizeof(Level))*n*n; //distances, heuristics, pheromones and probabilities
+    if(numCandidates > 0 || localSearch){
+      bytes += sizeof(City)*n*(numCandidates > 0 ? std::min(numCandidates, numCities - 1) : std::min(LS_NEIGHBORS, numCities - 1));
+      if(explicitWeights){
+	bytes += 12*n*n; //CCKey, neighbors and CCFloat of computeCandidates
+      }
+    }
+  }
+  bytes += sizeof(City)*n*m + (stepwise ? 12 : 8)*n*m; //antTours, distMap, ACKey and ARepeatCMap
+  bytes += (8 + 2*sizeof(City))*n + 24*m; //coordinates, best tours, ant distances and maps
+  bytes += rules(numCities, numAnts, ranks);
+  ScratchArena arena;
+  reserveScratch(arena, numCities, numAnts, stepwise, localSearch);
+  return bytes + arena.plan();
+}
+
+//fitMemory: Picks storage modes and at most numAnts ants that fit in budget bytes. Storage is tried densest first: the dense matrix with the construction asked for, then with the fused construction, which needs no stepwise buffers, then matrix-free.
+//The first that keeps every ant is taken, otherwise the one that keeps the most. Returns false if not even one ant fits.
+template <typename City, typename Level, typename Backend>
+bool Colony<City,Level,Backend>::fitMemory(size_t budget, int numCities, int& numAnts, bool& matrixFree, bool& fused, int numCandidates, bool localSearch, bool explicitWeights, rulesMemoryFunction rules, int ranks)
+{
+  bool modeFree[] = {false, false, true};
+  bool modeFused[] = {fused, true, true};
+  int best = -1;
+  int bestAnts = 0;
+  for(int k = matrixFree ? 2 : 0; k < 3; k++){
+    //the footprint grows with the ants, so search for the most that fit
+    int low = 0;
+    int high = numAnts;
+    while(low < high){
+      int mid = (low + high + 1) / 2;
+      if(estimateMemory(numCities, mid, modeFree[k], numCandidates, modeFused[k], localSearch, explicitWeights, rules, ranks) <= budget){
+	low = mid;
+      }else{
+	high = mid - 1;
+      }
+    }
+    if(low > bestAnts){
+      best = k;
+      bestAnts = low;
+    }
+    if(low == numAnts){
+      break;
+    }
+  }
+  if(best < 0){
+    return false;
+  }
+  numAnts = bestAnts;
+  matrixFree = modeFree[best];
+  fused = modeFused[best];
+  return true;
+}
+
+//printMemory: Prints the size of every device buffer, then the layout of the scratch arena.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::printMemory()
+{
+  cout << std::left << setw(16) << "distances" << distances.size()*sizeof(float) << (matrixFree ? "" : " (shared)") << "\n";
+  cout << std::left << setw(16) << "heuristics" << heuristics.size()*sizeof(float) << "\n";
+  cout << std::left << setw(16) << "pheromones" << pheromones.size()*sizeof(Level) << "\n";
+  cout << std::left << setw(16) << "probabilities" << probabilities.size()*sizeof(Level) << "\n";
+  cout << std::left << setw(16) << "candidates" << candidates.size()*sizeof(City) << "\n";
+  cout << std::left << setw(16) << "antTours" << antTours.size()*sizeof(City) << "\n";
+  cout << std::left << setw(16) << "distMap" << distMap.size()*sizeof(int) << "\n";
+  cout << std::left << setw(16) << "ACKey" << ACKey.size()*sizeof(int) << "\n";
+  cout << std::left << setw(16) << "ARepeatCMap" << ARepeatCMap.size()*sizeof(int) << "\n";
+  cout << std::left << setw(16) << "small buffers" << (Xcoords.size() + Ycoords.size() + antDistances.size() + ACMapF.size() + ACMapL.size())*4 + (iterBestTour.size() + globBestTour.size())*sizeof(City) << "\n";
+  arena.print();
+}
+
+//buildTours: Performs the solution constructruction step, then the local search if it is set, then measures the tours and updates records. The variant's forage lays pheromone after it.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::buildTours()
 { 
+  if(fused || numCandidates > 0){ //candidate lists are only read by the fused construction
+    constructToursFused();
+  }else{
+    constructToursStepwise();
+  }
+  iteration++;
+  if(localSearch){
+    timeval t1, t2;
+    gettimeofday(&t1,NULL);
+    profileStart(PHASE_SEARCH);
+    improveTours();
+    profileStop(PHASE_SEARCH, (8.0*numNeighbors + 16)*numAnts*numCities); //one pass over every ant's neighbour lists
+    gettimeofday(&t2,NULL);
+    localSearchTime = (t2.tv_sec - t1.tv_sec) + (t2.tv_usec - t1.tv_usec) * 1e-6;
+  }
+  computeAntDistances();
+}
+
+//constructToursStepwise: Builds all the tours one step at a time, moving every ant forward one city per pass.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::constructToursStepwise()
+{
   //initialize variables and select start cities
-  toVisit.assign(ARepeatCMap.begin(),ARepeatCMap.end());
-  ACInt2.assign(ACKey.begin(),ACKey.end());
-  thrust::fill(antVisits.begin(),
+  profileStart(PHASE_START);
+  toVisit.assign(exec,ARepeatCMap.begin(),ARepeatCMap.end());
+  ACInt2.assign(exec,ACKey.begin(),ACKey.end());
+  thrust::fill(exec,
+	       antVisits.begin(),
 	       antVisits.end(),
 	       0);
-  thrust::sequence(tourMap.begin(),
+  thrust::sequence(exec,
+		   tourMap.begin(),
 		   tourMap.end(),
 		   0,
 		   numCities);
-  thrust::transform(ARandom.begin(), 
-		    ARandom.end(),
-		    ARandom.begin(),
-		    randStep());
-  thrust::transform(ARandom.begin(),
-		    ARandom.end(),
+  thrust::transform(exec,
+		    thrust::make_transform_iterator(thrust::make_counting_iterator(0),counterRandom(seed,iteration,0)),
+		    thrust::make_transform_iterator(thrust::make_counting_iterator(numAnts),counterRandom(seed,iteration,0)),
 		    thrust::make_constant_iterator(numCities), 
 		    thrust::make_permutation_iterator(antTours.begin(),tourMap.begin()), 
 		    thrust::modulus<unsigned int>());
-  thrust::transform(ACMapF.begin(),
+  thrust::transform(exec,
+		    ACMapF.begin(),
 		    ACMapF.end(),
 		    thrust::make_permutation_iterator(antTours.begin(),tourMap.begin()),
 		    AInt.begin(),
 		    thrust::plus<int>());
+  profileStop(PHASE_START, 20.0*numAnts*numCities); //copying toVisit and ACInt2, clearing antVisits
   for(int x = 1; x < numCities; x++)
     {
+      profileStart(PHASE_STEP);
       //update antVisits
-      thrust::scatter(thrust::make_constant_iterator(x,0),
+      thrust::scatter(exec,
+		      thrust::make_constant_iterator(x,0),
 		      thrust::make_constant_iterator(x,numAnts), 
 		      AInt.begin(),
 		      antVisits.begin());
-      thrust::remove_if(thrust::make_zip_iterator(thrust::make_tuple(toVisit.begin(),
+      thrust::remove_if(exec,
+			thrust::make_zip_iterator(thrust::make_tuple(toVisit.begin(),
 								     ACInt2.begin())), 
 			thrust::make_zip_iterator(thrust::make_tuple(toVisit.begin() + ((numCities-x + 1) * numAnts),
 								     ACInt2.begin()+ ((numCities-x + 1) * numAnts))),
 			antVisits.begin(),isX(x));
       //get probabilities
-      thrust::transform(thrust::make_permutation_iterator(thrust::make_permutation_iterator(antTours.begin(),tourMap.begin()),ACInt2.begin()),
+      thrust::transform(exec,
+			thrust::make_permutation_iterator(thrust::make_permutation_iterator(antTours.begin(),tourMap.begin()),ACInt2.begin()),
 			thrust::make_permutation_iterator(thrust::make_permutation_iterator(antTours.end(),tourMap.end()),ACInt2.begin()+ ((numCities-x) * numAnts)),
 			toVisit.begin(),
 			ACInt.begin(),
 			saxpy_functor(numCities));
       //update tour map
-      thrust::transform(tourMap.begin(),
+      thrust::transform(exec,
+			tourMap.begin(),
 			tourMap.end(),
 			tourMap.begin(),
 			unaryPlus(1));
-      //update random numbers
-      thrust::transform(ACRandom.begin(),
-			ACRandom.begin() + ((numCities-x + 1) * numAnts), 
-			ACRandom.begin(),
-			randStep());
+      profileStop(PHASE_STEP, 40.0*(numCities-x)*numAnts); //compacting toVisit and ACInt2, gathering probability indices
       //select cities
-      thrust::reduce_by_key(ACInt2.begin(),
+      profileStart(PHASE_SELECT);
+      thrust::reduce_by_key(exec,
+			    ACInt2.begin(),
 			    ACInt2.begin()+ ((numCities-x) * numAnts),
 			    thrust::make_zip_iterator(thrust::make_tuple(thrust::make_counting_iterator(0),
-									 thrust::make_permutation_iterator(probabilities.begin(),ACInt.begin()),
-									 ACRandom.begin())),
+									 thrust::make_transform_iterator(thrust::make_permutation_iterator(probabilities.begin(),ACInt.begin()),levelToFloat<Level>()),
+									 thrust::make_transform_iterator(thrust::make_counting_iterator(0),counterRandom(seed,iteration,x)))),
 			    thrust::make_discard_iterator(),
 			    thrust::make_zip_iterator(thrust::make_tuple(AInt.begin(),
 									 AFloat.begin(),
 									 AUnsignedInt.begin())),
 			    thrust::equal_to<int>(),
 			    treeSelect());
-      thrust::gather(AInt.begin(),
+      thrust::gather(exec,
+		     AInt.begin(),
 		     AInt.end(),
 		     toVisit.begin(),
 		     thrust::make_permutation_iterator(antTours.begin(),tourMap.begin()));
+      profileStop(PHASE_SELECT, 12.0*(numCities-x)*numAnts + 24.0*numAnts); //keys, indices and probabilities in, one choice per ant out
     }
-  computeAntDistances();
-  updatePheromones();
-  computeProbabilities();
+}
+
+//constructToursFused: Builds all the tours at once, one ant per task. Each ant draws its start city and then each next city by roulette over the probabilities of its unvisited cities, as in constructToursStepwise.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::constructToursFused()
+{
+  profileStart(PHASE_STEP);
+  thrust::transform(exec,
+		    thrust::make_counting_iterator(0),
+		    thrust::make_counting_iterator(numAnts),
+		    AInt.begin(),
+		    tourConstruct<City,Level>(thrust::raw_pointer_cast(&probabilities[0]),
+				  numCandidates > 0 ? thrust::raw_pointer_cast(&candidates[0]) : 0,
+				  matrixFree ? thrust::raw_pointer_cast(&Xcoords[0]) : 0,
+				  matrixFree ? thrust::raw_pointer_cast(&Ycoords[0]) : 0,
+				  thrust::raw_pointer_cast(&antTours[0]),
+				  thrust::raw_pointer_cast(&ACInt[0]),
+				  numCities,
+				  numCandidates,
+				  seed,
+				  iteration,
+				  exploitation));
+  //each ant reads the probabilities of its unvisited cities, or of its candidates, twice a step
+  profileStop(PHASE_STEP, numCandidates > 0 ? 16.0*numAnts*numCities*numCandidates : 4.0*numAnts*numCities*numCities);
+}
+
+//improveTours: Runs 2-opt and Or-opt on every ant's tour in parallel, one ant per task, until no move in the neighbour lists improves it.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::improveTours()
+{
+  thrust::transform(exec,
+		    thrust::make_counting_iterator(0),
+		    thrust::make_counting_iterator(numAnts),
+		    AFloat.begin(),
+		    tourImprove<City>(matrixFree ? 0 : thrust::raw_pointer_cast(&distances[0]),
+				matrixFree ? thrust::raw_pointer_cast(&Xcoords[0]) : 0,
+				matrixFree ? thrust::raw_pointer_cast(&Ycoords[0]) : 0,
+				numNeighbors > 0 ? thrust::raw_pointer_cast(&candidates[0]) : 0,
+				thrust::raw_pointer_cast(&antTours[0]),
+				thrust::raw_pointer_cast(&ACInt[0]),
+				thrust::raw_pointer_cast(&ACInt3[0]),
+				numCities,
+				numNeighbors));
+}
+
+//computeCandidates: Builds the list of the numNeighbors nearest neighbours of each city, unless setCandidates has already given it.
+//The lists are numCandidates long if construction uses them, or LS_NEIGHBORS long if only the local search does. They come from a CityGrid over the coordinates, unless the weights are explicit, when the rows of the matrix are sorted instead.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::computeCandidates()
+{
+  if(numCandidates >= numCities){
+    numCandidates = numCities - 1;
+  }
+  numNeighbors = numCandidates > 0 ? numCandidates : std::min(LS_NEIGHBORS,numCities - 1);
+  bool given = candidates.size() == numCities*numNeighbors;
+  if(matrixFree){
+    //query a spatial grid for the neighbours, then store only the candidate edges and one spare slot
+    thrust::host_vector<float> X(Xcoords.begin(),Xcoords.end());
+    thrust::host_vector<float> Y(Ycoords.begin(),Ycoords.end());
+    CityGrid grid(&X[0],&Y[0],numCities);
+    thrust::host_vector<int> near(candidates.begin(),candidates.end());
+    near.resize(numCities*numNeighbors);
+    thrust::host_vector<float> lengths(numCities*numNeighbors + 1);
+#pragma omp parallel for
+    for(int i = 0; i < numCities; i++){
+      if(!given){
+	grid.nearest(i,numNeighbors,&near[i*numNeighbors]);
+      }
+      for(int c = 0; c < numNeighbors; c++){
+	lengths[i*numNeighbors + c] = grid.distance(i,near[i*numNeighbors + c]);
+      }
+    }
+    lengths[numCities*numNeighbors] = std::numeric_limits<float>::max();
+    candidates = near;
+    distances = lengths;
+    pheromones = thrust::device_vector<Level>(numCities*numNeighbors + 1);
+    probabilities = thrust::device_vector<Level>(numCities*numNeighbors + 1);
+    return;
+  }
+  if(given){
+    return;
+  }
+  if(!explicitWeights){
+    //the distances follow the coordinates, so the spatial grid finds the neighbours in O(n*k) without sorting the matrix
+    thrust::host_vector<float> X(Xcoords.begin(),Xcoords.end());
+    thrust::host_vector<float> Y(Ycoords.begin(),Ycoords.end());
+    CityGrid grid(&X[0],&Y[0],numCities);
+    thrust::host_vector<int> near(numCities*numNeighbors);
+#pragma omp parallel for
+    for(int i = 0; i < numCities; i++){
+      grid.nearest(i,numNeighbors,&near[i*numNeighbors]);
+    }
+    candidates = near;
+    return;
+  }
+  //explicit weights are only known through the matrix, so every row of it is sorted
+  candidates = thrust::device_vector<City>(numCities*numNeighbors);
+  //CCKey
+  CCKey = thrust::device_vector<int>(numCities*numCities);
+  thrust::sequence(exec,
+		   ACInt.begin(),
+		   ACInt.begin() + numCities, 
+		   0,
+		   numCities);
+  thrust::scatter(exec,
+		  thrust::make_constant_iterator(1,0),
+		  thrust::make_constant_iterator(1,numCities),
+		  ACInt.begin(),
+		  CCKey.begin());
+  thrust::inclusive_scan(exec,
+			 CCKey.begin(),
+			 CCKey.end(),
+			 CCKey.begin());
+  //sort every row of the distances by length, keeping the rows apart with CCKey
+  thrust::device_vector<int> neighbors(numCities*numCities);
+  thrust::transform(exec,
+		    thrust::make_counting_iterator(0),
+		    thrust::make_counting_iterator(numCities*numCities),
+		    thrust::make_constant_iterator(numCities),
+		    neighbors.begin(),
+		    thrust::modulus<int>());
+  CCFloat.assign(distances.begin(),distances.end());
+  thrust::stable_sort_by_key(exec,
+			     CCFloat.begin(),
+			     CCFloat.end(),
+			     thrust::make_zip_iterator(thrust::make_tuple(CCKey.begin(),
+									  neighbors.begin())));
+  thrust::stable_sort_by_key(exec,
+			     CCKey.begin(),
+			     CCKey.end(),
+			     neighbors.begin());
+  //keep the nearest numNeighbors of each row
+  thrust::gather(exec,
+		 thrust::make_transform_iterator(thrust::make_counting_iterator(0),candidateMap(numCities,numNeighbors)),
+		 thrust::make_transform_iterator(thrust::make_counting_iterator(numCities*numNeighbors),candidateMap(numCities,numNeighbors)),
+		 neighbors.begin(),
+		 candidates.begin());
+  //the numCities*numCities scratch is only needed here
+  thrust::device_vector<int>().swap(CCKey);
+  thrust::device_vector<float>().swap(CCFloat);
+}
+
+//setCandidates: Gives precomputed candidate lists, so initialize does not rebuild them. They are only used if newNumCandidates matches numCandidates at initialize.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::setCandidates(const thrust::host_vector<int>& newCandidates, int newNumCandidates)
+{
+  if(newNumCandidates == numCandidates && newCandidates.size() == numCities*newNumCandidates){
+    candidates = newCandidates;
+  }
+}
+
+//getCandidates: Returns a host copy of the candidate lists.
+template <typename City, typename Level, typename Backend>
+thrust::host_vector<int> Colony<City,Level,Backend>::getCandidates()
+{
+  return thrust::host_vector<int>(candidates.begin(),candidates.end());
+}
+
+//computeEdges: Computes the index into pheromones of every edge of the given tours.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::computeEdges(thrust::device_vector<City>& tours, arenaSpan<int> edges)
+{
+  if(matrixFree){
+    thrust::transform(exec,
+		      tours.begin(),
+		      tours.end(),
+		      thrust::make_permutation_iterator(tours.begin(),distMap.begin()),
+		      edges.begin(),
+		      candidateSlot<City>(thrust::raw_pointer_cast(&candidates[0]),numCities,numCandidates));
+  }else{
+    thrust::transform(exec,
+		      tours.begin(),
+		      tours.end(),
+		      thrust::make_permutation_iterator(tours.begin(),distMap.begin()),
+		      edges.begin(),
+		      saxpy_functor(numCities));
+  }
+}
+
+//computeEdges: Computes the index into pheromones of every edge of the tours of the first numTours ants in order, one tour after the other. Only those tours are read, so a few picked ants cost a few tours, not the whole colony.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::computeEdges(thrust::device_vector<City>& tours, const int* order, int numTours, arenaSpan<int> edges)
+{
+  thrust::transform_iterator<pickedEdge, thrust::counting_iterator<int> > picked = thrust::make_transform_iterator(thrust::make_counting_iterator(0),pickedEdge(order,numCities));
+  if(matrixFree){
+    thrust::transform(exec,
+		      thrust::make_permutation_iterator(tours.begin(),picked),
+		      thrust::make_permutation_iterator(tours.begin(),picked + numTours*numCities),
+		      thrust::make_permutation_iterator(tours.begin(),thrust::make_permutation_iterator(distMap.begin(),picked)),
+		      edges.begin(),
+		      candidateSlot<City>(thrust::raw_pointer_cast(&candidates[0]),numCities,numCandidates));
+  }else{
+    thrust::transform(exec,
+		      thrust::make_permutation_iterator(tours.begin(),picked),
+		      thrust::make_permutation_iterator(tours.begin(),picked + numTours*numCities),
+		      thrust::make_permutation_iterator(tours.begin(),thrust::make_permutation_iterator(distMap.begin(),picked)),
+		      edges.begin(),
+		      saxpy_functor(numCities));
+  }
+}
+
+//computeCandidateEdges: Computes the index into pheromones of every edge of the given tours that is on the candidate list of the city it leaves, and returns how many there are. Each edge is kept once, however many tours take it.
+template <typename City, typename Level, typename Backend>
+int Colony<City,Level,Backend>::computeCandidateEdges(thrust::device_vector<City>& tours, arenaSpan<int> edges)
+{
+  thrust::transform(exec,
+		    tours.begin(),
+		    tours.end(),
+		    thrust::make_permutation_iterator(tours.begin(),distMap.begin()),
+		    edges.begin(),
+		    candidateEdge<City>(thrust::raw_pointer_cast(&candidates[0]),numCities,numCandidates,matrixFree));
+  int numEdges = thrust::remove_if(exec,
+				   edges.begin(),
+				   edges.begin() + tours.size(),
+				   isX(-1)) - edges.begin();
+  thrust::sort(exec,
+	       edges.begin(),
+	       edges.begin() + numEdges);
+  return thrust::unique(exec,
+			edges.begin(),
+			edges.begin() + numEdges) - edges.begin();
 }
 
 //computeAntDistances: Computes the distances of each ant's tour, then updates records.
-void Colony::computeAntDistances()
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::computeAntDistances()
 {
+  profileStart(PHASE_MEASURE);
   //compute distances
-  thrust::transform(antTours.begin(),
-		    antTours.end(), 
-		    thrust::make_permutation_iterator(antTours.begin(),distMap.begin()),
-		    ACInt.begin(),
-		    saxpy_functor(numCities));	
-  thrust::gather(ACInt.begin(),
-		 ACInt.end(),
-		 distances.begin(),
-		 ACFloat.begin());
-  thrust::reduce_by_key(ACKey.begin(),
+  if(matrixFree){
+    thrust::transform(exec,
+		      antTours.begin(),
+		      antTours.end(),
+		      thrust::make_permutation_iterator(antTours.begin(),distMap.begin()),
+		      ACFloat.begin(),
+		      coordDistance(thrust::raw_pointer_cast(&Xcoords[0]),thrust::raw_pointer_cast(&Ycoords[0])));
+  }else{
+    thrust::transform(exec,
+		      antTours.begin(),
+		      antTours.end(), 
+		      thrust::make_permutation_iterator(antTours.begin(),distMap.begin()),
+		      ACInt.begin(),
+		      saxpy_functor(numCities));	
+    thrust::gather(exec,
+		   ACInt.begin(),
+		   ACInt.end(),
+		   distances.begin(),
+		   ACFloat.begin());
+  }
+  thrust::reduce_by_key(exec,
+			ACKey.begin(),
 			ACKey.end(),
 			ACFloat.begin(),
 			thrust::make_discard_iterator(),
 			antDistances.begin());
   //update bests
-  int i = thrust::min_element(antDistances.begin(),
+  int i = thrust::min_element(exec,
+			      antDistances.begin(),
 			      antDistances.end()) - antDistances.begin();
-  thrust::gather(thrust::make_counting_iterator(i*numCities),
+  thrust::gather(exec,
+		 thrust::make_counting_iterator(i*numCities),
 		 thrust::make_counting_iterator((i+1)*numCities),
 		 antTours.begin(),
 		 iterBestTour.begin());
@@ -252,95 +677,886 @@ void Colony::computeAntDistances()
   }else{
     reps++;
   }
+  profileStop(PHASE_MEASURE, 36.0*numAnts*numCities); //edge indices, edge lengths and the reduce over them
 }
 
-//greedyDistance: Returns the value of a simple greedy solution starting at city 0.
-float Colony::greedyDistance()
+//greedyDistance: Returns the length of a quick initial tour, by default the nearest neighbour tour from city 0. It is only computed once, or not at all if setGreedyDistance gave it and the tour itself is not needed to seed globBestTour.
+//Coordinate instances build the tour on the host with a CityGrid. Explicit weights without coordinates fall back to searching the rows of the matrix on the device.
+template <typename City, typename Level, typename Backend>
+float Colony<City,Level,Backend>::greedyDistance()
 {
-  float distance;
-  int i = 0;
-  int init = i;
-  thrust::device_vector<int> visits(numCities);
-  thrust::fill(visits.begin(),
-	       visits.end(),
-	       1);
-  thrust::device_vector<float> Cfloat(numCities);
-  int j;
-  for(int x = 1; x < numCities; x++){
-    visits[i] = 0;
-    thrust::transform(visits.begin(),
-		      visits.end(),
-		      thrust::make_permutation_iterator(distances.begin(),thrust::make_counting_iterator(i*numCities)),
-		      Cfloat.begin(),
-		      thrust::divides<float>());
-    j = thrust::max_element(Cfloat.begin(),
-			    Cfloat.end()) - Cfloat.begin();
-    distance += distances[numCities * i + j];
-    i = j;
-  }
-  distance += distances[numCities * i + init];
-  return distance;
-}
-
-//computeProbabilities: Computes the probabilities from the distances and pheromones.
-void Colony::computeProbabilities()
-{
-  thrust::transform(pheromones.begin(),
+  if(greedyLength >= 0 && (!seedTour || greedyTour.size() == numCities)){
+    return greedyLength;
+  }
+  thrust::host_vector<float> X(Xcoords.begin(),Xcoords.end());
+  thrust::host_vector<float> Y(Ycoords.begin(),Ycoords.end());
+  bool spread = false; //explicit weights without display data put every city at the origin
+  for(int i = 1; i < numCities && !spread; i++){
+    spread = X[i] != X[0] || Y[i] != Y[0];
+  }
+  thrust::host_vector<int> tour(numCities);
+  if(spread || matrixFree){
+    CityGrid grid(&X[0],&Y[0],numCities);
+    if(initialTour == TOUR_CURVE){
+      grid.curveTour(&tour[0]);
+    }else{
+      grid.nearestTour(0,&tour[0]);
+    }
+  }else{
+    thrust::device_vector<int> visits(numCities);
+    thrust::fill(exec,
+		 visits.begin(),
+		 visits.end(),
+		 1);
+    thrust::device_vector<float> Cfloat(numCities);
+    int i = 0;
+    tour[0] = i;
+    for(int x = 1; x < numCities; x++){
+      visits[i] = 0;
+      thrust::transform(exec,
+			visits.begin(),
+			visits.end(),
+			thrust::make_permutation_iterator(distances.begin(),thrust::make_counting_iterator(i*numCities)),
+			Cfloat.begin(),
+			thrust::divides<float>());
+      i = thrust::max_element(exec,
+			      Cfloat.begin(),
+			      Cfloat.end()) - Cfloat.begin();
+      tour[x] = i;
+    }
+  }
+  greedyLength = tourLength(tour);
+  if(seedTour){
+    greedyTour = tour;
+  }
+  return greedyLength;
+}
+
+//tourLength: Returns the length of a whole tour, from the coordinates in matrix-free mode and from one reduce over the matrix otherwise.
+template <typename City, typename Level, typename Backend>
+float Colony<City,Level,Backend>::tourLength(const thrust::host_vector<int>& tour)
+{
+  float length = 0;
+  if(matrixFree){
+    thrust::host_vector<float> X(Xcoords.begin(),Xcoords.end());
+    thrust::host_vector<float> Y(Ycoords.begin(),Ycoords.end());
+    for(int k = 0; k < numCities; k++){
+      length += coordDistance(&X[0],&Y[0])(tour[k],tour[(k + 1) % numCities]);
+    }
+  }else{
+    thrust::device_vector<int> deviceTour = tour;
+    length = thrust::transform_reduce(exec,
+				      thrust::make_counting_iterator(0),
+				      thrust::make_counting_iterator(numCities),
+				      tourEdgeLength(thrust::raw_pointer_cast(&distances[0]),thrust::raw_pointer_cast(&deviceTour[0]),numCities),
+				      0.0f,
+				      thrust::plus<float>());
+  }
+  return length;
+}
+
+//computeProbabilities: Computes all the probabilities from the heuristics and pheromones, computing the heuristics first if they are missing.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::computeProbabilities()
+{
+  profileStart(PHASE_PROBABILITIES);
+  if(heuristics.size() != distances.size()){
+    heuristics.resize(distances.size()); //a reset colony reuses its old storage
+    thrust::transform(exec,
+		      distances.begin(),
+		      distances.end(),
+		      heuristics.begin(),
+		      heuristic_functor(beta));
+  }
+  thrust::transform(exec,
+		    pheromones.begin(),
 		    pheromones.end(),
-		    distances.begin(),
+		    heuristics.begin(),
 		    probabilities.begin(),
-		    prob_functor(beta));
+		    thrust::multiplies<float>());
+  profileStop(PHASE_PROBABILITIES, 12.0*pheromones.size());
+}
+
+//evaporate: Multiplies every pheromone level by factor. Only pheromoneScale changes, which leaves the probabilities in proportion, until the scale is small enough to be folded back into pheromones.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::evaporate(float factor)
+{
+  pheromoneScale *= factor;
+  if(pheromoneScale < PHEROMONE_MIN_SCALE){
+    thrust::transform(exec,
+		      pheromones.begin(),
+		      pheromones.end(),
+		      thrust::make_constant_iterator(pheromoneScale),
+		      pheromones.begin(),
+		      thrust::multiplies<float>());
+    pheromoneScale = 1;
+    computeProbabilities();
+  }
+}
+
+//depositPheromones: Adds amounts to the first numEdges edges, which must be distinct, and refreshes their probabilities.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::depositPheromones(arenaSpan<int> edges, arenaSpan<float> amounts, int numEdges)
+{
+  thrust::transform(exec,
+		    thrust::make_permutation_iterator(pheromones.begin(),edges.begin()),
+		    thrust::make_permutation_iterator(pheromones.begin(),edges.begin() + numEdges),
+		    amounts.begin(),
+		    thrust::make_permutation_iterator(pheromones.begin(),edges.begin()),
+		    scaledPlus(pheromoneScale));
+  thrust::transform(exec,
+		    thrust::make_permutation_iterator(pheromones.begin(),edges.begin()),
+		    thrust::make_permutation_iterator(pheromones.begin(),edges.begin() + numEdges),
+		    thrust::make_permutation_iterator(heuristics.begin(),edges.begin()),
+		    thrust::make_permutation_iterator(probabilities.begin(),edges.begin()),
+		    thrust::multiplies<float>());
+}
+
+//blendPheromones: Moves the first numEdges edges, which must be distinct, to keep times their level plus 1-keep times target, and refreshes their probabilities. The Ant Colony System updates pheromones this way instead of evaporating every edge.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::blendPheromones(arenaSpan<int> edges, int numEdges, float keep, float target)
+{
+  thrust::transform(exec,
+		    thrust::make_permutation_iterator(pheromones.begin(),edges.begin()),
+		    thrust::make_permutation_iterator(pheromones.begin(),edges.begin() + numEdges),
+		    thrust::make_permutation_iterator(pheromones.begin(),edges.begin()),
+		    blendLevel(keep,(1.0f - keep) * target / pheromoneScale));
+  thrust::transform(exec,
+		    thrust::make_permutation_iterator(pheromones.begin(),edges.begin()),
+		    thrust::make_permutation_iterator(pheromones.begin(),edges.begin() + numEdges),
+		    thrust::make_permutation_iterator(heuristics.begin(),edges.begin()),
+		    thrust::make_permutation_iterator(probabilities.begin(),edges.begin()),
+		    thrust::multiplies<float>());
+}
+
+//boundPheromones: Clamps every pheromone level to [low, high] and recomputes all the probabilities. The bounds are divided by pheromoneScale, since that is how the levels are stored.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::boundPheromones(float low, float high)
+{
+  thrust::transform(exec,
+		    pheromones.begin(),
+		    pheromones.end(),
+		    pheromones.begin(),
+		    clampLevel(low / pheromoneScale,high / pheromoneScale));
+  computeProbabilities();
+}
+
+//profileStart: Starts the timer of a phase, if there is a profiler.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::profileStart(int phase)
+{
+  if(profiler){
+    profiler->start(phase);
+  }
+}
+
+//profileStop: Stops the timer of a phase and counts the bytes it touched, if there is a profiler.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::profileStop(int phase, double bytes)
+{
+  if(profiler){
+    profiler->stop(phase, bytes);
+  }
 }
 
-void Colony::setBeta(float newBeta)
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::setProfiler(Profiler* newProfiler)
+{
+  profiler = newProfiler;
+}
+
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::setBeta(float newBeta)
 {
   beta = newBeta;
+  heuristics.clear(); //recomputed with the new beta by the next computeProbabilities
 }
 
-void Colony::setRho(float newRho)
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::setRho(float newRho)
 {
   rho = newRho;
 }
 
-double Colony::getBeta()
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::setFused(bool newFused)
+{
+  fused = newFused;
+}
+
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::setNumCandidates(int newNumCandidates)
+{
+  numCandidates = newNumCandidates;
+}
+
+template <typename City, typename Level, typename Backend>
+double Colony<City,Level,Backend>::getBeta()
 {
   return beta;
 }
 
-double Colony::getRho()
+template <typename City, typename Level, typename Backend>
+double Colony<City,Level,Backend>::getRho()
 {
   return rho;
 }
 
-int Colony::getNumAnts()
+template <typename City, typename Level, typename Backend>
+bool Colony<City,Level,Backend>::getFused()
+{
+  return fused;
+}
+
+template <typename City, typename Level, typename Backend>
+bool Colony<City,Level,Backend>::getMatrixFree()
+{
+  return matrixFree;
+}
+
+template <typename City, typename Level, typename Backend>
+int Colony<City,Level,Backend>::getNumCandidates()
+{
+  return numCandidates;
+}
+
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::setGreedyDistance(float newGreedyDistance)
+{
+  greedyLength = newGreedyDistance;
+}
+
+template <typename City, typename Level, typename Backend>
+float Colony<City,Level,Backend>::getGreedyDistance()
+{
+  return greedyDistance();
+}
+
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::setInitialTour(int newInitialTour)
+{
+  initialTour = newInitialTour;
+}
+
+template <typename City, typename Level, typename Backend>
+int Colony<City,Level,Backend>::getInitialTour()
+{
+  return initialTour;
+}
+
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::setSeedTour(bool newSeedTour)
+{
+  seedTour = newSeedTour;
+}
+
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::setExplicitWeights(bool newExplicitWeights)
+{
+  explicitWeights = newExplicitWeights;
+}
+
+template <typename City, typename Level, typename Backend>
+bool Colony<City,Level,Backend>::getExplicitWeights()
+{
+  return explicitWeights;
+}
+
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::setLocalSearch(bool newLocalSearch)
+{
+  localSearch = newLocalSearch;
+}
+
+template <typename City, typename Level, typename Backend>
+bool Colony<City,Level,Backend>::getLocalSearch()
+{
+  return localSearch;
+}
+
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::setSeed(unsigned int newSeed)
+{
+  seed = newSeed;
+}
+
+template <typename City, typename Level, typename Backend>
+unsigned int Colony<City,Level,Backend>::getSeed()
+{
+  return seed;
+}
+
+template <typename City, typename Level, typename Backend>
+double Colony<City,Level,Backend>::getLocalSearchTime()
+{
+  return localSearchTime;
+}
+
+template <typename City, typename Level, typename Backend>
+int Colony<City,Level,Backend>::getNumAnts()
 {
   return numAnts;
 }
 
-double Colony::getIterBestDist()
+template <typename City, typename Level, typename Backend>
+double Colony<City,Level,Backend>::getIterBestDist()
 {
   return iterBestDist;
 }
 
-double Colony::getGlobBestDist()
+template <typename City, typename Level, typename Backend>
+double Colony<City,Level,Backend>::getGlobBestDist()
 {
   return globBestDist;
 }
 
-int Colony::getReps()
+//getState: Copies everything needed to carry on from here into state. Only the pheromones are large, and they come off the device in one copy.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::getState(colonyState& state)
+{
+  memset(&state.header, 0, sizeof(state.header));
+  state.header.numCities = numCities;
+  state.header.numAnts = numAnts;
+  state.header.matrixFree = matrixFree;
+  state.header.numCandidates = numCandidates;
+  state.header.reps = reps;
+  state.header.seed = seed;
+  state.header.iteration = iteration;
+  state.header.beta = beta;
+  state.header.rho = rho;
+  state.header.pheromoneScale = pheromoneScale;
+  state.header.globBestDist = globBestDist;
+  state.header.greedyLength = greedyLength;
+  state.pheromones.assign(pheromones.begin(),pheromones.end());
+  state.globBestTour.assign(globBestTour.begin(),globBestTour.end());
+  if(matrixFree){
+    state.candidates.assign(candidates.begin(),candidates.end());
+  }else{
+    state.candidates.clear();
+  }
+}
+
+//setState: Restores a state taken by getState, after initialize has laid the colony out. The state's parameters replace the configured ones, so the run carries on as it would have.
+//Returns false and changes nothing if the state is of a colony of another size or storage mode.
+template <typename City, typename Level, typename Backend>
+bool Colony<City,Level,Backend>::setState(const colonyState& state)
+{
+  const checkpointHeader& header = state.header;
+  if(header.numCities != numCities || header.numAnts != numAnts || (bool)header.matrixFree != matrixFree || header.numPheromones != pheromones.size()){
+    cout << "The checkpoint is of a " << header.numCities << " city, " << header.numAnts << " ant" << (header.matrixFree ? " matrix-free" : "") << " colony\n";
+    return false;
+  }
+  if(matrixFree && !(getCandidates() == state.candidates)){
+    cout << "The checkpoint was taken with other candidate lists\n";
+    return false;
+  }
+  if(header.beta != beta){
+    setBeta(header.beta);
+  }
+  rho = header.rho;
+  reps = header.reps;
+  seed = header.seed;
+  iteration = header.iteration;
+  greedyLength = header.greedyLength;
+  pheromones = state.pheromones;
+  pheromoneScale = header.pheromoneScale;
+  globBestTour = state.globBestTour;
+  globBestDist = header.globBestDist;
+  computeProbabilities();
+  return true;
+}
+
+//warmStart: Lays weight times the initial pheromone level on both directions of every edge of a tour from an earlier solve, so construction starts out near it.
+//The tour may be from a slightly different instance: cities out of range or repeated are skipped. If it visits every city once, it also becomes the global best.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::warmStart(const thrust::host_vector<int>& tour, float weight)
+{
+  std::vector<int> kept;
+  std::vector<bool> seen(numCities, false);
+  for(int k = 0; k < tour.size(); k++){
+    if(tour[k] >= 0 && tour[k] < numCities && !seen[tour[k]]){
+      seen[tour[k]] = true;
+      kept.push_back(tour[k]);
+    }
+  }
+  if(kept.size() < 2){
+    cout << "The warm start tour has no edges in this instance\n";
+    return;
+  }
+  thrust::host_vector<int> candidateList;
+  if(matrixFree){
+    candidateList = candidates;
+  }
+  std::vector<int> edges;
+  for(int k = 0; k < kept.size(); k++){
+    int from = kept[k];
+    int to = kept[(k + 1) % kept.size()];
+    if(matrixFree){
+      //only candidate edges have pheromone, the rest share the spare slot
+      int slot = candidateSlot<int>(&candidateList[0],numCities,numCandidates)(from,to);
+      if(slot < numCities * numCandidates){
+	edges.push_back(slot);
+      }
+      slot = candidateSlot<int>(&candidateList[0],numCities,numCandidates)(to,from);
+      if(slot < numCities * numCandidates){
+	edges.push_back(slot);
+      }
+    }else{
+      edges.push_back(from * numCities + to);
+      edges.push_back(to * numCities + from);
+    }
+  }
+  std::sort(edges.begin(),edges.end());
+  edges.erase(std::unique(edges.begin(),edges.end()),edges.end());
+  thrust::device_vector<int> deviceEdges(edges.begin(),edges.end());
+  thrust::device_vector<float> amounts(edges.size(),weight * initialPheromone);
+  depositPheromones(arenaSpan<int>(deviceEdges.data(),deviceEdges.size()),arenaSpan<float>(amounts.data(),amounts.size()),edges.size());
+  if(kept.size() == numCities){
+    thrust::host_vector<int> whole(kept.begin(),kept.end());
+    float length = tourLength(whole);
+    if(length < globBestDist){
+      globBestTour = whole;
+      globBestDist = length;
+    }
+  }
+}
+
+template <typename City, typename Level, typename Backend>
+thrust::host_vector<int> Colony<City,Level,Backend>::getGlobBestTour()
+{
+  return thrust::host_vector<int>(globBestTour.begin(),globBestTour.end());
+}
+
+//immigrate: Takes a better tour found by another colony as the global best, so it is laid with the next deposit. Returns false and changes nothing if the tour is no better.
+template <typename City, typename Level, typename Backend>
+bool Colony<City,Level,Backend>::immigrate(const thrust::host_vector<int>& newTour, float newDist)
+{
+  if(newDist >= globBestDist || newTour.size() != numCities){
+    return false;
+  }
+  globBestTour = newTour;
+  globBestDist = newDist;
+  reps = 0;
+  return true;
+}
+
+//branchingFactor: Returns the average over the cities of their lambda-branching factor, the number of edges leaving a city whose pheromone is at least lambda of the way from the lowest level among them to the highest.
+//Every city is counted in parallel, one city per task. The factor starts at the number of edges and falls towards 2, one edge to each neighbour in the tour the colony is converging on.
+template <typename City, typename Level, typename Backend>
+float Colony<City,Level,Backend>::branchingFactor(float lambda)
+{
+  //pheromoneScale multiplies every level alike, so it leaves the factor as it is
+  return thrust::transform_reduce(exec,
+				  thrust::make_counting_iterator(0),
+				  thrust::make_counting_iterator(numCities),
+				  rowBranching<Level>(thrust::raw_pointer_cast(&pheromones[0]),matrixFree ? numCandidates : numCities,matrixFree,lambda),
+				  0.0f,
+				  thrust::plus<float>()) / numCities;
+}
+
+//tourSimilarity: Returns the share of the edges of the last iteration's tours that are also in the global best tour, in either direction. It is 1 once every ant builds the global best tour.
+template <typename City, typename Level, typename Backend>
+float Colony<City,Level,Backend>::tourSimilarity()
+{
+  if(bestNeighbors.size() != 2*numCities){
+    bestNeighbors.resize(2*numCities);
+  }
+  //next[tour[k]] = tour[k+1], then previous[tour[k+1]] = tour[k]
+  thrust::scatter(exec,
+		  thrust::make_permutation_iterator(globBestTour.begin(),distMap.begin()),
+		  thrust::make_permutation_iterator(globBestTour.begin(),distMap.begin() + numCities),
+		  globBestTour.begin(),
+		  bestNeighbors.begin());
+  thrust::scatter(exec,
+		  globBestTour.begin(),
+		  globBestTour.end(),
+		  thrust::make_permutation_iterator(globBestTour.begin(),distMap.begin()),
+		  bestNeighbors.begin() + numCities);
+  double shared = thrust::inner_product(exec,
+					antTours.begin(),
+					antTours.end(),
+					thrust::make_permutation_iterator(antTours.begin(),distMap.begin()),
+					0.0,
+					thrust::plus<double>(),
+					sharedEdge(thrust::raw_pointer_cast(&bestNeighbors[0]),thrust::raw_pointer_cast(&bestNeighbors[numCities])));
+  return shared / ((double)numAnts * numCities);
+}
+
+//restart: Lays the initial pheromone level on every edge again, as initialize does, but keeps the global best tour and its length, so the rules go on laying it.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::restart()
+{
+  thrust::fill(exec,
+	       pheromones.begin(),
+	       pheromones.end(),
+	       initialPheromone);
+  pheromoneScale = 1;
+  computeProbabilities();
+}
+
+//moveCity: Moves a city to (x, y). Only the edges at the city change length, so in dense mode its row and column are recomputed and start again at the initial pheromone level, and only the candidate lists it leaves or joins are rebuilt.
+//The global best tour takes the city out and puts it back where it adds least, so the colony carries on from a tour that is still good rather than starting again.
+template <typename City, typename Level, typename Backend>
+bool Colony<City,Level,Backend>::moveCity(int city, float x, float y)
+{
+  if(!editable()){
+    return false;
+  }
+  if(city < 0 || city >= numCities){
+    cout << "There is no city " << city << "\n";
+    return false;
+  }
+  Xcoords[city] = x;
+  Ycoords[city] = y;
+  if(!matrixFree){
+    patchCity(city);
+  }
+  relistCandidates(numCities, city, city);
+  repairBestTour(numCities, city, city);
+  //the greedy tour is of the old instance, and is built again if anything asks for it
+  greedyLength = -1;
+  greedyTour.clear();
+  return true;
+}
+
+//insertCity: Adds a city at (x, y) as city numCities. finishEdits, or the next forage, sizes the tours, maps and scratch for it. Dense buffers are laid out again one row and column wider, which is a copy of each rather than the sort and the powers of a cold start, and the new row and column are computed from the coordinates.
+//The global best tour takes the new city where it adds least. Returns its index, or -1 if the colony cannot take it.
+template <typename City, typename Level, typename Backend>
+int Colony<City,Level,Backend>::insertCity(float x, float y)
+{
+  if(!editable()){
+    return -1;
+  }
+  if(numCities >= getMaxCities()){
+    cout << "This colony stores tours in unsigned short, so it holds at most " << CITY_SHORT_MAX << " cities\n";
+    return -1;
+  }
+  const int city = numCities;
+  Xcoords.push_back(x);
+  Ycoords.push_back(y);
+  relabelCities(numCities + 1, city, -1);
+  if(!matrixFree){
+    patchCity(city);
+  }
+  relistCandidates(numCities - 1, city, -1);
+  repairBestTour(numCities - 1, city, -1);
+  return city;
+}
+
+//removeCity: Removes a city. The last city takes its index, so only that city is renumbered, and the edge buffers are laid out again one city smaller, the rest by finishEdits or the next forage. No remaining edge changes length, so nothing is recomputed but the candidate lists the city was on.
+//The global best tour closes up around the gap. Returns false if there is no such city, or if the candidate lists would be longer than the cities left.
+template <typename City, typename Level, typename Backend>
+bool Colony<City,Level,Backend>::removeCity(int city)
+{
+  if(!editable()){
+    return false;
+  }
+  if(city < 0 || city >= numCities){
+    cout << "There is no city " << city << "\n";
+    return false;
+  }
+  if(numCities - 1 < getMinCities()){
+    cout << "Too few cities would be left\n";
+    return false;
+  }
+  const int last = numCities - 1;
+  Xcoords[city] = Xcoords[last];
+  Ycoords[city] = Ycoords[last];
+  Xcoords.resize(last);
+  Ycoords.resize(last);
+  relabelCities(last, city, last);
+  relistCandidates(last + 1, city, last);
+  repairBestTour(last + 1, city, last);
+  return true;
+}
+
+//getMinCities: Returns the fewest cities removeCity leaves. Every candidate list needs more cities than it is long, and a tour at least three.
+template <typename City, typename Level, typename Backend>
+int Colony<City,Level,Backend>::getMinCities()
+{
+  return std::max(numNeighbors, 2) + 1;
+}
+
+//getMaxCities: Returns the most cities insertCity makes, which is CITY_SHORT_MAX if tours are stored in unsigned short.
+template <typename City, typename Level, typename Backend>
+int Colony<City,Level,Backend>::getMaxCities()
+{
+  return sizeof(City) < sizeof(int) ? CITY_SHORT_MAX : std::numeric_limits<int>::max();
+}
+
+//finishEdits: Sizes the tours, maps, keys and scratch for the number of cities, once after a run of insertCity and removeCity, since none of the edits read them. Does nothing if no edit changed the number of cities.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::finishEdits()
+{
+  if(!resized){
+    return;
+  }
+  antTours.resize(numCities*numAnts);
+  iterBestTour.resize(numCities);
+  distMap.resize(numCities*numAnts);
+  ACKey.resize(numAnts*numCities);
+  buildKeys();
+  if(ARepeatCMap.size() > 0){
+    ARepeatCMap.resize(numAnts*numCities);
+    buildRepeatMap();
+  }
+  allocateScratch();
+  resized = false;
+}
+
+//editable: Checks that initialize has laid out the heuristics and pheromones, which an edit patches rather than builds, and that the distances come from the coordinates an edit changes.
+template <typename City, typename Level, typename Backend>
+bool Colony<City,Level,Backend>::editable()
+{
+  if(explicitWeights){
+    cout << "Cities of an instance with explicit edge weights cannot be edited, since their coordinates say nothing about the weights\n";
+    return false;
+  }
+  if(pheromones.size() == 0 || heuristics.size() != pheromones.size()){
+    cout << "Cities can only be edited once the colony is initialized\n";
+    return false;
+  }
+  return true;
+}
+
+//relabelCities: Lays the colony out for newNumCities cities, where city takes the edges of old city source, or placeholders for patchCity to fill if source is -1, and every other city keeps its own.
+//Dense edge buffers are moved with one gather each, and the matrix the colony reads is resized in place, so whoever shares it sees the edit. Matrix-free edge buffers follow the candidate lists in relistCandidates. The maps, keys and scratch are left to finishEdits, so a run of edits rebuilds them once.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::relabelCities(int newNumCities, int city, int source)
+{
+  if(!matrixFree){
+    cityRelabel relabel(numCities, newNumCities, city, source < 0 ? 0 : source);
+    relayout(distances, relabel);
+    relayout(heuristics, relabel);
+    relayout(pheromones, relabel);
+    relayout(probabilities, relabel);
+  }
+  numCities = newNumCities;
+  resized = true;
+  //the greedy tour is of the old instance, and is built again if anything asks for it
+  greedyLength = -1;
+  greedyTour.clear();
+}
+
+//relayout: Moves the edges of a buffer laid out by city pairs to where relabel puts them, through a copy of the new size.
+template <typename City, typename Level, typename Backend>
+template <typename T>
+void Colony<City,Level,Backend>::relayout(thrust::device_vector<T>& buffer, cityRelabel relabel)
+{
+  const int size = relabel.newNumCities*relabel.newNumCities;
+  thrust::device_vector<T> moved(size);
+  thrust::gather(exec,
+		 thrust::make_transform_iterator(thrust::make_counting_iterator(0),relabel),
+		 thrust::make_transform_iterator(thrust::make_counting_iterator(size),relabel),
+		 buffer.begin(),
+		 moved.begin());
+  buffer.swap(moved);
+}
+
+//patchCity: Recomputes the lengths, heuristics and probabilities of the edges at a city from its coordinates, and starts their pheromone at the initial level, in dense mode.
+//The row is computed, then copied into the column, which runs down the matrix from the city's entry in row 0, since every buffer is symmetric in the edges at one city.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::patchCity(int city)
+{
+  const int row = city*numCities;
+  thrust::transform(exec,
+		    thrust::make_constant_iterator(city),
+		    thrust::make_constant_iterator(city) + numCities,
+		    thrust::make_counting_iterator(0),
+		    distances.begin() + row,
+		    coordDistance(thrust::raw_pointer_cast(&Xcoords[0]),thrust::raw_pointer_cast(&Ycoords[0])));
+  thrust::transform(exec,
+		    distances.begin() + row,
+		    distances.begin() + row + numCities,
+		    heuristics.begin() + row,
+		    heuristic_functor(beta));
+  thrust::fill(exec,
+	       pheromones.begin() + row,
+	       pheromones.begin() + row + numCities,
+	       initialPheromone / pheromoneScale);
+  thrust::transform(exec,
+		    pheromones.begin() + row,
+		    pheromones.begin() + row + numCities,
+		    heuristics.begin() + row,
+		    probabilities.begin() + row,
+		    thrust::multiplies<float>());
+  thrust::copy(exec,
+	       distances.begin() + row,
+	       distances.begin() + row + numCities,
+	       thrust::make_permutation_iterator(distances.begin() + city,thrust::make_transform_iterator(thrust::make_counting_iterator(0),unaryMultiplies(numCities))));
+  thrust::copy(exec,
+	       heuristics.begin() + row,
+	       heuristics.begin() + row + numCities,
+	       thrust::make_permutation_iterator(heuristics.begin() + city,thrust::make_transform_iterator(thrust::make_counting_iterator(0),unaryMultiplies(numCities))));
+  thrust::copy(exec,
+	       pheromones.begin() + row,
+	       pheromones.begin() + row + numCities,
+	       thrust::make_permutation_iterator(pheromones.begin() + city,thrust::make_transform_iterator(thrust::make_counting_iterator(0),unaryMultiplies(numCities))));
+  thrust::copy(exec,
+	       probabilities.begin() + row,
+	       probabilities.begin() + row + numCities,
+	       thrust::make_permutation_iterator(probabilities.begin() + city,thrust::make_transform_iterator(thrust::make_counting_iterator(0),unaryMultiplies(numCities))));
+}
+
+//relistCandidates: Carries the candidate lists over an edit on the host, where the lists are small. Each city keeps its old list, renumbered, unless the edit took a city off it, moved a city on it, or put a city nearer than its farthest candidate, in which case a CityGrid lists it again.
+//In matrix-free mode the lengths, levels and probabilities of the candidate edges follow their lists, and an edge that is new to a list, or whose length changed, starts at the initial pheromone level.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::relistCandidates(int oldNumCities, int city, int source)
+{
+  const int k = numNeighbors;
+  if(k <= 0 || candidates.size() != oldNumCities*k){
+    return;
+  }
+  const bool removal = numCities < oldNumCities;
+  const int moved = removal ? -1 : city; //the city whose edges all changed length
+  thrust::host_vector<float> X(Xcoords.begin(),Xcoords.end());
+  thrust::host_vector<float> Y(Ycoords.begin(),Ycoords.end());
+  CityGrid grid(&X[0],&Y[0],numCities);
+  //the old lists in the new numbering, with -1 for the removed city and for the row of an inserted one
+  thrust::host_vector<int> oldNear(candidates.begin(),candidates.end());
+  thrust::host_vector<int> kept(numCities*k,-1);
+  for(int i = 0; i < numCities; i++){
+    const int from = i == city ? source : i;
+    for(int c = 0; c < k && from >= 0; c++){
+      const int to = oldNear[from*k + c];
+      kept[i*k + c] = removal && to == city ? -1 : (removal && to == source ? city : to);
+    }
+  }
+  thrust::host_vector<int> near(kept);
+  thrust::host_vector<float> oldLevels;
+  thrust::host_vector<float> lengths;
+  thrust::host_vector<float> levels;
+  if(matrixFree){
+    thrust::host_vector<Level> stored(pheromones.begin(),pheromones.end());
+    oldLevels.assign(stored.begin(),stored.end());
+    lengths.resize(numCities*k + 1);
+    levels.resize(numCities*k + 1);
+  }
+  const float fresh = initialPheromone / pheromoneScale;
+#pragma omp parallel for
+  for(int i = 0; i < numCities; i++){
+    bool relist = i == moved;
+    for(int c = 0; c < k; c++){
+      relist = relist || kept[i*k + c] < 0 || kept[i*k + c] == moved;
+    }
+    if(!relist && moved >= 0){
+      relist = grid.distance(i,moved) < grid.distance(i,kept[i*k + k - 1]);
+    }
+    if(relist){
+      grid.nearest(i,k,&near[i*k]);
+    }
+    for(int c = 0; c < k && matrixFree; c++){
+      const int to = near[i*k + c];
+      lengths[i*k + c] = grid.distance(i,to);
+      levels[i*k + c] = fresh;
+      const int from = i == city ? source : i;
+      for(int o = 0; o < k && from >= 0 && i != moved && to != moved; o++){
+	if(kept[i*k + o] == to){
+	  levels[i*k + c] = oldLevels[from*k + o];
+	  break;
+	}
+      }
+    }
+  }
+  candidates = near;
+  if(matrixFree){
+    //the spare slot holds the edges off the lists, which are never taken by their length
+    lengths[numCities*k] = std::numeric_limits<float>::max();
+    levels[numCities*k] = oldLevels[oldNumCities*k];
+    distances = lengths;
+    pheromones = thrust::host_vector<Level>(levels.begin(),levels.end());
+    probabilities.resize(numCities*k + 1);
+    heuristics.clear(); //they are only numCities*k long, so computing them again costs less than moving them
+    computeProbabilities();
+  }
+}
+
+//repairBestTour: Carries the global best tour over an edit on the host. A removed city is cut out and the last city renumbered, and an inserted or moved city goes between the two neighbours in the tour it adds least between, which is the cheapest insertion.
+//The tour is then measured again, and is the iteration best as well, so the rules lay it on the next update. Nothing is repaired before the colony has a tour.
+template <typename City, typename Level, typename Backend>
+void Colony<City,Level,Backend>::repairBestTour(int oldNumCities, int city, int source)
+{
+  const bool removal = numCities < oldNumCities;
+  if(globBestDist >= std::numeric_limits<float>::max() || globBestTour.size() != oldNumCities){ //no forage has set the global best, so globBestTour holds no tour to carry over
+    globBestTour.resize(numCities);
+    return;
+  }
+  thrust::host_vector<int> old = getGlobBestTour();
+  std::vector<int> tour;
+  tour.reserve(numCities);
+  for(int k = 0; k < oldNumCities; k++){
+    if(old[k] != city){
+      tour.push_back(removal && old[k] == source ? city : old[k]);
+    }
+  }
+  if(!removal){
+    thrust::host_vector<float> X(Xcoords.begin(),Xcoords.end());
+    thrust::host_vector<float> Y(Ycoords.begin(),Ycoords.end());
+    coordDistance length(&X[0],&Y[0]);
+    int best = 0;
+    float bestCost = FLT_MAX;
+    for(int k = 0; k < tour.size(); k++){
+      const int a = tour[k];
+      const int b = tour[(k + 1) % tour.size()];
+      const float cost = length(a,city) + length(city,b) - length(a,b);
+      if(cost < bestCost){
+	bestCost = cost;
+	best = k;
+      }
+    }
+    tour.insert(tour.begin() + best + 1,city);
+  }
+  thrust::host_vector<int> whole(tour.begin(),tour.end());
+  globBestTour = whole;
+  globBestDist = tourLength(whole);
+  iterBestTour = globBestTour;
+  iterBestDist = globBestDist;
+  reps = 0;
+}
+
+template <typename City, typename Level, typename Backend>
+int Colony<City,Level,Backend>::getNumCities()
+{
+  return numCities;
+}
+
+template <typename City, typename Level, typename Backend>
+int Colony<City,Level,Backend>::getReps()
 {
   return reps;
 }
 
-std::string Colony::getTour()
+template <typename City, typename Level, typename Backend>
+std::string Colony<City,Level,Backend>::getTour()
 {
   std::string result;
-  for(int i = 0; i < globBestTour.size(); i++){
-    result += Comm::intToString(globBestTour[i]) + ",";
+  thrust::host_vector<int> tour = getGlobBestTour(); //one bulk copy, rather than one per city
+  for(int i = 0; i < tour.size(); i++){
+    result += Comm::intToString(tour[i]) + ",";
   }
   return result;
 }
 
+//The storage types Setup picks from: unsigned short cities for instances of up to CITY_SHORT_MAX cities, and compactFloat levels if asked for, on the build's backend and, in a HOST_BACKENDS build, on each host backend.
+template class Colony<int,float,deviceBackend>;
+template class Colony<unsigned short,float,deviceBackend>;
+template class Colony<int,compactFloat,deviceBackend>;
+template class Colony<unsigned short,compactFloat,deviceBackend>;
+#ifdef HOST_BACKENDS
+template class Colony<int,float,cppBackend>;
+template class Colony<unsigned short,float,cppBackend>;
+template class Colony<int,compactFloat,cppBackend>;
+template class Colony<unsigned short,compactFloat,cppBackend>;
+template class Colony<int,float,ompBackend>;
+template class Colony<unsigned short,float,ompBackend>;
+template class Colony<int,compactFloat,ompBackend>;
+template class Colony<unsigned short,compactFloat,ompBackend>;
+template class Colony<int,float,tbbBackend>;
+template class Colony<unsigned short,float,tbbBackend>;
+template class Colony<int,compactFloat,tbbBackend>;
+template class Colony<unsigned short,compactFloat,tbbBackend>;
+#endif
+
 //Copyright (c) 2012, Peter Ahrens
 //All rights reserved.
 //
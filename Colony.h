@@ -18,19 +18,88 @@
 #include <thrust/gather.h>
 #include <thrust/iterator/constant_iterator.h>
 #include <thrust/iterator/discard_iterator.h>
+#include <thrust/iterator/transform_iterator.h>
 #include <thrust/scan.h>
 #include <thrust/sort.h>
 #include <thrust/remove.h>
+#include <thrust/unique.h>
+#include <thrust/transform_reduce.h>
+#include <thrust/inner_product.h>
 #include <sys/time.h>
 #include <math.h>
+#include <float.h>
 #include <stdlib.h>
 #include <string>
+#include <algorithm>
+#include <vector>
 #include "Comm.h"
+#include "CityGrid.h"
+#include "ScratchArena.h"
+#include "Profiler.h"
+#include "Checkpoint.h"
+#include "Backend.h"
 
-//Linear Congruential Random Number Generator Values
-#define LCG_M 2147483648
-#define LCG_A 1103515245
-#define LCG_C 12345
+//Random Number Generator Values
+#define RNG_RANGE 2147483648 // Random numbers are drawn uniformly from [0, RNG_RANGE).
+#define PHILOX_M0 0xD2511F53
+#define PHILOX_M1 0xCD9E8D57
+#define PHILOX_W0 0x9E3779B9
+#define PHILOX_W1 0xBB67AE85
+
+//Local Search Values
+#define LS_NEIGHBORS 10 // Length of the neighbour lists built for the local search when construction does not use candidate lists.
+#define LS_EPSILON 1e-5f // Smallest relative gain that counts as an improvement, so rounding cannot make moves cycle.
+
+//Initial Tour Builders, used by greedyDistance
+#define TOUR_NEAREST 0 // Nearest neighbour tour from city 0.
+#define TOUR_CURVE 1 // Hilbert curve order, which is faster to build and about 10% longer.
+
+//Pheromone Values
+#define PHEROMONE_MIN_SCALE 1e-4f // Once evaporation shrinks pheromoneScale below this, it is folded back into pheromones.
+
+//Convergence Values
+#define BRANCHING_LAMBDA 0.05f // Share of the way from the lowest to the highest level of a city's edges that an edge must reach to count towards the city's lambda-branching factor.
+
+//Storage Values
+#define CITY_SHORT_MAX 65535 // Most cities whose tours and candidate lists fit in unsigned short.
+
+//compactFloat: A 16 bit float for storing pheromones and probabilities. It keeps the sign, the 8 exponent bits and the top 7 mantissa bits of a float, rounded to nearest even, so it has the range of a float at about 2 significant digits.
+//Values convert to and from float, and all arithmetic on them is done in float.
+struct compactFloat
+{
+  unsigned short bits;
+  __host__ __device__
+  compactFloat() : bits ( 0 ) {}
+  __host__ __device__
+  compactFloat(float x)
+  {
+    union { float f; unsigned int u; } value;
+    value.f = x;
+    if((value.u & 0x7FFFFFFF) > 0x7F800000){
+      bits = (value.u >> 16) | 0x40; //keeps a NaN a NaN
+    }else{
+      bits = (value.u + 0x7FFF + ((value.u >> 16) & 1)) >> 16;
+    }
+  }
+  __host__ __device__
+  operator float() const
+  {
+    union { float f; unsigned int u; } value;
+    value.u = (unsigned int)bits << 16;
+    return value.f;
+  }
+};
+
+//levelToFloat: Reads a stored pheromone or probability as a float.
+template <typename Level>
+struct levelToFloat : public thrust::unary_function<Level,float>
+{
+  __host__ __device__
+    float operator()(const Level& x) const
+  {
+    return x;
+  }
+};
 
 //saxpy_functor: Performs the operation s = a * x + y, where a is a constant.
 struct saxpy_functor
@@ -52,7 +121,7 @@ struct treeSelect : public thrust::binary_function<thrust::tuple<int,float,unsig
     thrust::tuple<int,float,unsigned int> operator()(const thrust::tuple<int,float,unsigned int> tup1,const thrust::tuple<int,float,unsigned int> tup2) const 
   {
     const float prob = tup1.get<1>() + tup2.get<1>();
-    if(tup1.get<2>() * prob / LCG_M < tup1.get<1>()){
+    if(tup1.get<2>() * prob / RNG_RANGE < tup1.get<1>()){
       return thrust::make_tuple(tup1.get<0>(),prob,tup2.get<2>());
     } else{
       return thrust::make_tuple(tup2.get<0>(),prob,tup2.get<2>());
@@ -60,25 +129,84 @@ struct treeSelect : public thrust::binary_function<thrust::tuple<int,float,unsig
   }
 };
 
-//prob_functor: Performs the probabilistic desireability calculation s = (pheromone level)^alpha * (1/distance)^beta
-struct prob_functor: public thrust::binary_function<float,float,float>
+//heuristic_functor: Performs the part of the probabilistic desireability calculation that never changes, s = (1/distance)^beta
+struct heuristic_functor: public thrust::unary_function<float,float>
 {
   const float beta;
-  prob_functor ( float _beta ) : beta ( _beta ) {}
+  heuristic_functor ( float _beta ) : beta ( _beta ) {}
+  __host__ __device__
+    float operator () ( const float & dist ) const
+  {
+    return pow(1 / dist, beta) ;
+  }
+};
+
+//scaledPlus: Adds a value divided by a constant scale, s = x + y / scale.
+struct scaledPlus: public thrust::binary_function<float,float,float>
+{
+  const float scale;
+  scaledPlus ( float _scale ) : scale ( _scale ) {}
   __host__ __device__
-    float operator () ( const float & pher , const float & dist ) const
+    float operator () ( const float & x , const float & y ) const
   {
-    return pher * pow(1 / dist, beta) ;
+    return x + y / scale;
   }
 };
 
-//randStep: Performs one step of a linear congruential generator
-struct randStep : public thrust::unary_function<unsigned int, unsigned int>
+//blendLevel: Moves a stored pheromone level part of the way to a target, s = keep * x + add, where add is the rest of the way already divided by the scale.
+struct blendLevel: public thrust::unary_function<float,float>
 {
+  const float keep;
+  const float add;
+  blendLevel ( float _keep, float _add ) : keep ( _keep ), add ( _add ) {}
   __host__ __device__
-    unsigned int operator()(const unsigned int x) const
+    float operator () ( const float & x ) const
   {
-    return ((x * LCG_A) + LCG_C) % LCG_M;
+    return keep * x + add;
+  }
+};
+
+//clampLevel: Keeps a stored pheromone level within [low, high].
+struct clampLevel: public thrust::unary_function<float,float>
+{
+  const float low;
+  const float high;
+  clampLevel ( float _low, float _high ) : low ( _low ), high ( _high ) {}
+  __host__ __device__
+    float operator () ( const float & x ) const
+  {
+    return x < low ? low : (x > high ? high : x);
+  }
+};
+
+//counterRandom: Draws a random number for one stream at one step of one iteration by hashing (seed, iteration, stream, step) with Philox4x32-10, so no generator state is kept between draws.
+struct counterRandom : public thrust::unary_function<int, unsigned int>
+{
+  const unsigned int seed;
+  const unsigned int iteration;
+  const unsigned int step;
+  __host__ __device__
+  counterRandom ( unsigned int _seed, unsigned int _iteration, unsigned int _step ) : seed ( _seed ), iteration ( _iteration ), step ( _step ) {}
+  __host__ __device__
+    unsigned int operator()(const int stream) const
+  {
+    unsigned int c0 = stream;
+    unsigned int c1 = step;
+    unsigned int c2 = iteration;
+    unsigned int c3 = 0;
+    unsigned int k0 = seed;
+    unsigned int k1 = 0;
+    for(int r = 0; r < 10; r++){
+      unsigned long long p0 = (unsigned long long)PHILOX_M0 * c0;
+      unsigned long long p1 = (unsigned long long)PHILOX_M1 * c2;
+      c0 = (unsigned int)(p1 >> 32) ^ c1 ^ k0;
+      c1 = (unsigned int)p1;
+      c2 = (unsigned int)(p0 >> 32) ^ c3 ^ k1;
+      c3 = (unsigned int)p0;
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+    }
+    return c0 >> 1;
   }
 };
 
@@ -118,77 +246,613 @@ isX( int _y ) : y ( _y ) {}
   }
 };
 
-//Colony: The main ACO functions and data.
+//coordDistance: Computes the length of the edge between two cities from their coordinates.
+struct coordDistance : public thrust::binary_function<int,int,float>
+{
+  const float* Xcoords;
+  const float* Ycoords;
+  __host__ __device__
+  coordDistance (const float* _Xcoords, const float* _Ycoords) : Xcoords ( _Xcoords ), Ycoords ( _Ycoords ) {}
+  __host__ __device__
+    float operator()(const int i, const int j) const
+  {
+    if(i == j){
+      return FLT_MAX;
+    }
+    const float dx = Xcoords[i] - Xcoords[j];
+    const float dy = Ycoords[i] - Ycoords[j];
+    return sqrt(dx * dx + dy * dy);
+  }
+};
+
+//tourEdgeLength: Returns the length of the edge leaving position k of a tour, read from the distance matrix.
+struct tourEdgeLength : public thrust::unary_function<int,float>
+{
+  const float* distances;
+  const int* tour;
+  const int numCities;
+  __host__ __device__
+  tourEdgeLength (const float* _distances, const int* _tour, int _numCities) : distances ( _distances ), tour ( _tour ), numCities ( _numCities ) {}
+  __host__ __device__
+    float operator()(const int k) const
+  {
+    return distances[(size_t)tour[k] * numCities + tour[(k + 1) % numCities]];
+  }
+};
+
+//tourConstruct: Builds a whole tour for one ant. The unvisited cities are kept in the tail of the ant's row of antTours and swapped forward as they are chosen.
+//If a candidate list is given, each step samples only among the unvisited candidates of the current city, and falls back to the most probable unvisited city once they are all visited.
+//If coordinates are given, probabilities holds only the candidate edges, and the fallback is the nearest unvisited city.
+//With an exploitation above 0, each step first draws whether to take the most probable unvisited candidate outright, as the Ant Colony System does, and only draws a city by roulette otherwise.
+template <typename City, typename Level>
+struct tourConstruct : public thrust::unary_function<int,int>
+{
+  const Level* probabilities;
+  const City* candidates;
+  const float* Xcoords;
+  const float* Ycoords;
+  City* antTours;
+  int* places;
+  const int numCities;
+  const int numCandidates;
+  const unsigned int seed;
+  const unsigned int iteration;
+  const float exploitation;
+  __host__ __device__
+  tourConstruct (const Level* _probabilities, const City* _candidates, const float* _Xcoords, const float* _Ycoords, City* _antTours, int* _places, int _numCities, int _numCandidates, unsigned int _seed, unsigned int _iteration, float _exploitation = 0) : probabilities ( _probabilities ), candidates ( _candidates ), Xcoords ( _Xcoords ), Ycoords ( _Ycoords ), antTours ( _antTours ), places ( _places ), numCities ( _numCities ), numCandidates ( _numCandidates ), seed ( _seed ), iteration ( _iteration ), exploitation ( _exploitation ) {}
+  __host__ __device__
+    int operator()(const int ant) const
+  {
+    City* tour = antTours + ant * numCities;
+    int* place = places + ant * numCities; // place[city] is the index of city in tour, so city is visited if place[city] < x.
+    const bool matrixFree = Xcoords != 0;
+    unsigned int random = counterRandom(seed, iteration, 0)(ant);
+    for(int i = 0; i < numCities; i++){
+      tour[i] = i;
+      place[i] = i;
+    }
+    int start = random % numCities;
+    tour[start] = 0;
+    place[0] = start;
+    tour[0] = start;
+    place[start] = 0;
+    for(int x = 1; x < numCities; x++){
+      const int current = tour[x - 1];
+      const Level* row = probabilities + current * (matrixFree ? numCandidates : numCities);
+      random = counterRandom(seed, iteration, x)(ant);
+      //the exploitation draws use steps past the last city, so they never repeat a roulette draw
+      const bool exploit = exploitation > 0 && counterRandom(seed, iteration, numCities + x)(ant) < exploitation * RNG_RANGE;
+      int chosen = -1;
+      if(numCandidates > 0){
+	const City* near = candidates + current * numCandidates;
+	float total = 0;
+	float most = -1;
+	for(int c = 0; c < numCandidates; c++){
+	  if(place[near[c]] >= x){
+	    const float p = matrixFree ? row[c] : row[near[c]];
+	    total += p;
+	    if(exploit && p > most){
+	      most = p;
+	      chosen = place[near[c]];
+	    }
+	  }
+	}
+	if(total > 0 && chosen < 0){ //otherwise the most probable candidate was taken outright
+	  float target = total * ((float)random / RNG_RANGE);
+	  for(int c = 0; c < numCandidates; c++){
+	    if(place[near[c]] >= x){
+	      chosen = place[near[c]];
+	      target -= matrixFree ? row[c] : row[near[c]];
+	      if(target < 0){
+		break;
+	      }
+	    }
+	  }
+	}else if(total <= 0 && matrixFree){
+	  float best = FLT_MAX;
+	  coordDistance length(Xcoords, Ycoords);
+	  for(int j = x; j < numCities; j++){
+	    float d = length(current, tour[j]);
+	    if(d < best || chosen < 0){
+	      best = d;
+	      chosen = j;
+	    }
+	  }
+	}else if(total <= 0){
+	  float best = -1;
+	  for(int j = x; j < numCities; j++){
+	    if(row[tour[j]] > best){
+	      best = row[tour[j]];
+	      chosen = j;
+	    }
+	  }
+	}
+      }else if(exploit){
+	float best = -1;
+	for(int j = x; j < numCities; j++){
+	  if(row[tour[j]] > best){
+	    best = row[tour[j]];
+	    chosen = j;
+	  }
+	}
+      }else{
+	float total = 0;
+	for(int j = x; j < numCities; j++){
+	  total += row[tour[j]];
+	}
+	float target = total * ((float)random / RNG_RANGE);
+	chosen = numCities - 1;
+	for(int j = x; j < numCities; j++){
+	  target -= row[tour[j]];
+	  if(target < 0){
+	    chosen = j;
+	    break;
+	  }
+	}
+      }
+      int city = tour[chosen];
+      tour[chosen] = tour[x];
+      place[tour[x]] = chosen;
+      tour[x] = city;
+      place[city] = x;
+    }
+    return start;
+  }
+};
+
+//tourImprove: Runs 2-opt and Or-opt on one ant's tour until no move in the neighbour lists improves it, and returns the total gain.
+//Cities whose neighbourhood gave no improvement get a don't-look bit, which is cleared when a move touches them.
+template <typename City>
+struct tourImprove : public thrust::unary_function<int,float>
+{
+  const float* distances;
+  const float* Xcoords;
+  const float* Ycoords;
+  const City* candidates;
+  City* antTours;
+  int* places;
+  int* dontLooks;
+  const int numCities;
+  const int numNeighbors;
+  tourImprove (const float* _distances, const float* _Xcoords, const float* _Ycoords, const City* _candidates, City* _antTours, int* _places, int* _dontLooks, int _numCities, int _numNeighbors) : distances ( _distances ), Xcoords ( _Xcoords ), Ycoords ( _Ycoords ), candidates ( _candidates ), antTours ( _antTours ), places ( _places ), dontLooks ( _dontLooks ), numCities ( _numCities ), numNeighbors ( _numNeighbors ) {}
+  __host__ __device__
+    float length(const int a, const int b) const
+  {
+    if(Xcoords != 0){
+      return coordDistance(Xcoords, Ycoords)(a, b);
+    }
+    return distances[a * numCities + b];
+  }
+  //reversePath: Reverses the path running forward from city a to city b. If that is more than half the tour, the rest of the tour is reversed instead, which gives the same cycle.
+  __host__ __device__
+    void reversePath(City* tour, int* place, const int a, const int b) const
+  {
+    int i = place[a];
+    int j = place[b];
+    int length = (j - i + numCities) % numCities + 1;
+    if(2 * length > numCities){
+      const int first = (j + 1) % numCities;
+      j = (i - 1 + numCities) % numCities;
+      i = first;
+      length = numCities - length;
+    }
+    for(int k = 0; k < length / 2; k++){
+      const int x = (i + k) % numCities;
+      const int y = (j - k + numCities) % numCities;
+      const int cx = tour[x];
+      const int cy = tour[y];
+      tour[x] = cy;
+      place[cy] = x;
+      tour[y] = cx;
+      place[cx] = y;
+    }
+  }
+  //twoOpt: Tries to replace an edge at city a and another edge by two shorter ones.
+  __host__ __device__
+    float twoOpt(City* tour, int* place, int* dontLook, const int a) const
+  {
+    for(int direction = 0; direction < 2; direction++){
+      const int b = direction == 0 ? tour[(place[a] + 1) % numCities] : tour[(place[a] - 1 + numCities) % numCities];
+      const float ab = length(a, b);
+      for(int k = 0; k < numNeighbors; k++){
+	const int c = candidates[a * numNeighbors + k];
+	const float ac = length(a, c);
+	if(ac >= ab){
+	  break;
+	}
+	const int d = direction == 0 ? tour[(place[c] + 1) % numCities] : tour[(place[c] - 1 + numCities) % numCities];
+	if(c == b || d == a){
+	  continue;
+	}
+	const float cd = length(c, d);
+	const float gain = ab + cd - ac - length(b, d);
+	if(gain > LS_EPSILON * (ab + cd)){
+	  if(direction == 0){
+	    reversePath(tour, place, b, c);
+	  }else{
+	    reversePath(tour, place, a, d);
+	  }
+	  dontLook[a] = dontLook[b] = dontLook[c] = dontLook[d] = 0;
+	  return gain;
+	}
+      }
+    }
+    return 0;
+  }
+  //orOpt: Tries to move the segment of one to three cities starting at city a between two neighbouring cities elsewhere, in either orientation.
+  __host__ __device__
+    float orOpt(City* tour, int* place, int* dontLook, const int a) const
+  {
+    for(int segment = 1; segment <= 3 && segment + 2 < numCities; segment++){
+      const int s1 = a;
+      const int s2 = tour[(place[a] + segment - 1) % numCities];
+      const int p = tour[(place[s1] - 1 + numCities) % numCities];
+      const int n1 = tour[(place[s2] + 1) % numCities];
+      const float removed = length(p, s1) + length(s2, n1) - length(p, n1);
+      if(removed <= 0){
+	continue;
+      }
+      for(int end = 0; end < 2; end++){
+	const int s = end == 0 ? s1 : s2;
+	for(int k = 0; k < numNeighbors; k++){
+	  const int neighbor = candidates[s * numNeighbors + k];
+	  if(length(s, neighbor) >= removed){
+	    break;
+	  }
+	  for(int side = 0; side < 2; side++){
+	    const int c = side == 0 ? neighbor : tour[(place[neighbor] - 1 + numCities) % numCities];
+	    const int d = tour[(place[c] + 1) % numCities];
+	    if((place[c] - place[s1] + numCities) % numCities < segment || (place[d] - place[s1] + numCities) % numCities < segment){
+	      continue;
+	    }
+	    const float cd = length(c, d);
+	    const float forward = length(c, s1) + length(s2, d);
+	    const float backward = length(c, s2) + length(s1, d);
+	    const float gain = removed + cd - (forward < backward ? forward : backward);
+	    if(gain > LS_EPSILON * (removed + cd)){
+	      //p S n1 .. c d  ->  p c .. n1 S' d  ->  p n1 .. c S' d, where S' is S reversed
+	      reversePath(tour, place, s1, c);
+	      if(tour[(place[p] + 1) % numCities] == c){
+		reversePath(tour, place, c, n1);
+	      }else{
+		reversePath(tour, place, n1, c);
+	      }
+	      if(forward < backward){
+		if(tour[(place[c] + 1) % numCities] == s2){
+		  reversePath(tour, place, s2, s1);
+		}else{
+		  reversePath(tour, place, s1, s2);
+		}
+	      }
+	      dontLook[p] = dontLook[n1] = dontLook[s1] = dontLook[s2] = dontLook[c] = dontLook[d] = 0;
+	      return gain;
+	    }
+	  }
+	}
+      }
+    }
+    return 0;
+  }
+  __host__ __device__
+    float operator()(const int ant) const
+  {
+    City* tour = antTours + ant * numCities;
+    int* place = places + ant * numCities;
+    int* dontLook = dontLooks + ant * numCities;
+    if(numCities < 5 || numNeighbors == 0){
+      return 0;
+    }
+    for(int i = 0; i < numCities; i++){
+      place[tour[i]] = i;
+      dontLook[i] = 0;
+    }
+    float gained = 0;
+    bool improved = true;
+    while(improved){
+      improved = false;
+      for(int a = 0; a < numCities; a++){
+	if(dontLook[a]){
+	  continue;
+	}
+	float gain = twoOpt(tour, place, dontLook, a);
+	if(gain <= 0){
+	  gain = orOpt(tour, place, dontLook, a);
+	}
+	if(gain > 0){
+	  gained += gain;
+	  improved = true;
+	}else{
+	  dontLook[a] = 1;
+	}
+      }
+    }
+    return gained;
+  }
+};
+
+//pickedEdge: Maps the index of an edge in the edge list of some picked tours to the index of the same edge among the tours of every ant.
+struct pickedEdge : public thrust::unary_function<int, int>
+{
+  const int* order;
+  const int numCities;
+  pickedEdge ( const int* _order, int _numCities ) : order ( _order ), numCities ( _numCities ) {}
+  __host__ __device__
+    int operator()(const int x) const
+  {
+    return order[x / numCities] * numCities + x % numCities;
+  }
+};
+
+//candidateSlot: Finds the index into the candidate-sized pheromones of the edge between two cities. Edges off the candidate lists go to the spare slot at the end.
+template <typename City>
+struct candidateSlot : public thrust::binary_function<int,int,int>
+{
+  const City* candidates;
+  const int numCities;
+  const int numCandidates;
+  candidateSlot (const City* _candidates, int _numCities, int _numCandidates) : candidates ( _candidates ), numCities ( _numCities ), numCandidates ( _numCandidates ) {}
+  __host__ __device__
+    int operator()(const int from, const int to) const
+  {
+    for(int c = 0; c < numCandidates; c++){
+      if(candidates[from * numCandidates + c] == to){
+	return from * numCandidates + c;
+      }
+    }
+    return numCities * numCandidates;
+  }
+};
+
+//rowBranching: Counts the edges leaving one city whose pheromone is at least lambda of the way from the lowest to the highest level among them, which is the city's lambda-branching factor.
+//Rows are rowLength long, numCities in a matrix, where the edge to the city itself is skipped, or numCandidates in matrix-free mode, where only candidate edges count.
+template <typename Level>
+struct rowBranching : public thrust::unary_function<int,float>
+{
+  const Level* pheromones;
+  const int rowLength;
+  const bool matrixFree;
+  const float lambda;
+  rowBranching (const Level* _pheromones, int _rowLength, bool _matrixFree, float _lambda) : pheromones ( _pheromones ), rowLength ( _rowLength ), matrixFree ( _matrixFree ), lambda ( _lambda ) {}
+  __host__ __device__
+    float operator()(const int city) const
+  {
+    const Level* row = pheromones + city * rowLength;
+    float low = FLT_MAX;
+    float high = -FLT_MAX;
+    for(int j = 0; j < rowLength; j++){
+      if(matrixFree || j != city){
+	const float level = row[j];
+	low = level < low ? level : low;
+	high = level > high ? level : high;
+      }
+    }
+    const float threshold = low + lambda * (high - low);
+    int branches = 0;
+    for(int j = 0; j < rowLength; j++){
+      if((matrixFree || j != city) && row[j] >= threshold){
+	branches++;
+      }
+    }
+    return branches;
+  }
+};
+
+//sharedEdge: Checks whether the edge between two cities is in a tour, in either direction, from the successor and predecessor of every city in the tour.
+struct sharedEdge : public thrust::binary_function<int,int,int>
+{
+  const int* next;
+  const int* previous;
+  sharedEdge (const int* _next, const int* _previous) : next ( _next ), previous ( _previous ) {}
+  __host__ __device__
+    int operator()(const int from, const int to) const
+  {
+    return next[from] == to || previous[from] == to;
+  }
+};
+
+//candidateEdge: Finds the index into pheromones of the edge between two cities if it is on the candidate list of the first, or -1 if it is not. In matrix-free mode that index is its candidate slot.
+template <typename City>
+struct candidateEdge : public thrust::binary_function<int,int,int>
+{
+  const City* candidates;
+  const int numCities;
+  const int numCandidates;
+  const bool matrixFree;
+  candidateEdge (const City* _candidates, int _numCities, int _numCandidates, bool _matrixFree) : candidates ( _candidates ), numCities ( _numCities ), numCandidates ( _numCandidates ), matrixFree ( _matrixFree ) {}
+  __host__ __device__
+    int operator()(const int from, const int to) const
+  {
+    for(int c = 0; c < numCandidates; c++){
+      if(candidates[from * numCandidates + c] == to){
+	return matrixFree ? from * numCandidates + c : from * numCities + to;
+      }
+    }
+    return -1;
+  }
+};
+
+//candidateMap: Maps the index of a candidate list entry to the index of the same rank in a full row-sorted numCities*numCities array.
+struct candidateMap : public thrust::unary_function<int, int>
+{
+  const int numCities;
+  const int numCandidates;
+  candidateMap ( int _numCities, int _numCandidates ) : numCities ( _numCities ), numCandidates ( _numCandidates ) {}
+  __host__ __device__
+    int operator()(const int x) const
+  {
+    return (x / numCandidates) * numCities + x % numCandidates;
+  }
+};
+
+//cityRelabel: Maps the index of an edge in a newNumCities*newNumCities matrix to the index of the edge whose data it takes in an oldNumCities*oldNumCities one. City city takes the row and column of old city source, and every other city keeps its own.
+struct cityRelabel : public thrust::unary_function<int, int>
+{
+  const int oldNumCities;
+  const int newNumCities;
+  const int city;
+  const int source;
+  cityRelabel ( int _oldNumCities, int _newNumCities, int _city, int _source ) : oldNumCities ( _oldNumCities ), newNumCities ( _newNumCities ), city ( _city ), source ( _source ) {}
+  __host__ __device__
+    int operator()(const int x) const
+  {
+    const int i = x / newNumCities;
+    const int j = x % newNumCities;
+    return (i == city ? source : i) * oldNumCities + (j == city ? source : j);
+  }
+};
+
+//rulesMemoryFunction: Returns the device bytes the buffers of a variant's rules take for a colony of numCities cities and numAnts ants, with ranks laying pheromone where the variant ranks its ants.
+typedef size_t (*rulesMemoryFunction)(int numCities, int numAnts, int ranks);
+
+//Colony: The main ACO functions and data, without the pheromone rules of any variant, which AntSystem adds. City is the type tours and candidate lists are stored in, which can be unsigned short for instances of up to CITY_SHORT_MAX cities.
+//Level is the type pheromones and probabilities are stored in, float or compactFloat. Backend gives the execution policy every algorithm runs under. The specialisations Setup picks from are instantiated in Colony.cu.
+template <typename City = int, typename Level = float, typename Backend = deviceBackend>
 class Colony
 {
  public:
-  Colony(thrust::host_vector<float> newDistances, int newNumCities, int newNumAnts);
-  void initialize(); // Initializes data, creates maps and keys, performs standard ACO initialization steps etc.
-  void forage(); // Main ACO loop. Performs the solution constructruction step, then updates distances, pheromones, probabilities.
+  Colony(thrust::device_vector<float>& newDistances, float* newXcoords, float* newYcoords, int newNumCities, int newNumAnts); // Reads newDistances in place, so colonies can share one matrix, and it must outlive them. If it is empty, edge lengths are computed from the coordinates and only candidate edges are stored.
+  void reset(float* newXcoords, float* newYcoords); // Sets defaults and forgets the instance, so the colony can take a new one of the same size without reallocating. The new distances must already be in the matrix it reads.
+  void initialize(); // Initializes data, creates maps and keys, performs standard ACO initialization steps etc. initialPheromone must already be set.
   void computeAntDistances(); // Computes the distances of each ant's tour, then updates records.
-  void computeProbabilities(); // Computes the probabilities from the distances and pheromones.
+  void computeProbabilities(); // Computes all the probabilities from the heuristics and pheromones, computing the heuristics first if they are missing.
   void setRho(float newRho);
   void setBeta(float newBeta);
+  void setFused(bool newFused);
+  void setNumCandidates(int newNumCandidates);
   double getRho();
   double getBeta();
+  bool getFused();
+  bool getMatrixFree();
+  int getNumCandidates();
+  void setLocalSearch(bool newLocalSearch);
+  bool getLocalSearch();
+  double getLocalSearchTime(); // Wall clock seconds spent in the local search during the last forage.
+  void setSeed(unsigned int newSeed); // Seeds the random numbers, so that runs with the same seed give the same tours on the same backend.
+  unsigned int getSeed();
+  void setCandidates(const thrust::host_vector<int>& newCandidates, int newNumCandidates); // Gives precomputed candidate lists, so initialize does not rebuild them.
+  thrust::host_vector<int> getCandidates();
+  void setGreedyDistance(float newGreedyDistance); // Gives a precomputed greedy tour length, so initialize does not rebuild it.
+  float getGreedyDistance();
+  void setInitialTour(int newInitialTour); // Picks how greedyDistance builds its tour, TOUR_NEAREST or TOUR_CURVE.
+  int getInitialTour();
+  void setSeedTour(bool newSeedTour); // If set, initialize makes the initial tour the global best, so a run starts with it as the incumbent.
+  void setExplicitWeights(bool newExplicitWeights); // Marks the distances as given by the instance rather than computed from the coordinates, which then say nothing about them.
+  bool getExplicitWeights();
   int getNumAnts();
   double getIterBestDist();
   double getGlobBestDist();
+  thrust::host_vector<int> getGlobBestTour();
+  void getState(colonyState& state); // Copies everything needed to resume the run into state.
+  bool setState(const colonyState& state); // Restores a state from getState after initialize. Returns false if it is of a colony of another size or storage mode.
+  void warmStart(const thrust::host_vector<int>& tour, float weight); // Lays weight times the initial pheromone on the edges of a tour from an earlier solve, after initialize.
+  bool immigrate(const thrust::host_vector<int>& newTour, float newDist); // Takes a better tour found by another colony as the global best, so it is laid with the next deposit.
   int getReps();
-  virtual void computeParameters() = 0; //Implemented differently in each ACO.
+  float branchingFactor(float lambda = BRANCHING_LAMBDA); // Returns the average lambda-branching factor of the cities, which falls towards 2 as the pheromones converge on one tour.
+  float tourSimilarity(); // Returns the share of the edges of the last iteration's tours that are also in the global best tour.
+  void restart(); // Lays the initial pheromone level on every edge again, keeping the global best tour, so a stagnant colony explores again.
+  bool moveCity(int city, float x, float y); // Moves a city, patching only the edges at it, and puts it back into the global best tour where it adds least. Returns false if there is no such city.
+  int insertCity(float x, float y); // Adds a city as the last one, growing the edge buffers in place and leaving the rest to finishEdits, and splices it into the global best tour where it adds least. Returns its index, or -1 if it cannot be added.
+  bool removeCity(int city); // Removes a city, giving its index to the last city, shrinks the edge buffers in place, leaving the rest to finishEdits, and closes the global best tour up around it. Returns false if there is no such city or too few would be left.
+  int getMinCities(); // Returns the fewest cities removeCity leaves, since the candidate lists need more cities than they are long.
+  int getMaxCities(); // Returns the most cities insertCity makes, which is as many as City can number.
+  void finishEdits(); // Sizes the tours, maps, keys and scratch for the number of cities once, after any number of insertCity and removeCity.
+  int getNumCities();
   std::string getTour();
+  void setProfiler(Profiler* newProfiler); // Times the phases of every forage with newProfiler, or nothing if it is null.
+  void printMemory(); // Prints the size of every device buffer and the layout of the scratch arena.
+  static size_t estimateMemory(int numCities, int numAnts, bool matrixFree, int numCandidates, bool fused, bool localSearch, bool explicitWeights, rulesMemoryFunction rules, int ranks); // Returns the peak device bytes a colony with these settings and rules needs, counting the distance matrix it reads.
+  static bool fitMemory(size_t budget, int numCities, int& numAnts, bool& matrixFree, bool& fused, int numCandidates, bool localSearch, bool explicitWeights, rulesMemoryFunction rules, int ranks); // Picks storage modes and at most numAnts ants that fit in budget bytes. Returns false if not even one ant fits.
  protected:
-  float greedyDistance(); // Returns the value of a simple greedy solution starting at city 0.
-  virtual void computeInitialPheromone() = 0; //Implemented differently in each ACO.
-  virtual void updatePheromones() = 0; //Implemented differently in each ACO.
+  static void reserveScratch(ScratchArena& arena, int numCities, int numAnts, bool stepwise, bool localSearch); // Reserves every scratch buffer with its lifetime.
+  void profileStart(int phase); // Starts the timer of a phase, if there is a profiler.
+  void profileStop(int phase, double bytes); // Stops the timer of a phase and counts the bytes it touched, if there is a profiler.
+  void allocateScratch(); // Lays out the scratch arena for the current modes and points the scratch buffers into it.
+  void buildKeys(); // Creates the maps and keys, which only depend on numCities and numAnts.
+  void buildTours(); // Constructs the tours, improves them if localSearch is set, then measures them. This is all of a forage but the pheromone update.
+  void constructToursStepwise(); // Builds all the tours one step at a time, moving every ant forward one city per pass.
+  void constructToursFused(); // Builds all the tours at once, one ant per task.
+  void improveTours(); // Runs 2-opt and Or-opt on every ant's tour, then leaves the improved tours in antTours.
+  void computeCandidates(); // Builds the list of the numNeighbors nearest neighbours of each city.
+  void computeEdges(thrust::device_vector<City>& tours, arenaSpan<int> edges); // Computes the index into pheromones of every edge of the given tours.
+  void computeEdges(thrust::device_vector<City>& tours, const int* order, int numTours, arenaSpan<int> edges); // Computes the index into pheromones of every edge of the first numTours ants listed in order, leaving the other tours alone.
+  int computeCandidateEdges(thrust::device_vector<City>& tours, arenaSpan<int> edges); // Computes the index into pheromones of every distinct candidate edge of the given tours, and returns how many there are.
+  void evaporate(float factor); // Multiplies every pheromone level by factor through pheromoneScale, folding the scale back into pheromones when it gets small.
+  void depositPheromones(arenaSpan<int> edges, arenaSpan<float> amounts, int numEdges); // Adds amounts to the first numEdges edges, which must be distinct, and refreshes their probabilities.
+  float tourLength(const thrust::host_vector<int>& tour); // Returns the length of a whole tour.
+  float greedyDistance(); // Returns the value of a simple greedy solution starting at city 0, computing it on the first call.
+  void blendPheromones(arenaSpan<int> edges, int numEdges, float keep, float target); // Moves the first numEdges edges, which must be distinct, to keep times their level plus 1-keep times target, and refreshes their probabilities.
+  void boundPheromones(float low, float high); // Clamps every pheromone level to [low, high] and recomputes all the probabilities.
+  void buildRepeatMap(); // Computes ARepeatCMap from ACKey, for the stepwise construction.
+  bool editable(); // Checks that initialize has laid out the buffers an edit patches, and that the distances follow the coordinates.
+  void relabelCities(int newNumCities, int city, int source); // Lays the colony out for newNumCities cities, where city takes the edges of old city source, or of none if source is -1, and every other city keeps its own.
+  template <typename T> void relayout(thrust::device_vector<T>& buffer, cityRelabel relabel); // Moves the edges of a numCities*numCities buffer to where relabel puts them.
+  void patchCity(int city); // Recomputes the edges at a city from its coordinates and starts them at the initial pheromone level, in dense mode.
+  void relistCandidates(int oldNumCities, int city, int source); // Carries the candidate lists over an edit, rebuilding only those it changes, with their lengths and levels in matrix-free mode.
+  void repairBestTour(int oldNumCities, int city, int source); // Carries the global best tour over an edit, putting an inserted or moved city where it adds least.
   //world vars
   int numCities;
   int reps;
+  Profiler* profiler; // Times the phases of forage, if set.
+  bool keysBuilt; // Set once buildKeys has run, since reset keeps the maps and keys.
+  bool resized; // Set by an edit that changes the number of cities, until finishEdits sizes what depends on it.
+  bool fused; // Selects constructToursFused over constructToursStepwise.
+  int numCandidates; // Length of each city's nearest neighbour list, 0 if construction considers every city.
+  int numNeighbors; // Length of each list in candidates, which is numCandidates unless only the local search uses them.
+  bool localSearch; // If set, improveTours runs between construction and computeAntDistances.
+  double localSearchTime;
+  bool matrixFree; // If set, distances, pheromones and probabilities hold numCities*numCandidates candidate edges plus one spare slot.
   //float alpha = 1, alpha is always 1
   float beta;
   float rho;
   float initialPheromone;
-  thrust::device_vector<float> pheromones;
-  thrust::device_vector<float> distances;
-  thrust::device_vector<float> probabilities;
+  float exploitation; // Chance that an ant takes its most probable candidate instead of drawing one, q0 of the Ant Colony System. 0 always draws.
+  float pheromoneScale; // The pheromone level of an edge is pheromones times this, so evaporation does not touch every edge.
+  unsigned int seed; // Key of the counter-based random numbers, from the clock unless setSeed gives it.
+  unsigned int iteration; // Number of completed forages, part of the counter of every random number.
+  float greedyLength; // Cached result of greedyDistance, negative until known.
+  int initialTour; // How greedyDistance builds its tour.
+  bool seedTour; // If set, initialize starts globBestTour at greedyTour.
+  bool explicitWeights; // Set if the distances were given rather than computed from the coordinates, so no edit may recompute them.
+  thrust::host_vector<int> greedyTour; // The tour greedyDistance built, only kept if seedTour is set.
+  thrust::device_vector<Level> pheromones;
+  thrust::device_vector<float> candidateLengths; // Holds the candidate edge lengths in matrix-free mode, where distances refers to it.
+  thrust::device_vector<float>& distances; // The distance matrix, shared with whoever constructed the Colony, or candidateLengths.
+  thrust::device_vector<Level> probabilities;
+  thrust::device_vector<float> heuristics; // (1/distance)^beta of every edge in distances, computed once since distances do not change.
+  thrust::device_vector<City> candidates;
+  thrust::device_vector<float> Xcoords;
+  thrust::device_vector<float> Ycoords;
   //ant vars
   int numAnts;
   float iterBestDist;
   float globBestDist;
-  thrust::device_vector<int> iterBestTour;
-  thrust::device_vector<int> globBestTour;
-  thrust::device_vector<float> antVisits;
-  thrust::device_vector<int> toVisit;
-  thrust::device_vector<int> antTours;
+  thrust::device_vector<City> iterBestTour;
+  thrust::device_vector<City> globBestTour;
+  thrust::device_vector<City> antTours;
+  thrust::device_vector<int> bestNeighbors; // The successor, then the predecessor, of every city in globBestTour, only allocated once tourSimilarity runs.
   thrust::device_vector<float> antDistances;
-  thrust::device_vector<float> currentProbabilities;
-  thrust::device_vector<int> currentNeighbors;
   //maps and keys
   thrust::device_vector<int> ACMapF;
   thrust::device_vector<int> ACMapL;
-  thrust::device_vector<int> tourMap;
   thrust::device_vector<int> distMap;
   thrust::device_vector<int> ACKey;
-  thrust::device_vector<int> ARepeatCMap;
-  thrust::device_vector<int> ANMapF;
-  thrust::device_vector<int> ANMapL;
-  thrust::device_vector<int> ANKey;
-  thrust::device_vector<int> CCKey;
-  thrust::device_vector<int> ARepeatNMap;
-  //scratch variables
-  thrust::device_vector<float> AFloat;
-  thrust::device_vector<int> AInt;
-  thrust::device_vector<int> CInt;
-  thrust::device_vector<int> CInt2;
-  thrust::device_vector<int> ACInt;
-  thrust::device_vector<int> ACInt2;
-  thrust::device_vector<int> ACInt3;
-  thrust::device_vector<float> ACFloat;
-  thrust::device_vector<float> CCFloat;
-  thrust::device_vector<unsigned int> AUnsignedInt;
-  //random numbers
-  thrust::device_vector<unsigned int> ARandom;
-  thrust::device_vector<unsigned int> ACRandom;
+  thrust::device_vector<int> ARepeatCMap; // Only allocated if the stepwise construction runs.
+  thrust::device_vector<int> CCKey; // Only allocated while computeCandidates sorts the distance rows.
+  thrust::device_vector<float> CCFloat; // Only allocated while computeCandidates sorts the distance rows.
+  //scratch variables, all in the arena
+  ScratchArena arena;
+  arenaSpan<float> AFloat;
+  arenaSpan<int> AInt;
+  arenaSpan<unsigned int> AUnsignedInt; // Stepwise construction only.
+  arenaSpan<int> tourMap; // Stepwise construction only.
+  arenaSpan<int> ACInt;
+  arenaSpan<int> ACInt2;
+  arenaSpan<int> ACInt3; // Local search only.
+  arenaSpan<float> ACFloat;
+  arenaSpan<float> antVisits; // Stepwise construction only.
+  arenaSpan<City> toVisit; // Stepwise construction only.
+  //backend
+  typename Backend::policy exec; // Passed to every thrust algorithm, so they run on Backend whatever system the vectors belong to.
 };
 #endif
 
@@ -12,32 +12,58 @@ Comm::Comm(int newReadPipe,int newWritePipe)
   readPipe = newReadPipe;
   writePipe = newWritePipe;
   tagLength = 8;
+  tolerant = false;
 }
 
 Comm::~Comm() //Destructor.
 {}
 
+//setTolerant: If set, a read error or timeout makes recieve return an empty string instead of ending the program, for a daemon that must outlive its clients.
+void Comm::setTolerant(bool newTolerant)
+{
+  tolerant = newTolerant;
+}
+
 //recieve: Looks for data on the pipe. If there is some, it is returned. If not, an empty string is returned.
+//A message longer than the pipe buffer arrives in pieces, so the reads are repeated until all of it is in.
 string Comm::recieve()
 {
   char tag[tagLength];
   int rv = read(readPipe,tag,tagLength);
   if(rv < 0){
+    if(tolerant){
+      return string("");
+    }
     cout << "Read Error 1";
     exit(1);
   }
   if(rv == 0){
     return string("");
   }
-  string inputTag = tag;
-  int toRead = atoi(inputTag.substr(0,tagLength).c_str());
-  char charIn[toRead];
-  if(read(readPipe,charIn,toRead) < 0){
-    cout << "Read Error 2";
-    exit(1);
+  while(rv < tagLength){
+    int got = read(readPipe,tag + rv,tagLength - rv);
+    if(got <= 0){
+      if(tolerant){
+	return string("");
+      }
+      cout << "Read Error 1";
+      exit(1);
+    }
+    rv += got;
+  }
+  int toRead = atoi(string(tag,tagLength).c_str());
+  string output(toRead,' ');
+  for(int done = 0; done < toRead;){
+    int got = read(readPipe,&output[done],toRead - done);
+    if(got <= 0){
+      if(tolerant){
+	return string("");
+      }
+      cout << "Read Error 2";
+      exit(1);
+    }
+    done += got;
   }
-  string output = charIn;
-  output = output.substr(0,toRead);
   return output;
 }
 
@@ -45,7 +71,14 @@ string Comm::recieve()
 bool Comm::send(string message)
 {
   message = intToString(message.length(),tagLength) + message;
-  return(write(writePipe,message.data(),message.length()) > 0);
+  for(size_t done = 0; done < message.length();){
+    int wrote = write(writePipe,message.data() + done,message.length() - done);
+    if(wrote <= 0){
+      return false;
+    }
+    done += wrote;
+  }
+  return true;
 }
 
 //intToString: Converts an int to a specified size string with 0s as padding.
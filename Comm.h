@@ -23,6 +23,7 @@ class Comm
   ~Comm();
   string recieve(); //recieve: Looks for data on the pipe. If there is some, it is returned. If not, an empty string is returned.
   bool send(string message); //send: Puts the given data on the pipe
+  void setTolerant(bool newTolerant); //setTolerant: If set, a read error or timeout makes recieve return an empty string instead of ending the program.
   static string intToString(int t, int padding); //intToString: Converts an int to a specified size string with 0s as padding.
   static string intToString(int t); //intToString: Converts an int to a string.
   static string floatToString(float t); //floatToString: Converts an float to a string.
@@ -30,6 +31,7 @@ class Comm
   int tagLength;
   int readPipe;
   int writePipe;
+  bool tolerant;
 };
 #endif
 
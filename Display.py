@@ -9,8 +9,10 @@
 ##### -a : disable window size adjustment #####
 #####      (not recommended)              #####
 ##### -g : disable graph display          #####
-##### -f [arg] : input file name          #####
-#####      (default="GUIFile")            #####
+##### -f [arg] : read a GUIFile instead   #####
+#####      of shared memory               #####
+##### -s [arg] : shared memory name       #####
+#####      (default="excellants")         #####
 ###############################################
 
 import pygame
@@ -18,6 +20,8 @@ import sys
 from os.path import exists
 from os import remove
 from time import time
+import mmap
+import struct
 
 class Graph(): # Class for making a graph of the ACO route
   def __init__(self):
@@ -73,6 +77,10 @@ class Graph(): # Class for making a graph of the ACO route
     self.displayGraphBounds = True  # Display bounds on graphs
     
     self.fname = "GUIFile"                # Input file it looks for
+    self.shmName = "excellants"           # Shared memory it looks for, under /dev/shm
+    self.useShm = True                    # Read snapshots from shared memory rather than the input file
+    self.snapshot = None                  # The shared memory, once mapped
+    self.TSPFile = ""                     # Path of the .tsp file, from the snapshot
     
     self.deleteFile = True               # Delete input file when done
     self.forceCreate = True              # Force creation of new input file
@@ -90,13 +98,17 @@ class Graph(): # Class for making a graph of the ACO route
         continue
       if option == "-f":
         self.fname = sys.argv[i+1]
+        self.useShm = False
+        continue
+      if option == "-s":
+        self.shmName = sys.argv[i+1]
         continue
   
   def tuples_to_lists(self,l):
     return [[x,y] for (x,y) in l]
 
   def run(self): 								# Display function
-    if not exists(self.fname) or self.forceCreate:
+    if not self.useShm and (not exists(self.fname) or self.forceCreate):
       f = open(self.fname, 'w')
       f.close()
       #self.deleteFile = True
@@ -108,9 +120,13 @@ class Graph(): # Class for making a graph of the ACO route
         if event.type == pygame.QUIT:
           self.close()
       
-      f = open(self.fname, 'r')
-      # If the data has been put in file:
-      if self.hasData(f):
+      # If the data has been put in shared memory or the file:
+      if self.useShm:
+        ready = self.hasSnapshot()
+      else:
+        f = open(self.fname, 'r')
+        ready = self.hasData(f)
+      if ready:
         # If first time
         if not isInitialized:
           self.readEarlyData()
@@ -381,6 +397,8 @@ class Graph(): # Class for making a graph of the ACO route
   # Functions for reading data          #
   #######################################
   def readData(self):
+    if self.useShm:
+      return self.readSnapshot()
     prevIterNum = self.iterNum
     temp = self.input.split(':')
     self.iterNum = int(temp[5])
@@ -412,9 +430,51 @@ class Graph(): # Class for making a graph of the ACO route
       result = True
     return result
 
+  def hasSnapshot(self): # Maps the shared memory once the solver has made it, and returns True once it holds a snapshot
+    if self.snapshot == None:
+      try:
+        f = open("/dev/shm/" + self.shmName, 'rb')
+        self.snapshot = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        f.close()
+      except (IOError, ValueError, mmap.error):
+        return False
+    magic, n, latest, done, spare, TSPFile, TSPName = struct.unpack_from("<8s4i256s64s", self.snapshot, 0)
+    if magic != b"EXSNAP01" or latest < 0:
+      return False
+    self.TSPFile = TSPFile.rstrip(b'\0').decode()
+    self.TSPName = TSPName.rstrip(b'\0').decode()
+    return True
+
+  def readSnapshot(self): # Copies the latest of the two snapshots, retrying if the solver was writing it, and returns True if it is new
+    headerSize = struct.calcsize("<8s4i256s64s")
+    slotHeader = struct.calcsize("<Ii3d")
+    n = struct.unpack_from("<i", self.snapshot, 8)[0]
+    slotSize = (slotHeader + 4*n + 7) // 8 * 8
+    while True:
+      latest = struct.unpack_from("<i", self.snapshot, 12)[0]
+      offset = headerSize + latest*slotSize
+      sequence, iterNum, iterBest, globBest, elapsed = struct.unpack_from("<Ii3d", self.snapshot, offset)
+      if sequence % 2 == 1:
+        continue
+      tour = struct.unpack_from("<%di" % n, self.snapshot, offset + slotHeader)
+      if struct.unpack_from("<I", self.snapshot, offset)[0] == sequence:
+        break
+    if iterNum == self.iterNum:
+      return False
+    self.iterNum = iterNum
+    self.tour = list(tour)
+    self.iterBest.append(iterBest)
+    self.globBest.append(globBest)
+    self.gmax = max(self.gmax, iterBest, globBest)
+    self.gmin = min(self.gmin, iterBest, globBest)
+    return True
+
   def readEarlyData(self):
-    TSPFile = self.input.split(':')[0]
-    self.TSPName = self.input.split(':')[1]
+    if self.useShm:
+      TSPFile = self.TSPFile
+    else:
+      TSPFile = self.input.split(':')[0]
+      self.TSPName = self.input.split(':')[1]
     t = open(TSPFile, 'r')
     coord_mode = False
     for line in t:
@@ -433,7 +493,7 @@ class Graph(): # Class for making a graph of the ACO route
     return
   
   def close(self):
-    if self.deleteFile:
+    if self.deleteFile and not self.useShm:
       try:
         remove(self.fname)
       except WindowsError:
@@ -0,0 +1,170 @@
+/****************************************
+ * EditCheck.cpp                        *
+ * Peter Ahrens                         *
+ * Checks the city edit API             *
+ ****************************************/
+
+//Usage: EditCheck
+//Inserts, moves and removes cities of a small seeded instance, then checks the edited matrix against one built cold from the edited coordinates, and that the global best tour is still a tour of the length the colony reports. Exits nonzero if a check fails.
+
+#include "RankBasedAntSystem.h"
+#include <cstdio>
+
+//Check Values
+#define CHECK_SEED 1 // Seed of the instance and the colony.
+#define CHECK_SIDE 1000 // Cities lie in a square of this side.
+#define CHECK_CITIES 16 // Cities of the instance before the edits.
+#define CHECK_ANTS 8 // Ants of the colony.
+#define CHECK_TOLERANCE 1e-3 // Largest relative difference of two lengths taken as equal.
+
+//randomCoord: Steps the generator and returns a coordinate in [0, CHECK_SIDE).
+static float randomCoord(unsigned long long& state)
+{
+  state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (state >> 11) * (CHECK_SIDE / 9007199254740992.0);
+}
+
+//coldDistances: Computes the distance matrix of the given cities as a colony would from their coordinates, with FLT_MAX on the diagonal.
+static thrust::host_vector<float> coldDistances(const std::vector<float>& X, const std::vector<float>& Y)
+{
+  const int numCities = X.size();
+  thrust::host_vector<float> distances(numCities*numCities);
+  for(int i = 0; i < numCities; i++){
+    for(int j = 0; j < numCities; j++){
+      distances[i*numCities + j] = coordDistance(&X[0],&Y[0])(i,j);
+    }
+  }
+  return distances;
+}
+
+//sameLength: Checks that two lengths agree to CHECK_TOLERANCE of the larger.
+static bool sameLength(double a, double b)
+{
+  return fabs(a - b) <= CHECK_TOLERANCE * std::max(fabs(a), fabs(b));
+}
+
+//checkBestTour: Checks that the global best tour visits every city once and that its length over the cold matrix is the global best distance.
+static bool checkBestTour(RankBasedAntSystem<>& colony, const thrust::host_vector<float>& cold, const char* when)
+{
+  const int numCities = colony.getNumCities();
+  thrust::host_vector<int> tour = colony.getGlobBestTour();
+  if(tour.size() != numCities){
+    cout << "The global best tour " << when << " has " << tour.size() << " cities rather than " << numCities << "\n";
+    return false;
+  }
+  std::vector<bool> seen(numCities, false);
+  for(int k = 0; k < numCities; k++){
+    if(tour[k] < 0 || tour[k] >= numCities || seen[tour[k]]){
+      cout << "The global best tour " << when << " is not a permutation, at place " << k << "\n";
+      return false;
+    }
+    seen[tour[k]] = true;
+  }
+  double length = 0;
+  for(int k = 0; k < numCities; k++){
+    length += cold[tour[k]*numCities + tour[(k + 1) % numCities]];
+  }
+  if(!sameLength(length, colony.getGlobBestDist())){
+    cout << "The global best tour " << when << " is " << length << " long, but the colony reports " << colony.getGlobBestDist() << "\n";
+    return false;
+  }
+  return true;
+}
+
+//checkEdits: Runs a colony, edits it, then checks its matrix against a cold one and its global best tour, before and after another forage.
+static bool checkEdits()
+{
+  unsigned long long state = CHECK_SEED;
+  std::vector<float> X, Y;
+  for(int i = 0; i < CHECK_CITIES; i++){
+    X.push_back(randomCoord(state));
+    Y.push_back(randomCoord(state));
+  }
+  thrust::host_vector<float> hostDistances = coldDistances(X, Y);
+  thrust::device_vector<float> distances = hostDistances;
+  RankBasedAntSystem<> colony(distances, &X[0], &Y[0], CHECK_CITIES, CHECK_ANTS);
+  colony.setSeed(CHECK_SEED);
+  colony.initialize();
+  colony.forage();
+  colony.forage();
+
+  //the same edits on the coordinates, where a removed city gives its index to the last one as in removeCity
+  for(int k = 0; k < 2; k++){
+    const float x = randomCoord(state);
+    const float y = randomCoord(state);
+    if(colony.insertCity(x, y) != X.size()){
+      cout << "insertCity did not add the city last\n";
+      return false;
+    }
+    X.push_back(x);
+    Y.push_back(y);
+  }
+  X[3] = randomCoord(state);
+  Y[3] = randomCoord(state);
+  if(!colony.moveCity(3, X[3], Y[3])){
+    cout << "moveCity refused city 3\n";
+    return false;
+  }
+  const int removed[] = {5, 0};
+  for(int k = 0; k < 2; k++){
+    if(!colony.removeCity(removed[k])){
+      cout << "removeCity refused city " << removed[k] << "\n";
+      return false;
+    }
+    X[removed[k]] = X.back();
+    Y[removed[k]] = Y.back();
+    X.pop_back();
+    Y.pop_back();
+  }
+  colony.finishEdits();
+
+  if(colony.getNumCities() != X.size()){
+    cout << "The colony has " << colony.getNumCities() << " cities after the edits rather than " << X.size() << "\n";
+    return false;
+  }
+  thrust::host_vector<float> cold = coldDistances(X, Y);
+  thrust::host_vector<float> edited = distances;
+  if(edited.size() != cold.size()){
+    cout << "The edited matrix has " << edited.size() << " entries rather than " << cold.size() << "\n";
+    return false;
+  }
+  for(int k = 0; k < cold.size(); k++){
+    if(edited[k] != cold[k] && !sameLength(edited[k], cold[k])){
+      cout << "Edge " << k / X.size() << "-" << k % X.size() << " is " << edited[k] << " after the edits, but " << cold[k] << " built cold\n";
+      return false;
+    }
+  }
+  if(!checkBestTour(colony, cold, "after the edits")){
+    return false;
+  }
+
+  //a colony built cold from the edited coordinates must run on the same matrix
+  thrust::device_vector<float> coldDevice = cold;
+  RankBasedAntSystem<> coldColony(coldDevice, &X[0], &Y[0], X.size(), CHECK_ANTS);
+  coldColony.setSeed(CHECK_SEED);
+  coldColony.initialize();
+  coldColony.forage();
+  if(!checkBestTour(coldColony, cold, "of the cold colony")){
+    return false;
+  }
+  colony.forage();
+  return checkBestTour(colony, cold, "after a forage on the edited colony");
+}
+
+int main(int argc, char* argv[])
+{
+  bool passed = checkEdits();
+  cout << (passed ? "City edits kept the colony consistent\n" : "City edits left the colony inconsistent\n");
+  return passed ? 0 : 1;
+}
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
@@ -0,0 +1,157 @@
+/****************************************
+ * MaxMinAntSystem.cu                   *
+ * Peter Ahrens                         *
+ * Performs specific MMAS procedures    *
+ ****************************************/
+
+#include "MaxMinAntSystem.h"
+//constructor: Nothing is allocated, since the rules only use the colony's scratch. AntSystem sets the defaults.
+template <typename Base>
+maxMin<Base>::maxMin(thrust::device_vector<float>& newDistances, float* newXcoords, float* newYcoords, int newNumCities, int newNumAnts)
+  : Base(newDistances, newXcoords, newYcoords, newNumCities, newNumAnts)
+{
+}
+
+template <typename Base>
+const char* maxMin<Base>::name()
+{
+  return "MMAS";
+}
+
+//rulesMemory: Returns 0. The rules lay pheromone through the colony's scratch buffers, which estimateMemory already counts.
+template <typename Base>
+size_t maxMin<Base>::rulesMemory(int numCities, int numAnts, int ranks)
+{
+  return 0;
+}
+
+//resetRules: Restores the default evaporation and pBest.
+template <typename Base>
+void maxMin<Base>::resetRules()
+{
+  rho = MMAS_RHO;
+  pBest = MMAS_P_BEST;
+}
+
+//configureRules: Takes pBest from -pBest, leaving the default if it is missing. -r still sets the evaporation.
+template <typename Base>
+void maxMin<Base>::configureRules(int argc, char* argv[])
+{
+  for(int i = 0; i < argc;i++){
+    if (std::string(argv[i]) == "-pBest"){
+      setPBest(atof(argv[i+1]));
+    }
+  }
+}
+
+//computeParameters: Starts every edge at tauMax of the greedy tour, so the first iterations explore.
+template <typename Base>
+void maxMin<Base>::computeParameters()
+{
+  computeBounds(greedyDistance());
+  initialPheromone = tauMax;
+}
+
+//computeBounds: Computes tauMax = 1/(rho*bestDist), and tauMin from the chance pBest that a converged ant, choosing among about numCities/2 cities a step, builds the best tour.
+template <typename Base>
+void maxMin<Base>::computeBounds(float bestDist)
+{
+  tauMax = 1.0f / (rho * bestDist);
+  tauMin = 0;
+  if(numCities > 2){
+    float root = pow(pBest, 1.0f / numCities);
+    tauMin = tauMax * (1 - root) / ((numCities / 2.0f - 1) * root);
+  }
+  if(tauMin > tauMax){
+    tauMin = tauMax;
+  }
+}
+
+//updatePheromones: Evaporates, then the iteration best tour lays pheromone, or the global best every MMAS_GLOBAL_EVERY iterations. Every level is then kept within the bounds of the global best.
+//The bounds touch every edge, so unlike the rank-based update this recomputes all the probabilities each iteration.
+template <typename Base>
+void maxMin<Base>::updatePheromones()
+{
+  //evaporate
+  evaporate(1.0f-rho);
+  //collect the edges of the tour that lays pheromone
+  bool global = iteration % MMAS_GLOBAL_EVERY == 0;
+  computeEdges(global ? globBestTour : iterBestTour,ACInt);
+  int numEdges = numCities;
+  if(matrixFree){
+    //the edges off the candidate lists all share the spare slot, which is laid once
+    thrust::sort(exec,
+		 ACInt.begin(),
+		 ACInt.begin() + numCities);
+    numEdges = thrust::unique(exec,
+			      ACInt.begin(),
+			      ACInt.begin() + numCities) - ACInt.begin();
+  }
+  thrust::fill(exec,
+	       ACFloat.begin(),
+	       ACFloat.begin() + numEdges,
+	       1.0f / (global ? globBestDist : iterBestDist));
+  //lay pheromone, then bound every level
+  depositPheromones(ACInt,ACFloat,numEdges);
+  computeBounds(globBestDist);
+  boundPheromones(tauMin,tauMax);
+}
+
+template <typename Base>
+void maxMin<Base>::setPBest(float newPBest)
+{
+  pBest = newPBest;
+}
+
+template <typename Base>
+float maxMin<Base>::getPBest()
+{
+  return pBest;
+}
+
+template <typename Base>
+int maxMin<Base>::getRanks()
+{
+  return 0;
+}
+
+template <typename Base>
+void maxMin<Base>::printRules()
+{
+}
+
+template <typename Base>
+void maxMin<Base>::resizeRules()
+{
+}
+
+//The colonies Setup picks from, as in Colony.cu. AntSystem is defined in its header, so only the rules are instantiated here.
+template class maxMin<Colony<int,float,deviceBackend> >;
+template class maxMin<Colony<unsigned short,float,deviceBackend> >;
+template class maxMin<Colony<int,compactFloat,deviceBackend> >;
+template class maxMin<Colony<unsigned short,compactFloat,deviceBackend> >;
+#ifdef HOST_BACKENDS
+template class maxMin<Colony<int,float,cppBackend> >;
+template class maxMin<Colony<unsigned short,float,cppBackend> >;
+template class maxMin<Colony<int,compactFloat,cppBackend> >;
+template class maxMin<Colony<unsigned short,compactFloat,cppBackend> >;
+template class maxMin<Colony<int,float,ompBackend> >;
+template class maxMin<Colony<unsigned short,float,ompBackend> >;
+template class maxMin<Colony<int,compactFloat,ompBackend> >;
+template class maxMin<Colony<unsigned short,compactFloat,ompBackend> >;
+template class maxMin<Colony<int,float,tbbBackend> >;
+template class maxMin<Colony<unsigned short,float,tbbBackend> >;
+template class maxMin<Colony<int,compactFloat,tbbBackend> >;
+template class maxMin<Colony<unsigned short,compactFloat,tbbBackend> >;
+#endif
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
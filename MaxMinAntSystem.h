@@ -0,0 +1,69 @@
+/****************************************
+ * MaxMinAntSystem.h                    *
+ * Peter Ahrens                         *
+ * Performs specific MMAS procedures    *
+ ****************************************/
+
+#ifndef MAXMINANTSYSTEM_H
+#define MAXMINANTSYSTEM_H
+#include "AntSystem.h"
+
+//MAX-MIN Ant System Values
+#define MMAS_RHO 0.02f // Default evaporation, slower than the other variants since the bounds keep every edge alive.
+#define MMAS_P_BEST 0.05f // Default chance of an ant that has converged building the best tour again, which sets the ratio of the bounds.
+#define MMAS_GLOBAL_EVERY 10 // The global best tour lays pheromone every this many iterations, the iteration best the others.
+
+//maxMin: The rules of a MAX-MIN Ant System, for AntSystem. After evaporation, only one tour lays pheromone, and every level is then kept within [tauMin, tauMax], so no edge is ever ruled out.
+//tauMax follows the global best length, and tauMin is the fraction of it given by pBest.
+template <typename Base>
+class maxMin : public Base{
+ public:
+  maxMin(thrust::device_vector<float>& newDistances, float* newXcoords, float* newYcoords, int newNumCities, int newNumAnts);
+  static const char* name(); // MMAS.
+  static size_t rulesMemory(int numCities, int numAnts, int ranks); // 0, since the rules only use the colony's scratch.
+  void setPBest(float newPBest);
+  float getPBest();
+ protected:
+  void resetRules(); // Restores the default evaporation and pBest.
+  void configureRules(int argc, char* argv[]); // Takes pBest from -pBest.
+  void computeParameters(); // Starts every edge at tauMax of the greedy tour.
+  void updatePheromones(); // Evaporates, lays pheromone on the iteration or global best tour, then bounds every level.
+  int getRanks(); // 0, since only one tour lays pheromone.
+  void printRules(); // Nothing, since the rules use the colony's scratch.
+  void resizeRules(); // Nothing, since the rules use the colony's scratch.
+  void computeBounds(float bestDist); // Computes tauMax and tauMin from the length of the best tour so far.
+  //the Colony members used here, since names are not looked up in a base that depends on the template parameters
+  using Base::numCities;
+  using Base::matrixFree;
+  using Base::rho;
+  using Base::iteration;
+  using Base::initialPheromone;
+  using Base::iterBestDist;
+  using Base::globBestDist;
+  using Base::iterBestTour;
+  using Base::globBestTour;
+  using Base::ACInt;
+  using Base::ACFloat;
+  using Base::evaporate;
+  using Base::computeEdges;
+  using Base::depositPheromones;
+  using Base::boundPheromones;
+  using Base::greedyDistance;
+  using Base::exec;
+  float pBest;
+  float tauMax;
+  float tauMin;
+};
+
+#endif
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
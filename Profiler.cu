@@ -0,0 +1,150 @@
+/****************************************
+ * Profiler.cu                          *
+ * Peter Ahrens                         *
+ * Times the phases of each iteration   *
+ ****************************************/
+
+#include "Profiler.h"
+
+const char* Profiler::phaseNames[NUM_PHASES + 1] = {"start", "step", "select", "search", "measure", "update", "probabilities", "iteration"};
+
+//Constructor: Starts with no iterations and empty histograms.
+Profiler::Profiler()
+{
+  iterations = 0;
+  iterStart = now();
+  iterationSeconds = 0;
+  for(int p = 0; p <= NUM_PHASES; p++){
+    if(p < NUM_PHASES){
+      started[p] = 0;
+      calls[p] = 0;
+      seconds[p] = 0;
+      bytes[p] = 0;
+    }
+    iterSeconds[p] = 0;
+    minIter[p] = 0;
+    maxIter[p] = 0;
+    for(int b = 0; b < PROFILE_BUCKETS; b++){
+      histogram[p][b] = 0;
+    }
+  }
+}
+
+//startIteration: Starts the timer of a whole iteration.
+void Profiler::startIteration()
+{
+  iterStart = now();
+  for(int p = 0; p < NUM_PHASES; p++){ //time before the first iteration, such as initialize, only goes into the totals
+    iterSeconds[p] = 0;
+  }
+}
+
+//start: Starts the timer of a phase.
+void Profiler::start(int phase)
+{
+  started[phase] = now();
+}
+
+//stop: Stops the timer of a phase and counts bytes as touched by it. The device is waited for first, since thrust calls can return before their work is done.
+void Profiler::stop(int phase, double newBytes)
+{
+#if THRUST_DEVICE_SYSTEM == THRUST_DEVICE_SYSTEM_CUDA
+  cudaDeviceSynchronize();
+#endif
+  double elapsed = now() - started[phase];
+  calls[phase]++;
+  seconds[phase] += elapsed;
+  bytes[phase] += newBytes;
+  iterSeconds[phase] += elapsed;
+}
+
+//endIteration: Adds the time this iteration spent in each phase, and in all of it, to the histograms.
+void Profiler::endIteration()
+{
+  iterSeconds[NUM_PHASES] = now() - iterStart;
+  iterationSeconds += iterSeconds[NUM_PHASES];
+  for(int p = 0; p <= NUM_PHASES; p++){
+    if(iterations == 0 || iterSeconds[p] < minIter[p]){
+      minIter[p] = iterSeconds[p];
+    }
+    if(iterations == 0 || iterSeconds[p] > maxIter[p]){
+      maxIter[p] = iterSeconds[p];
+    }
+    int bucket = 0;
+    for(double us = iterSeconds[p] * 1e6; us >= 2 && bucket < PROFILE_BUCKETS - 1; us /= 2){
+      bucket++;
+    }
+    histogram[p][bucket]++;
+    iterSeconds[p] = 0;
+  }
+  iterations++;
+}
+
+//write: Writes the calls, seconds, bytes, bandwidth, fastest and slowest iteration and histogram of every phase, and of whole iterations last.
+//A .json file gets one object, anything else gets CSV with one row per phase. Returns false if the file cannot be opened.
+bool Profiler::write(string filen)
+{
+  ofstream f(filen.c_str(), ios_base::out);
+  if(!f){
+    cout << "Unable to open profile file " << filen << "\n";
+    return false;
+  }
+  bool json = filen.size() >= 5 && filen.substr(filen.size() - 5) == ".json";
+  if(json){
+    f << "{\"iterations\": " << iterations << ", \"bucket_us\": \"2^(k+1)\", \"phases\": [";
+  }else{
+    f << "Phase,Calls,Seconds,Bytes,GB_per_s,Min_Iter,Max_Iter";
+    for(int b = 0; b < PROFILE_BUCKETS; b++){
+      f << ",Under_2^" << b + 1 << "us";
+    }
+    f << "\n";
+  }
+  for(int p = 0; p <= NUM_PHASES; p++){
+    long phaseCalls = p < NUM_PHASES ? calls[p] : iterations;
+    double phaseSeconds = p < NUM_PHASES ? seconds[p] : iterationSeconds;
+    double phaseBytes = p < NUM_PHASES ? bytes[p] : 0;
+    double rate = phaseSeconds > 0 ? phaseBytes / phaseSeconds * 1e-9 : 0;
+    if(json){
+      f << (p > 0 ? ", " : "") << "{\"name\": \"" << phaseNames[p] << "\", \"calls\": " << phaseCalls << ", \"seconds\": " << phaseSeconds
+	<< ", \"bytes\": " << phaseBytes << ", \"gb_per_s\": " << rate << ", \"min_iter\": " << minIter[p] << ", \"max_iter\": " << maxIter[p] << ", \"histogram\": [";
+      for(int b = 0; b < PROFILE_BUCKETS; b++){
+	f << (b > 0 ? ", " : "") << histogram[p][b];
+      }
+      f << "]}";
+    }else{
+      f << phaseNames[p] << "," << phaseCalls << "," << phaseSeconds << "," << phaseBytes << "," << rate << "," << minIter[p] << "," << maxIter[p];
+      for(int b = 0; b < PROFILE_BUCKETS; b++){
+	f << "," << histogram[p][b];
+      }
+      f << "\n";
+    }
+  }
+  if(json){
+    f << "]}\n";
+  }
+  return true;
+}
+
+double Profiler::getSeconds(int phase)
+{
+  return seconds[phase];
+}
+
+//now: Returns monotonic wall clock seconds, which unlike clock() do not add up the time of every thread.
+double Profiler::now()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
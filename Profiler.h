@@ -0,0 +1,69 @@
+/****************************************
+ * Profiler.h                           *
+ * Peter Ahrens                         *
+ * Times the phases of each iteration   *
+ ****************************************/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <thrust/device_vector.h>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <time.h>
+using namespace std;
+
+//Profiled Phases
+#define PHASE_START 0 // Choosing the start cities of the stepwise construction.
+#define PHASE_STEP 1 // Each step of the stepwise construction, or the whole fused construction.
+#define PHASE_SELECT 2 // The reduce that picks each ant's next city in the stepwise construction.
+#define PHASE_SEARCH 3 // Local search.
+#define PHASE_MEASURE 4 // computeAntDistances.
+#define PHASE_UPDATE 5 // updatePheromones.
+#define PHASE_PROBABILITIES 6 // computeProbabilities.
+#define NUM_PHASES 7
+
+//Profiler Values
+#define PROFILE_BUCKETS 32 // Histogram bucket k counts iterations that spent under 2^(k+1) microseconds in a phase.
+
+//Profiler: Wall clock timers around the phases of Colony::forage, with an estimate of the bytes each phase touches and a histogram of the time each iteration spends in it.
+//Each stop waits for the device, so the time of a phase is not charged to the next one. A colony without a profiler pays nothing.
+class Profiler
+{
+ public:
+  Profiler(); // Starts with no iterations.
+  void startIteration(); // Starts the timer of a whole iteration.
+  void start(int phase); // Starts the timer of a phase.
+  void stop(int phase, double bytes); // Stops the timer of a phase and counts bytes as touched by it.
+  void endIteration(); // Adds the time this iteration spent in each phase to the histograms.
+  bool write(string filen); // Writes the totals and histograms as JSON if filen ends in .json, otherwise as CSV.
+  double getSeconds(int phase); // Returns the total seconds spent in a phase.
+  static double now(); // Returns monotonic wall clock seconds.
+ private:
+  double started[NUM_PHASES];
+  long calls[NUM_PHASES];
+  double seconds[NUM_PHASES];
+  double bytes[NUM_PHASES];
+  double iterSeconds[NUM_PHASES + 1]; // This iteration's time in each phase, and in the whole iteration last.
+  double minIter[NUM_PHASES + 1];
+  double maxIter[NUM_PHASES + 1];
+  long histogram[NUM_PHASES + 1][PROFILE_BUCKETS];
+  int iterations;
+  double iterStart;
+  double iterationSeconds; // Time spent in whole iterations.
+  static const char* phaseNames[NUM_PHASES + 1];
+};
+
+#endif
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
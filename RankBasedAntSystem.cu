@@ -5,158 +5,167 @@
  ****************************************/
 
 #include "RankBasedAntSystem.h"
-#include <thrust/swap.h>
-//constructor: Allocates memory and sets defaults.
-RankBasedAntSystem::RankBasedAntSystem(thrust::host_vector<float> newDistances, int newNumCities, int newNumAnts)
-  : Colony(newDistances, newNumCities, newNumAnts)
+//constructor: Allocates the rank buffers. AntSystem sets the defaults.
+template <typename Base>
+rankBased<Base>::rankBased(thrust::device_vector<float>& newDistances, float* newXcoords, float* newYcoords, int newNumCities, int newNumAnts)
+  : Base(newDistances, newXcoords, newYcoords, newNumCities, newNumAnts)
 {
-  w = 6;//default
   RBASWeight = thrust::device_vector<float>(numAnts);
-  RBASMap = thrust::device_vector<int>(numAnts*numCities);
+  RBASOrder = thrust::device_vector<int>(numAnts);
 }
 
-//initialize: Runs the Colony initialize, then creates additional maps and keys.
-void RankBasedAntSystem::initialize()
+template <typename Base>
+const char* rankBased<Base>::name()
 {
-  Colony::initialize();
-  thrust::fill(RBASWeight.begin(),RBASWeight.end(),0);
-  thrust::copy_n(thrust::make_reverse_iterator(thrust::make_counting_iterator(w)),
-		 w,
-		 RBASWeight.begin());
-  thrust::fill(ACInt.begin(),
-	       ACInt.end(),
-	       0);
-  ACInt[numCities] = 1;
-  thrust::inclusive_scan(ACInt.begin(),
-			 ACInt.end(),
-			 ACInt.begin());
-  thrust::exclusive_scan_by_key(ACInt.begin(),
-				ACInt.end(),
-				thrust::make_constant_iterator(1,0),
-				RBASMap.begin());
+  return "RBAS";
 }
 
-//computeParameters: Simply computes neccesary parameters.
-void RankBasedAntSystem::computeParameters()
+//rulesMemory: Returns the bytes of the rank buffers, the weights and order of every ant and the edges and deposits of w tours, with w kept within the ants and cities as computeParameters keeps it.
+template <typename Base>
+size_t rankBased<Base>::rulesMemory(int numCities, int numAnts, int ranks)
 {
-  if (numCities < w){
-    w = numCities;
+  size_t ranked = std::min(ranks > 0 ? ranks : RBAS_W, std::min(numCities, numAnts));
+  return 4*(2*(size_t)numAnts + 2*ranked*numCities);
+}
+
+//resetRules: Restores the default w, which computeParameters may have lowered for the last instance.
+template <typename Base>
+void rankBased<Base>::resetRules()
+{
+  w = RBAS_W;
+}
+
+//configureRules: Takes w from -w, leaving the default if it is missing.
+template <typename Base>
+void rankBased<Base>::configureRules(int argc, char* argv[])
+{
+  for(int i = 0; i < argc;i++){
+    if (std::string(argv[i]) == "-w"){
+      setW(atoi(argv[i+1]));
+    }
   }
-  computeInitialPheromone();
 }
 
-//computeInitialPheromone: Computes the initial pheromone level with the formula described by Marco Dorigo.
-void RankBasedAntSystem::computeInitialPheromone()
+//computeParameters: Keeps w within the ants and cities, creates the rank weights and the ranked edge lists, then computes the initial pheromone level with the formula described by Marco Dorigo.
+template <typename Base>
+void rankBased<Base>::computeParameters()
 {
-  initialPheromone = 0.5*w*(w-1)/(rho * Colony::greedyDistance());
+  if (numCities < w){
+    w = numCities;
+  }
+  if (numAnts < w){
+    w = numAnts;
+  }
+  thrust::fill(exec,RBASWeight.begin(),RBASWeight.end(),0);
+  thrust::copy_n(exec,
+		 thrust::make_reverse_iterator(thrust::make_counting_iterator(w)),
+		 w,
+		 RBASWeight.begin());
+  RBASEdges.resize(w*numCities);
+  RBASDeposits.resize(w*numCities);
+  initialPheromone = 0.5*w*(w-1)/(rho * greedyDistance());
 }
 
 //updataPheromones: Evaporates, then the ants lay pheromone at levels corresponding to their rank, judged by the distances of their tours.
-void RankBasedAntSystem::updatePheromones()
+template <typename Base>
+void rankBased<Base>::updatePheromones()
 {
   //evaporate
-  thrust::transform(pheromones.begin(),
-		    pheromones.end(),
-		    thrust::make_constant_iterator(1.0f-rho),
-		    pheromones.begin(),
-		    thrust::multiplies<float>());
+  evaporate(1.0f-rho);
+  //rank the ants by moving their indices, not their tours
+  thrust::sequence(exec,
+		   RBASOrder.begin(),
+		   RBASOrder.end());
+  AFloat.assign(exec,antDistances.begin(),antDistances.end());
+  thrust::sort_by_key(exec,
+		      AFloat.begin(),
+		      AFloat.end(),
+		      RBASOrder.begin());
   //determine ant pheromone levels
-  //sort first w ants
-  int x,z;
-  for(int i = 0; i < w; i++){
-    x = thrust::min_element(antDistances.begin() + i,antDistances.end())-(antDistances.begin() + i) + i;
-	z = antDistances[i];
-	antDistances[i] = antDistances[x];
-	antDistances[x] = z;
-    thrust::swap_ranges(antTours.begin() + i*numCities, antTours.begin() + (i+1)*numCities,antTours.begin() + x*numCities); 
-  }
-  thrust::transform(RBASWeight.begin(),
-		    RBASWeight.end(),
-		    antDistances.begin(),
+  thrust::transform(exec,
+		    RBASWeight.begin(),
+		    RBASWeight.begin() + w,
+		    AFloat.begin(),
 		    AFloat.begin(),
 		    thrust::divides<float>());
   AFloat[w-1] = w/globBestDist;
   //AFloat[w-1] = w/iterBestDist;//for a simple rankbased, without global pheromone
-  ACInt.assign(antTours.begin(),antTours.end());
-  thrust::scatter(globBestTour.begin(),globBestTour.end(),thrust::make_counting_iterator(numCities*(w-1)),ACInt.begin()); 
-  //thrust::scatter(iterBestTour.begin(),
-	//	  iterBestTour.end(),
-	//	  thrust::make_counting_iterator(numCities*(w-1)),
-	//	  ACInt.begin()); //for a simple rankbased, without global pheromone
-  thrust::transform(ACInt.begin(),
-		    ACInt.end(),
-		    thrust::make_permutation_iterator(ACInt.begin(),distMap.begin()), 
-		    ACInt2.begin(),
-		    saxpy_functor(numCities));
-  //lay Pheromone 
-  for(int i = 0; i < numCities*numAnts; i += numCities){
-    thrust::transform(thrust::make_permutation_iterator(pheromones.begin(),ACInt2.begin() + i),
-		      thrust::make_permutation_iterator(pheromones.end(),ACInt2.begin() + i + numCities), 
-		      thrust::make_permutation_iterator(AFloat.begin(),ACKey.begin() + i),
-		      thrust::make_permutation_iterator(pheromones.begin(),ACInt2.begin() + i),thrust::plus<float>());
-  }
-}
-
-//forage: Runs Colony forage.
-void RankBasedAntSystem::forage()
-{
-  Colony::forage();
-}
-
-void RankBasedAntSystem::setRho(float newRho)
-{
-  Colony::setRho(newRho);
-}
-
-void RankBasedAntSystem::setBeta(float newBeta)
-{
-  Colony::setBeta(newBeta);
-}
-
-void RankBasedAntSystem::setW(int newW)
+  //collect the edges of the w-1 best tours, then the global best tour; the tours of the other ants are never read
+  computeEdges(antTours,thrust::raw_pointer_cast(&RBASOrder[0]),w-1,arenaSpan<int>(RBASEdges.data(),(w-1)*numCities));
+  computeEdges(globBestTour,arenaSpan<int>(RBASEdges.data() + (w-1)*numCities,numCities));
+  //computeEdges(iterBestTour,arenaSpan<int>(RBASEdges.data() + (w-1)*numCities,numCities));//for a simple rankbased, without global pheromone
+  thrust::gather(exec,
+		 ACKey.begin(),
+		 ACKey.begin() + w*numCities,
+		 AFloat.begin(),
+		 RBASDeposits.begin());
+  //sum the pheromone on edges shared by several tours, so each edge is laid once
+  thrust::sort_by_key(exec,
+		      RBASEdges.begin(),
+		      RBASEdges.end(),
+		      RBASDeposits.begin());
+  int numEdges = thrust::reduce_by_key(exec,
+				       RBASEdges.begin(),
+				       RBASEdges.end(),
+				       RBASDeposits.begin(),
+				       ACInt.begin(),
+				       ACFloat.begin()).first - ACInt.begin();
+  //lay Pheromone
+  depositPheromones(ACInt,ACFloat,numEdges);
+}
+
+template <typename Base>
+void rankBased<Base>::setW(int newW)
 {
   w = newW;
 }
 
-int RankBasedAntSystem::getW()
+template <typename Base>
+int rankBased<Base>::getW()
 {
   return w;
 }
 
-double RankBasedAntSystem::getRho()
-{
-  return Colony::getRho();
-}
-
-double RankBasedAntSystem::getBeta()
-{
-  return Colony::getBeta();
-}
-
-int RankBasedAntSystem::getNumAnts()
+template <typename Base>
+int rankBased<Base>::getRanks()
 {
-  return Colony::getNumAnts();
-}
-
-double RankBasedAntSystem::getIterBestDist()
-{
-  return Colony::getIterBestDist();
-}
-
-double RankBasedAntSystem::getGlobBestDist()
-{
-  return Colony::getGlobBestDist();
-}
-
-int RankBasedAntSystem::getReps()
-{
-  return Colony::getReps();
+  return w;
 }
 
-std::string RankBasedAntSystem::getTour()
-{
-  return Colony::getTour();
-}
+//resizeRules: Sizes the ranked edge lists for the number of cities, after an edit has changed it.
+template <typename Base>
+void rankBased<Base>::resizeRules()
+{
+  RBASEdges.resize(w*numCities);
+  RBASDeposits.resize(w*numCities);
+}
+
+//printRules: Prints the size of the rank buffers.
+template <typename Base>
+void rankBased<Base>::printRules()
+{
+  cout << std::left << setw(16) << "RBAS buffers" << (RBASWeight.size() + RBASOrder.size() + RBASEdges.size() + RBASDeposits.size())*4 << "\n";
+}
+
+//The colonies Setup picks from, as in Colony.cu. AntSystem is defined in its header, so only the rules are instantiated here.
+template class rankBased<Colony<int,float,deviceBackend> >;
+template class rankBased<Colony<unsigned short,float,deviceBackend> >;
+template class rankBased<Colony<int,compactFloat,deviceBackend> >;
+template class rankBased<Colony<unsigned short,compactFloat,deviceBackend> >;
+#ifdef HOST_BACKENDS
+template class rankBased<Colony<int,float,cppBackend> >;
+template class rankBased<Colony<unsigned short,float,cppBackend> >;
+template class rankBased<Colony<int,compactFloat,cppBackend> >;
+template class rankBased<Colony<unsigned short,compactFloat,cppBackend> >;
+template class rankBased<Colony<int,float,ompBackend> >;
+template class rankBased<Colony<unsigned short,float,ompBackend> >;
+template class rankBased<Colony<int,compactFloat,ompBackend> >;
+template class rankBased<Colony<unsigned short,compactFloat,ompBackend> >;
+template class rankBased<Colony<int,float,tbbBackend> >;
+template class rankBased<Colony<unsigned short,float,tbbBackend> >;
+template class rankBased<Colony<int,compactFloat,tbbBackend> >;
+template class rankBased<Colony<unsigned short,compactFloat,tbbBackend> >;
+#endif
 
 //Copyright (c) 2012, Peter Ahrens
 //All rights reserved.
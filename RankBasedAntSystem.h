@@ -6,32 +6,58 @@
 
 #ifndef RANKBASEDANTSYSTEM_H
 #define RANKBASEDANTSYSTEM_H
-#include "Colony.h"
+#include "AntSystem.h"
 
-//RankBasedAntSystem: Provides the neccesary extensions to Colony to create a Rank-Based Ant System
-class RankBasedAntSystem : Colony{
+//Rank-Based Ant System Values
+#define RBAS_W 6 // Default w, the number of ranks that lay pheromone, counting the global best tour.
+
+//rankBased: The rules of a Rank-Based Ant System, for AntSystem. After evaporation, the w-1 best ants of the iteration lay pheromone weighted by their rank, and the global best tour lays w times as much.
+template <typename Base>
+class rankBased : public Base{
  public:
-  RankBasedAntSystem(thrust::host_vector<float> newDistances, int newNumCities, int newNumAnts); // Allocates memory and sets defaults.
-  void initialize(); // Runs the Colony initialize, then creates additional maps and keys.
-  void computeParameters(); // Simply computes neccesary parameters.
-  void forage(); // Runs Colony forage.
-  void setRho(float newRho);
-  void setBeta(float newBeta);
+  rankBased(thrust::device_vector<float>& newDistances, float* newXcoords, float* newYcoords, int newNumCities, int newNumAnts); // Allocates the rank buffers.
+  static const char* name(); // RBAS.
+  static size_t rulesMemory(int numCities, int numAnts, int ranks); // The bytes of the rank buffers with w of ranks, or RBAS_W if ranks is 0.
   void setW(int newW);
   int getW();
-  double getRho();
-  double getBeta();
-  int getNumAnts();
-  double getIterBestDist();
-  double getGlobBestDist();
-  int getReps();
-  std::string getTour();
- private:
-  void computeInitialPheromone(); // Computes the initial pheromone level with the formula described by Marco Dorigo.
+ protected:
+  void resetRules(); // Restores the default w.
+  void configureRules(int argc, char* argv[]); // Takes w from -w.
+  void computeParameters(); // Keeps w within the ants and cities, creates the rank weights and computes the initial pheromone level.
   void updatePheromones(); // Evaporates, then the ants lay pheromone at levels corresponding to their rank, judged by the distances of their tours.
+  int getRanks(); // w, which checkpoints are only restored with.
+  void printRules(); // Prints the size of the rank buffers.
+  void resizeRules(); // Sizes the ranked edge lists for the number of cities.
+  //the Colony members used here, since names are not looked up in a base that depends on the template parameters
+  using Base::numCities;
+  using Base::numAnts;
+  using Base::rho;
+  using Base::initialPheromone;
+  using Base::globBestDist;
+  using Base::antTours;
+  using Base::globBestTour;
+  using Base::antDistances;
+  using Base::ACKey;
+  using Base::AFloat;
+  using Base::ACInt;
+  using Base::ACFloat;
+  using Base::evaporate;
+  using Base::computeEdges;
+  using Base::depositPheromones;
+  using Base::greedyDistance;
+  using Base::exec;
   int w;
   thrust::device_vector<float> RBASWeight;
-  thrust::device_vector<int> RBASMap;
+  thrust::device_vector<int> RBASOrder; // The ants sorted by tour length.
+  thrust::device_vector<int> RBASEdges; // The edges of the w-1 best tours and the global best tour.
+  thrust::device_vector<float> RBASDeposits; // The pheromone laid on each of RBASEdges.
+};
+
+//RankBasedAntSystem: A Rank-Based Ant System over the same storage types and backend as Colony, as the islands, the daemon and the GUI run.
+template <typename City = int, typename Level = float, typename Backend = deviceBackend>
+class RankBasedAntSystem : public AntSystem<rankBased,City,Level,Backend>{
+ public:
+  RankBasedAntSystem(thrust::device_vector<float>& newDistances, float* newXcoords, float* newYcoords, int newNumCities, int newNumAnts) : AntSystem<rankBased,City,Level,Backend>(newDistances, newXcoords, newYcoords, newNumCities, newNumAnts) {}
 };
 
 #endif
@@ -0,0 +1,79 @@
+/****************************************
+ * ReaderBench.cpp                      *
+ * Peter Ahrens                         *
+ * Times TSPReader startup against n    *
+ ****************************************/
+
+//Usage: ReaderBench [maxCities]
+//Writes uniform random EUC_2D instances of doubling size to a scratch file and reports how long TSPReader::read takes on each,
+//split into parsing and building the distance matrix. Build with the OpenMP flags to time the parallel matrix build.
+
+#include "TSPReader.h"
+#include <iomanip>
+#include <sys/time.h>
+#include <cstdio>
+#include <cstdlib>
+
+//now: Returns the wall clock time in seconds.
+static double now()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+//writeInstance: Writes a uniform random EUC_2D instance with n cities.
+static bool writeInstance(const char* filen, int n)
+{
+  FILE* f = fopen(filen, "w");
+  if(!f){
+    return false;
+  }
+  fprintf(f, "NAME : bench%d\nTYPE : TSP\nDIMENSION : %d\nEDGE_WEIGHT_TYPE : EUC_2D\nNODE_COORD_SECTION\n", n, n);
+  for(int i = 0; i < n; i++){
+    fprintf(f, "%d %d %d\n", i + 1, rand() % 1000000, rand() % 1000000);
+  }
+  fprintf(f, "EOF\n");
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  int maxCities = 16000;
+  if(argc > 1){
+    maxCities = atoi(argv[1]);
+  }
+  char filen[] = "/tmp/ReaderBench.tsp";
+  srand(1);
+  cout << std::left << setw(10) << "Cities" << setw(12) << "Parse" << setw(12) << "Matrix" << setw(12) << "Total" << "\n";
+  for(int n = 500; n <= maxCities; n *= 2){
+    if(!writeInstance(filen, n)){
+      cout << "Unable to write " << filen << "\n";
+      return 1;
+    }
+    double t1 = now();
+    TSPReader parsed;
+    parsed.read(filen, false);
+    double t2 = now();
+    TSPReader dense;
+    dense.read(filen);
+    double t3 = now();
+    double parse = t2 - t1;
+    double total = t3 - t2;
+    cout << std::left << setw(10) << n << setw(12) << parse << setw(12) << total - parse << setw(12) << total << "\n";
+  }
+  remove(filen);
+  return 0;
+}
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
@@ -0,0 +1,97 @@
+/****************************************
+ * ScratchArena.cu                      *
+ * Peter Ahrens                         *
+ * Shares scratch memory by lifetime    *
+ ****************************************/
+
+#include "ScratchArena.h"
+
+//Constructor: Starts with no reservations and no allocation.
+ScratchArena::ScratchArena()
+{
+  totalWords = 0;
+}
+
+//clear: Forgets every reservation. The allocation is kept, so a layout that fits in it needs no new one.
+void ScratchArena::clear()
+{
+  entries.clear();
+  totalWords = 0;
+}
+
+//reserve: Reserves a buffer of words 4 byte elements, live in the parts of a forage set in lifetimes.
+void ScratchArena::reserve(std::string name, size_t words, int lifetimes)
+{
+  arenaEntry entry;
+  entry.name = name;
+  entry.words = words;
+  entry.lifetimes = lifetimes;
+  entry.offset = 0;
+  entries.push_back(entry);
+}
+
+//plan: Lays the buffers out largest first, each at the lowest aligned offset that does not overlap a buffer it is live with, and returns the bytes the arena needs.
+size_t ScratchArena::plan()
+{
+  std::vector<int> order(entries.size());
+  for(int i = 0; i < order.size(); i++){
+    order[i] = i;
+  }
+  for(int i = 1; i < order.size(); i++){ //stable insertion sort by size, there are only a few buffers
+    for(int j = i; j > 0 && entries[order[j]].words > entries[order[j-1]].words; j--){
+      std::swap(order[j],order[j-1]);
+    }
+  }
+  totalWords = 0;
+  for(int i = 0; i < order.size(); i++){
+    arenaEntry& entry = entries[order[i]];
+    size_t offset = 0;
+    for(bool moved = true; moved;){
+      moved = false;
+      for(int j = 0; j < i; j++){
+	const arenaEntry& placed = entries[order[j]];
+	if((placed.lifetimes & entry.lifetimes) && offset < placed.offset + placed.words && placed.offset < offset + entry.words){
+	  offset = (placed.offset + placed.words + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+	  moved = true;
+	}
+      }
+    }
+    entry.offset = offset;
+    totalWords = std::max(totalWords, offset + entry.words);
+  }
+  return totalWords * sizeof(unsigned int);
+}
+
+//allocate: Plans the layout and grows the allocation if it is too small. The contents of the buffers are not kept.
+void ScratchArena::allocate()
+{
+  plan();
+  if(block.size() < totalWords){
+    thrust::device_vector<unsigned int>().swap(block); //free the old allocation first, so both are never held at once
+    block = thrust::device_vector<unsigned int>(totalWords);
+  }
+}
+
+//print: Prints every buffer with its size, offset and lifetimes, then the arena size against what separate buffers would take.
+void ScratchArena::print()
+{
+  size_t separate = 0;
+  for(int i = 0; i < entries.size(); i++){
+    separate += entries[i].words;
+    std::cout << std::left << std::setw(16) << entries[i].name << std::setw(14) << entries[i].words * sizeof(unsigned int) << "offset " << std::setw(12) << entries[i].offset * sizeof(unsigned int)
+	      << ((entries[i].lifetimes & LIFE_CONSTRUCT) ? "C" : "-") << ((entries[i].lifetimes & LIFE_SEARCH) ? "S" : "-") << ((entries[i].lifetimes & LIFE_MEASURE) ? "M" : "-")
+	      << ((entries[i].lifetimes & LIFE_UPDATE) ? "U" : "-") << ((entries[i].lifetimes & LIFE_SETUP) ? "I" : "-") << "\n";
+  }
+  std::cout << std::left << std::setw(16) << "scratch arena" << std::setw(14) << totalWords * sizeof(unsigned int) << "(" << separate * sizeof(unsigned int) << " unshared)\n";
+}
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
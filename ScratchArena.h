@@ -0,0 +1,93 @@
+/****************************************
+ * ScratchArena.h                       *
+ * Peter Ahrens                         *
+ * Shares scratch memory by lifetime    *
+ ****************************************/
+
+#ifndef SCRATCHARENA_H
+#define SCRATCHARENA_H
+#include <thrust/device_vector.h>
+#include <thrust/device_ptr.h>
+#include <thrust/copy.h>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+//Scratch Lifetimes, the parts of a forage a scratch buffer is live in
+#define LIFE_CONSTRUCT 1 // Tour construction.
+#define LIFE_SEARCH 2 // Local search.
+#define LIFE_MEASURE 4 // Measuring the tours.
+#define LIFE_UPDATE 8 // Laying pheromone.
+#define LIFE_SETUP 16 // Building candidate lists in initialize.
+#define LIFE_ALWAYS 31
+
+//Arena Values
+#define ARENA_ALIGN 32 // Buffers start on multiples of this many words, so accesses stay coalesced.
+
+//arenaSpan: A typed piece of a ScratchArena, used like the device_vector it stands in for. It never owns its memory.
+template <typename T>
+class arenaSpan
+{
+ public:
+  arenaSpan() : first(), length(0) {}
+  arenaSpan(thrust::device_ptr<T> _first, size_t _length) : first ( _first ), length ( _length ) {}
+  thrust::device_ptr<T> begin() const { return first; }
+  thrust::device_ptr<T> end() const { return first + length; }
+  size_t size() const { return length; }
+  thrust::device_reference<T> operator[](size_t i) const { return first[i]; }
+  template <typename Iterator>
+  void assign(Iterator from, Iterator to) { thrust::copy(from, to, first); } // Copies a range no longer than the span into it.
+  template <typename Policy, typename Iterator>
+  void assign(const Policy& exec, Iterator from, Iterator to) { thrust::copy(exec, from, to, first); } // Copies under an execution policy.
+ private:
+  thrust::device_ptr<T> first;
+  size_t length;
+};
+
+//ScratchArena: Gives out scratch buffers of 4 byte elements from one allocation. Every buffer is reserved with the parts of a forage it is live in, and buffers that are never live at the same time share storage.
+class ScratchArena
+{
+ public:
+  ScratchArena();
+  void clear(); // Forgets every reservation, keeping the allocation for the next layout.
+  void reserve(std::string name, size_t words, int lifetimes); // Reserves a buffer of words elements, live in the parts of a forage set in lifetimes.
+  size_t plan(); // Lays the buffers out, each at the lowest offset clear of every buffer it is live with, and returns the bytes the arena needs.
+  void allocate(); // Plans the layout and grows the allocation if it is too small.
+  template <typename T>
+  arenaSpan<T> get(std::string name) // Returns the buffer reserved under name, as many T as fit in its words, or an empty span if there is none.
+  {
+    for(int i = 0; i < entries.size() && block.size() > 0; i++){
+      if(entries[i].name == name){
+	return arenaSpan<T>(thrust::device_pointer_cast((T*)(thrust::raw_pointer_cast(&block[0]) + entries[i].offset)), entries[i].words * sizeof(unsigned int) / sizeof(T));
+      }
+    }
+    return arenaSpan<T>();
+  }
+  void print(); // Prints every buffer with its size and offset, and what sharing saved.
+ private:
+  struct arenaEntry
+  {
+    std::string name;
+    size_t words;
+    int lifetimes;
+    size_t offset;
+  };
+  std::vector<arenaEntry> entries;
+  size_t totalWords;
+  thrust::device_vector<unsigned int> block;
+};
+
+#endif
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
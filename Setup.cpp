@@ -5,9 +5,16 @@
  ****************************************/
 
 #include "RankBasedAntSystem.h"
+#include "MaxMinAntSystem.h"
+#include "AntColonySystem.h"
+#include "Archipelago.h"
+#include "BatchColony.h"
+#include "SolverDaemon.h"
 #include "TSPReader.h"
 #include "Comm.h"
 #include "Writer.h"
+#include "TraceLog.h"
+#include "TourSnapshot.h"
 #include <iostream>
 #include <unistd.h>
 #include <string>
@@ -15,13 +22,399 @@
 #include <ctime>
 #include <fstream>
 #include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <dirent.h>
 using namespace std;
 
+//Calibration Values, for -backend auto
+#define CALIBRATE_FORAGES 3 // Most forages timed on each backend and thread count, after one untimed forage.
+#define CALIBRATE_SECONDS 1 // Timing stops after the forage that passes this many seconds.
+
+//Stagnation Values, for -convergeEvery
+#define STAGNANT_BRANCHING 2.0f // Default lambda-branching factor at or below which a colony has stagnated.
+#define STAGNANT_SIMILARITY 0.95f // Default share of the ants' edges in the global best tour at or above which a colony has stagnated.
+
+//fitBudget: Picks the number of ants and the storage modes that fit in memBudget megabytes, counting the buffers of the variant antHillType names, then builds the distance matrix if it is kept. Returns false if not even one ant fits.
+//The footprint is that of the widest storage types, so it also holds for the narrower ones runColony may pick.
+bool fitBudget(TSPReader& t, int memBudget, string antHillType, int& m, bool& matrixFree, bool& fused, int argc, char* argv[])
+{
+  int numCandidates = 0;
+  bool localSearch = false;
+  int w = 0;
+  for(int i = 0; i < argc; i++){
+    if (string(argv[i]) == "-cand"){
+      numCandidates = atoi(argv[i+1]);
+    }
+    if (string(argv[i]) == "-ls"){
+      localSearch = true;
+    }
+    if (string(argv[i]) == "-w"){
+      w = atoi(argv[i+1]);
+    }
+  }
+  rulesMemoryFunction rules = rankBased<Colony<> >::rulesMemory;
+  if(antHillType == "MMAS"){
+    rules = maxMin<Colony<> >::rulesMemory;
+  }
+  if(antHillType == "ACS"){
+    rules = colonySystem<Colony<> >::rulesMemory;
+    if(numCandidates <= 0){ //the colony system always builds candidate lists
+      numCandidates = ACS_CANDIDATES;
+    }
+  }
+  if(!Colony<>::fitMemory((size_t)memBudget << 20,t.getNumNodes(),m,matrixFree,fused,numCandidates,localSearch,t.getExplicitWeights(),rules,w)){
+    cout << "\nNo colony fits in " << memBudget << "MB\n";
+    return false;
+  }
+  cout << "\nMemory budget " << memBudget << "MB: " << m << " ants, " << (matrixFree ? "matrix-free" : "dense") << (fused ? ", fused" : ", stepwise") << "\n";
+  if(matrixFree && t.getDistances().size() > 0){
+    cout << "Explicit weights keep the distance matrix, so the budget may be exceeded\n";
+  }
+  if(!matrixFree){
+    t.densify();
+  }
+  return true;
+}
+
+//listBatch: Lists the instances of a batch, either every .tsp file in a directory or one path per line of a manifest.
+bool listBatch(string batch, vector<string>& files)
+{
+  DIR* dir = opendir(batch.c_str());
+  if(dir){
+    for(dirent* entry = readdir(dir); entry; entry = readdir(dir)){
+      string name = entry->d_name;
+      if(name.size() > 4 && name.substr(name.size() - 4) == ".tsp"){
+	files.push_back(batch + "/" + name);
+      }
+    }
+    closedir(dir);
+    sort(files.begin(),files.end());
+  }else{
+    ifstream manifest(batch.c_str());
+    if(!manifest){
+      cout << "\nUnable to open batch " << batch << "\n";
+      return false;
+    }
+    string line;
+    while(getline(manifest,line)){
+      if(line != ""){
+	files.push_back(line);
+      }
+    }
+  }
+  return true;
+}
+
+//runBatch: Solves the instances of a batch batchSize at a time, each group in one BatchColony, and writes one record per instance.
+int runBatch(Writer& O, string batch, int batchSize, int m, int maxIter, int maxTime, int maxReps, int argc, char* argv[])
+{
+  vector<string> files;
+  if(!listBatch(batch,files)){
+    return 1;
+  }
+  cout << ">>>>>\n" << flush;//----Checkpoint 3/4/5/6/7
+  bool header = false;
+  for(int first = 0; first < files.size(); first += batchSize){
+    //read the group and lay its matrices one after another
+    thrust::host_vector<float> distances;
+    thrust::host_vector<int> numCities;
+    vector<string> names;
+    for(int f = first; f < files.size() && f < first + batchSize; f++){
+      TSPReader t;
+      if(!t.read((char*)files[f].c_str())){
+	cout << "Skipping " << files[f] << "\n";
+	continue;
+      }
+      thrust::host_vector<float> matrix = t.getDistances();
+      distances.insert(distances.end(),matrix.begin(),matrix.end());
+      numCities.push_back(t.getNumNodes());
+      names.push_back(t.getName());
+    }
+    if(names.size() == 0){
+      continue;
+    }
+    BatchColony colony(distances,numCities,m);
+    colony.configure(argc,argv);
+    colony.setMaxReps(maxReps);
+    colony.initialize();
+    if(!header){
+      O.writeRecordHeader(colony.getBeta(),colony.getRho(),m,"RBAS batch");
+      header = true;
+    }
+    double t1 = Profiler::now();
+    double time = 0;
+    //Every instance runs until maxReps stops it, the group runs until maxIter or maxTime stops them all.
+    for(int i = 0; colony.getNumActive() > 0; i++){
+      colony.forage();
+      time = Profiler::now() - t1;
+      if(maxTime != 0 && time > maxTime){
+	break;
+      }
+      if(maxIter != 0 && i >= maxIter){
+	break;
+      }
+    }
+    thrust::host_vector<float> best = colony.getGlobBestDists();
+    thrust::host_vector<int> iterations = colony.getIterations();
+    for(int b = 0; b < names.size(); b++){
+      O.writeRecord(names[b],numCities[b],best[b],iterations[b],time,colony.getTour(b));
+    }
+  }
+  return 0;
+}
+
+//colonyRun: The options of a run of one colony, gathered so runColony can be built for each storage type.
+struct colonyRun
+{
+  string antHillType; // RBAS, MMAS or ACS, which runVariant picks the rules by.
+  int m;
+  int maxTime;
+  int maxIter;
+  int maxReps;
+  bool fused;
+  string profile;
+  bool asyncLog;
+  int logEvery;
+  bool logImproved;
+  string trace;
+  string checkpoint;
+  double checkpointEvery;
+  string resume;
+  char* warmTour;
+  float warmWeight;
+  string backend; // cpp, omp or tbb in a HOST_BACKENDS build, set by calibrate if it was auto.
+  int threads; // Threads the backend may use, 0 for all.
+  thrust::host_vector<int> candidates; // Candidate lists and greedy length known before the colony is built, so initialize does not recompute them.
+  int numCandidates;
+  float greedyDistance;
+  int convergeEvery; // Iterations between measurements of the branching factor and tour similarity, 0 for none.
+  string stagnation; // What a stagnant colony does: stop, restart or log.
+  float stagnantBranching;
+  float stagnantSimilarity;
+};
+
+//timeForage: Builds the colony of a run under Rules on Backend with the given threads and returns the wall clock seconds of one forage, averaged over up to CALIBRATE_FORAGES forages.
+//The candidate lists and greedy length the colony computes are kept in run, so every later colony is given them.
+template <template <typename> class Rules, typename City, typename Level, typename Backend>
+double timeForage(TSPReader& t, colonyRun& run, int threads, int argc, char* argv[])
+{
+  Backend::setThreads(threads);
+  AntSystem<Rules,City,Level,Backend> antHill(t.getDistances(),t.getXcoords(),t.getYcoords(),t.getNumNodes(),run.m);
+  antHill.configure(argc,argv);
+  antHill.setFused(run.fused);
+  antHill.setExplicitWeights(t.getExplicitWeights());
+  antHill.setCandidates(run.candidates,run.numCandidates);
+  antHill.setGreedyDistance(run.greedyDistance);
+  antHill.initialize();
+  run.candidates = antHill.getCandidates();
+  run.numCandidates = antHill.getNumCandidates();
+  run.greedyDistance = antHill.getGreedyDistance();
+  antHill.forage(); //the first forage also pays for touching the scratch memory
+  int forages = 0;
+  double start = Profiler::now();
+  while(forages < CALIBRATE_FORAGES && Profiler::now() - start < CALIBRATE_SECONDS){
+    antHill.forage();
+    forages++;
+  }
+  return (Profiler::now() - start) / forages;
+}
+
+#ifdef HOST_BACKENDS
+//calibrate: Times forages on every host backend, the threaded ones at every thread count from all the processors down by halves, and sets run to the fastest.
+template <template <typename> class Rules, typename City, typename Level>
+void calibrate(TSPReader& t, colonyRun& run, int argc, char* argv[])
+{
+  double best = -1;
+  const char* backends[] = {"cpp","omp","tbb"};
+  for(int b = 0; b < 3; b++){
+    int threads = b == 0 ? 1 : ompBackend::maxThreads();
+    do{
+      double seconds;
+      if(b == 0){
+	seconds = timeForage<Rules,City,Level,cppBackend>(t,run,threads,argc,argv);
+      }else if(b == 1){
+	seconds = timeForage<Rules,City,Level,ompBackend>(t,run,threads,argc,argv);
+      }else{
+	seconds = timeForage<Rules,City,Level,tbbBackend>(t,run,threads,argc,argv);
+      }
+      cout << "Calibrating " << backends[b] << " on " << threads << (threads == 1 ? " thread: " : " threads: ") << seconds << "s per forage\n";
+      if(best < 0 || seconds < best){
+	best = seconds;
+	run.backend = backends[b];
+	run.threads = threads;
+      }
+      threads /= 2;
+    }while(threads > 1); //one thread of a threaded backend is the serial case, which cpp runs without the overhead
+  }
+  cout << "Running on " << run.backend << " with " << run.threads << (run.threads == 1 ? " thread\n" : " threads\n");
+}
+#endif
+
+//runColony: Builds an AntSystem under Rules storing tours as City and pheromones as Level on the instance in t, then runs it on Backend until a stopping condition is met.
+template <template <typename> class Rules, typename City, typename Level, typename Backend>
+int runColony(TSPReader& t, const colonyRun& run, Writer& O, TraceLog& traceLog, Profiler& profiler, int argc, char* argv[])
+{
+  bool stopping = false;
+  Backend::setThreads(run.threads);
+  AntSystem<Rules,City,Level,Backend> antHill(t.getDistances(),t.getXcoords(),t.getYcoords(),t.getNumNodes(),run.m);
+  //If any parameters need to be changed, they are modified from their defaults here.
+  cout << ">" << flush;//----Checkpoint 4
+  antHill.configure(argc,argv);
+  antHill.setFused(run.fused);
+  if(run.profile != ""){
+    antHill.setProfiler(&profiler);
+  }
+  cout << ">" << flush;//----Checkpoint 5
+  antHill.setExplicitWeights(t.getExplicitWeights());
+  antHill.setCandidates(run.candidates,run.numCandidates);
+  antHill.setGreedyDistance(run.greedyDistance);
+  antHill.initialize();
+  t.updateCache(antHill.getCandidates(),antHill.getNumCandidates(),antHill.getGreedyDistance(),antHill.getInitialTour());
+  int first = 0;
+  double elapsed = 0;
+  if(run.resume != ""){
+    //The run carries on from the saved iteration, with the pheromones, best tour and random numbers it had.
+    colonyState state;
+    if(!Checkpointer::load(run.resume,state) || !antHill.setState(state)){
+      return 1;
+    }
+    first = state.header.loopIteration + 1;
+    elapsed = state.header.elapsed;
+  }
+  if(run.warmTour){
+    //Pheromone is laid on a tour from an earlier solve, which may be of a slightly different instance.
+    thrust::host_vector<int> tour;
+    if(!TSPReader::readTour(run.warmTour,tour)){
+      return 1;
+    }
+    antHill.warmStart(tour,run.warmWeight);
+  }
+  cout << "\n";
+  antHill.printMemory();
+  cout << ">>\n" << flush;//----Checkpoint 6/7
+  if(run.asyncLog){
+    //The main loop only queues its output, which is written from another thread.
+    traceLog.setSampling(run.logEvery,run.logImproved);
+    if(run.trace != "" && !traceLog.setTrace(run.trace)){
+      return 1;
+    }
+    traceLog.start(antHill.getBeta(),antHill.getRho(),antHill.getNumAnts(),run.antHillType,t.getName(),antHill.getLocalSearch(),run.convergeEvery > 0);
+  }else{
+    O.writeHeader(antHill.getBeta(),antHill.getRho(),antHill.getNumAnts(),run.antHillType,t.getName(),antHill.getLocalSearch(),run.convergeEvery > 0);
+  }
+  Checkpointer checkpointer(run.checkpoint);
+  colonyState state;
+  double t1, t2, t3;
+  t2 = t3 = Profiler::now(); //wall clock, since clock() adds up the time of every backend thread
+  t1 = t3 - elapsed; //a resumed run keeps the time it had taken, so maxTime covers the whole run
+  double lastCheckpoint = t3;
+  double branching = -1; //the last convergence metrics, repeated on the iterations between measurements
+  double similarity = -1;
+  int restarts = 0;
+  //Main control sequence.
+  for(int i = first; !stopping; i++){
+    t2 = t3;
+    antHill.forage();
+    if(run.convergeEvery > 0 && i % run.convergeEvery == 0){
+      //A stagnant colony keeps building the same few tours, long before maxReps would notice.
+      branching = antHill.branchingFactor();
+      similarity = antHill.tourSimilarity();
+      if(branching <= run.stagnantBranching || similarity >= run.stagnantSimilarity){
+	if(run.stagnation == "stop"){
+	  stopping = true;
+	}else if(run.stagnation == "restart"){
+	  antHill.restart();
+	  restarts++;
+	}
+      }
+    }
+    t3 = Profiler::now();
+    if(run.maxTime != 0){
+      if(t3 - t1 > run.maxTime){
+	stopping = true;
+      }
+    }
+    if(run.maxIter != 0){
+      if(i >= run.maxIter){
+	stopping = true;
+      }
+    }
+    if(run.maxReps != 0){
+      if(antHill.getReps() >= run.maxReps){
+	stopping = true;
+      }
+    }
+    if(run.asyncLog){
+      traceLog.log(i, antHill.getIterBestDist(), antHill.getGlobBestDist(), t3 - t1, t3 - t2, antHill.getLocalSearch() ? antHill.getLocalSearchTime() : -1, branching, similarity, stopping); //the last iteration is always kept
+    }else{
+      O.write(i, antHill.getIterBestDist(), antHill.getGlobBestDist(), t3 - t1, t3 - t2, antHill.getLocalSearch() ? antHill.getLocalSearchTime() : -1, branching, similarity);
+    }
+    if(run.checkpoint != "" && (stopping || t3 - lastCheckpoint >= run.checkpointEvery)){
+      //Only the copy off the device is paid for here; the file is written by the checkpointer's thread.
+      if(stopping){
+	checkpointer.wait(); //the final state is always saved
+      }
+      if(checkpointer.ready()){ //otherwise try again next iteration, without copying the pheromones for nothing
+	antHill.getState(state);
+	state.header.loopIteration = i;
+	state.header.elapsed = t3 - t1;
+	checkpointer.save(state);
+	lastCheckpoint = t3;
+      }
+    }
+  }
+  checkpointer.wait();
+  traceLog.stop();
+  if(restarts > 0){
+    cout << "Restarted the pheromones " << restarts << (restarts == 1 ? " time\n" : " times\n");
+  }
+  if(run.profile != ""){
+    profiler.write(run.profile);
+  }
+  return 0;
+}
+
+//runBackend: Runs the colony on the backend named in run, after calibrating to pick one if it is auto. Builds without HOST_BACKENDS only have the device backend.
+template <template <typename> class Rules, typename City, typename Level>
+int runBackend(TSPReader& t, colonyRun& run, Writer& O, TraceLog& traceLog, Profiler& profiler, int argc, char* argv[])
+{
+#ifdef HOST_BACKENDS
+  if(run.backend == "auto"){
+    calibrate<Rules,City,Level>(t,run,argc,argv);
+  }
+  if(run.backend == "cpp"){
+    return runColony<Rules,City,Level,cppBackend>(t,run,O,traceLog,profiler,argc,argv);
+  }
+  if(run.backend == "omp"){
+    return runColony<Rules,City,Level,ompBackend>(t,run,O,traceLog,profiler,argc,argv);
+  }
+  if(run.backend == "tbb"){
+    return runColony<Rules,City,Level,tbbBackend>(t,run,O,traceLog,profiler,argc,argv);
+  }
+#endif
+  return runColony<Rules,City,Level,deviceBackend>(t,run,O,traceLog,profiler,argc,argv);
+}
+
+//runVariant: Runs the colony under the rules of the variant named in run. Each variant is its own AntSystem, so the choice is made once here and never in the main loop.
+template <typename City, typename Level>
+int runVariant(TSPReader& t, colonyRun& run, Writer& O, TraceLog& traceLog, Profiler& profiler, int argc, char* argv[])
+{
+  if(run.antHillType == "MMAS"){
+    return runBackend<maxMin,City,Level>(t,run,O,traceLog,profiler,argc,argv);
+  }
+  if(run.antHillType == "ACS"){
+    return runBackend<colonySystem,City,Level>(t,run,O,traceLog,profiler,argc,argv);
+  }
+  return runBackend<rankBased,City,Level>(t,run,O,traceLog,profiler,argc,argv);
+}
+
 //Setup: The main control loop to the whole program.
 int main(int argc, char* argv[]){
   //declare variables
   cout << "|SETUP|\n";
   string antHillType = "RBAS";
+  string aco = ""; //variant of a single colony, rbas, mmas or acs
   int m = -1;
   int ranks = 6;
   int maxTime = 0;
@@ -30,8 +423,46 @@ int main(int argc, char* argv[]){
   int reps = 0;
   bool stopping = false;
   bool graphics = false;
+  string guiShm = "excellants"; //shared memory the GUI reads, under /dev/shm
+  double guiRate = 20; //most snapshots the GUI is given each second
+  bool matrixFree = false;
+  bool cache = false;
+  int initialTour = TOUR_NEAREST; // Read here as well as by configure, since the cached greedy length is only used for the same kind of tour.
+  bool fused = false;
+  int memBudget = 0;
+  string profile = "";
+  Profiler profiler; //only attached if -profile is given
+  int islands = 1;
+  int migrate = 10;
+  bool ring = true;
+  bool processes = false;
+  string daemon = "";
+  string submit = "";
+  string job = "";
+  int pooled = 8;
+  string batch = "";
+  int batchSize = 64;
   char* filen;
   Writer O; //writes output to stdout and an optional file
+  TraceLog traceLog(O); //writes O's per-iteration output from its own thread, if asyncLog is set
+  bool asyncLog = false;
+  int logEvery = 1;
+  bool logImproved = false;
+  string trace = "";
+  string convertTrace = "";
+  string checkpoint = ""; //file the colony state is saved to as it runs
+  double checkpointEvery = 60;
+  string resume = "";
+  char* warmTour = NULL;
+  float warmWeight = 4;
+  bool compact = false; //pheromones and probabilities in 16 bits
+  bool wideCities = false; //tours in int even if unsigned short would hold them
+  string backend = ""; //host backend of a HOST_BACKENDS build, or auto to time them all
+  int threads = 0;
+  int convergeEvery = 0;
+  string stagnation = "restart";
+  float stagnantBranching = STAGNANT_BRANCHING;
+  float stagnantSimilarity = STAGNANT_SIMILARITY;
   //Read initially neccesary command-line arguments.
   for(int i = 0; i < argc;i++){
     if (string(argv[i]) == "-ras"){
@@ -42,12 +473,123 @@ int main(int argc, char* argv[]){
 	}
       }
     }
+    if (string(argv[i]) == "-aco"){
+      aco = argv[i+1];
+    }
     if (string(argv[i]) == "-tsp"){
       filen = argv[i+1];
     }
     if (string(argv[i]) == "-gui"){
       graphics = true;
     }
+    if (string(argv[i]) == "-guiShm"){
+      guiShm = argv[i+1];
+    }
+    if (string(argv[i]) == "-guiRate"){
+      guiRate = atof(argv[i+1]);
+    }
+    if (string(argv[i]) == "-matrixFree"){
+      matrixFree = true;
+    }
+    if (string(argv[i]) == "-cache"){
+      cache = true;
+    }
+    if (string(argv[i]) == "-initTour"){
+      initialTour = string(argv[i+1]) == "curve" ? TOUR_CURVE : TOUR_NEAREST;
+    }
+    if (string(argv[i]) == "-fused"){
+      fused = true;
+    }
+    if (string(argv[i]) == "-profile"){
+      profile = argv[i+1];
+    }
+    if (string(argv[i]) == "-asyncLog"){
+      asyncLog = true;
+    }
+    if (string(argv[i]) == "-logEvery"){
+      asyncLog = true;
+      logEvery = atoi(argv[i+1]);
+    }
+    if (string(argv[i]) == "-logImproved"){
+      asyncLog = true;
+      logImproved = true;
+    }
+    if (string(argv[i]) == "-trace"){
+      asyncLog = true;
+      trace = argv[i+1];
+    }
+    if (string(argv[i]) == "-convertTrace"){
+      convertTrace = argv[i+1];
+    }
+    if (string(argv[i]) == "-checkpoint"){
+      checkpoint = argv[i+1];
+    }
+    if (string(argv[i]) == "-checkpointEvery"){
+      checkpointEvery = atof(argv[i+1]);
+    }
+    if (string(argv[i]) == "-resume"){
+      resume = argv[i+1];
+    }
+    if (string(argv[i]) == "-warmStart"){
+      warmTour = argv[i+1];
+    }
+    if (string(argv[i]) == "-warmWeight"){
+      warmWeight = atof(argv[i+1]);
+    }
+    if (string(argv[i]) == "-compact"){
+      compact = true;
+    }
+    if (string(argv[i]) == "-wideCities"){
+      wideCities = true;
+    }
+    if (string(argv[i]) == "-backend"){
+      backend = argv[i+1];
+    }
+    if (string(argv[i]) == "-threads"){
+      threads = atoi(argv[i+1]);
+    }
+    if (string(argv[i]) == "-convergeEvery"){
+      convergeEvery = atoi(argv[i+1]);
+    }
+    if (string(argv[i]) == "-stagnation"){
+      stagnation = argv[i+1];
+    }
+    if (string(argv[i]) == "-stagnantBranching"){
+      stagnantBranching = atof(argv[i+1]);
+    }
+    if (string(argv[i]) == "-stagnantSimilarity"){
+      stagnantSimilarity = atof(argv[i+1]);
+    }
+    if (string(argv[i]) == "-memBudget"){
+      memBudget = atoi(argv[i+1]);
+    }
+    if (string(argv[i]) == "-islands"){
+      islands = atoi(argv[i+1]);
+    }
+    if (string(argv[i]) == "-migrate"){
+      migrate = atoi(argv[i+1]);
+    }
+    if (string(argv[i]) == "-broadcast"){
+      ring = false;
+    }
+    if (string(argv[i]) == "-processes"){
+      processes = true;
+    }
+    if (string(argv[i]) == "-daemon"){
+      daemon = argv[i+1];
+    }
+    if (string(argv[i]) == "-pool"){
+      pooled = atoi(argv[i+1]);
+    }
+    if (string(argv[i]) == "-submit"){
+      submit = argv[i+1];
+    }
+    if (string(argv[i]) == "-batch"){
+      batch = argv[i+1];
+    }
+    if (string(argv[i]) == "-batchSize"){
+      batchSize = atoi(argv[i+1]);
+    }
     if (string(argv[i]) == "-m"){
       m = atoi(argv[i+1]);
     }
@@ -67,144 +609,134 @@ int main(int argc, char* argv[]){
     }
   }
   cout << ">" << flush; //----Checkpoint 1
-  if(graphics){
-    //If graphics are running, create pipes and processes.
-    int parentPipe[] = {-1,-1};  // parent -> child 
-    int childPipe[] = {-1,-1};  // child -> parent 
-    if ( pipe(parentPipe) < 0  ||  pipe(childPipe) < 0 )
-      {
-	std::cout << "Failed to create pipe";
-	return 1;
-      }
-#define	PARENT_READ   childPipe[0]
-#define	CHILD_WRITE   childPipe[1]
-#define CHILD_READ    parentPipe[0]
-#define PARENT_WRITE  parentPipe[1]
-    pid_t pID = fork();
-    if(pID == 0){//child
-      close(PARENT_WRITE);
-      close(PARENT_READ);
-      //Graphics run in a separate process from the computations so neither is slowed down.
-      Comm C(CHILD_READ,CHILD_WRITE);
-      cout << ">" << flush; //----Checkpoint 3
-      if(!C.send(string("Test"))){
-	    cout << "\n Interprocess Comm Failed";
-	    return 1;
-      }
-      ofstream outfile("GUIFile", ios_base::out);
-      outfile.close();
-      if(!outfile){
-        cout << "\n" << "Unable to open GUIFile\n";
-        return 1;
-      }
-      string GUIInfo = "";
-      while(GUIInfo != "TERM"){
-	    GUIInfo = C.recieve();
-        if(GUIInfo != ""){
-          ofstream outfile("GUIFile", ios_base::out);
-          for(int i = 0; !outfile && i < 10; i++){ //try to open GUIFile 10 more times, then give up.
-            ofstream outfile("GUIFile", ios_base::out);
-          }
-          outfile << GUIInfo;
-          outfile.close();
-        }
-      }
-      return 0;
-    }else if(pID < 0){//fail
-      cout << "Failed to fork";
+  if(convertTrace != ""){
+    //Rewrites a binary trace in the usual layout, to stdout and -out.
+    cout << "\n";
+    return TraceLog::convert(convertTrace,O) ? 0 : 1;
+  }
+  if(daemon != ""){
+    //Jobs arrive over a local socket and run on pooled colonies, so they skip process startup and allocation.
+    SolverDaemon solver(daemon,pooled);
+    if(!solver.start()){
       return 1;
-    }else{//parent
-      close(CHILD_READ);
-      close(CHILD_WRITE);
-      //Computations run in a separate process from the graphics so neither is slowed down.
-      Comm C(PARENT_READ,PARENT_WRITE);
-      cout << ">" << flush;//----Checkpoint 2
-      TSPReader t;
-      t.read(filen);
-      cout << ">" << flush;//----Checkpoint 4
-      if(m == -1){
-	    m = t.getNumNodes();
-      }
-      RankBasedAntSystem antHill(t.getDistances(),t.getNumNodes(),m);
-      cout << ">" << flush;//----Checkpoint 5
-      //If any parameters need to be changed, they are modified from their defaults here.
-      for(int i = 0; i < argc;i++){
-	if (string(argv[i]) == "-b"){
-	  antHill.setBeta(atof(argv[i+1]));
-	}
-	if (string(argv[i]) == "-r"){
-	  antHill.setRho(atof(argv[i+1]));
-	}
-      }
-      cout << ">" << flush;//----Checkpoint 6
-      antHill.initialize();
-      if(C.recieve() == "Test"){ //A check to find out if the comm is working.
-	    cout << ">\n" << flush;//----Checkpoint 7
+    }
+    cout << "\n" << flush;
+    solver.serve();
+    return 0;
+  }
+  if(submit != ""){
+    //Every other option is passed on to the daemon as the job.
+    for(int i = 1; i < argc; i++){
+      if(string(argv[i]) == "-submit"){
+	i++;
       }else{
-	    cout << "\n Interprocess Comm Failed";
-	    return 1;
-      }
-      O.writeHeader(antHill.getBeta(),antHill.getRho(),antHill.getNumAnts(),antHillType,t.getName());
-      clock_t t1, t2, t3;
-      t1 = t2 = t3 = clock();
-      //Main control sequence.
-      for(int i = 0; !stopping; i++){
-	    t2 = t3;
-	    antHill.forage();
-	    t3 = clock();
-	    O.write(i, antHill.getIterBestDist(), antHill.getGlobBestDist(), (double)(t3 - t1) / CLOCKS_PER_SEC, (double)(t3 - t2) / CLOCKS_PER_SEC);
-        C.send(string(filen) + ":" + t.getName() + ":" + antHill.getTour() + ":" + Comm::floatToString(antHill.getIterBestDist()) + ":" + Comm::floatToString(antHill.getGlobBestDist()) + ":" + Comm::intToString(i));
-	if(maxTime != 0){
-	  if((int)((double)(t3 - t1) / CLOCKS_PER_SEC)> maxTime){
-	    stopping = true;
-	  }
-	}
-	if(maxIter != 0){
-	  if(i >= maxIter){
-	    stopping = true;
-	  }
-	}
-	if(maxReps != 0){
-	  if(antHill.getReps() >= maxReps){
-	    stopping = true;
-	  }
-	}
+	job += string(argv[i]) + " ";
       }
-      C.send("TERM");
     }
-  }else{
+    string result;
+    if(!SolverDaemon::submit(submit,job,result)){
+      cout << "\nUnable to reach daemon at " << submit << "\n";
+      return 1;
+    }
+    cout << "\n" << result << "\n";
+    return result.substr(0,6) == "ERROR:";
+  }
+  if(batch != ""){
+    //Many small instances are solved together, one record each.
+    if(graphics){
+      cout << "\nBatches run without graphics\n";
+    }
+    cout << ">" << flush;//----Checkpoint 2
+    return runBatch(O,batch,batchSize > 0 ? batchSize : 1,m,maxIter,maxTime,maxReps,argc,argv);
+  }
+  if(graphics && islands > 1){
+    cout << "\nIslands run without graphics\n";
+    graphics = false;
+  }
+#ifdef HOST_BACKENDS
+  if(backend == ""){
+    backend = "auto";
+  }
+  if(backend != "auto" && backend != "cpp" && backend != "omp" && backend != "tbb"){
+    cout << "\nUnknown backend " << backend << ", use auto, cpp, omp or tbb\n";
+    return 1;
+  }
+#else
+  if(backend != ""){
+    cout << "\nThis build only runs on its own backend, build with make Host to choose one\n";
+  }
+#endif
+  if(aco != "" && aco != "rbas" && aco != "mmas" && aco != "acs"){
+    cout << "\nUnknown variant " << aco << ", use rbas, mmas or acs\n";
+    return 1;
+  }
+  if((graphics || islands > 1) && aco != "" && aco != "rbas"){
+    cout << "\nIslands and graphics only run the rank-based variant\n";
+  }else if(aco == "mmas"){
+    antHillType = "MMAS";
+  }else if(aco == "acs"){
+    antHillType = "ACS";
+  }
+  if(stagnation != "stop" && stagnation != "restart" && stagnation != "log"){
+    cout << "\nUnknown stagnation action " << stagnation << ", use stop, restart or log\n";
+    return 1;
+  }
+  if((graphics || islands > 1) && convergeEvery > 0){
+    cout << "\nConvergence is only measured in a single colony without graphics\n";
+  }
+  if((graphics || islands > 1) && (checkpoint != "" || resume != "" || warmTour)){
+    cout << "\nCheckpoints and warm starts are only taken by a single colony without graphics\n";
+  }
+  if(graphics){
+    //The best tour is shared with Display.py through shared memory, which it reads whenever it redraws.
     cout << ">" << flush;//----Checkpoint 2
     TSPReader t;
-    t.read(filen);
+    t.setCache(cache);
+    if(!t.read(filen,!matrixFree && memBudget == 0)){
+      return 1;
+    }
     cout << ">" << flush;//----Checkpoint 3
     if(m == -1){
       m = t.getNumNodes();
     }
-    RankBasedAntSystem antHill(t.getDistances(),t.getNumNodes(),m);
-    //If any parameters need to be changed, they are modified from their defaults here.
+    if(memBudget > 0 && !fitBudget(t,memBudget,antHillType,m,matrixFree,fused,argc,argv)){
+      return 1;
+    }
+    TourSnapshot snapshot;
+    snapshot.setRate(guiRate);
+    if(!snapshot.open(guiShm,t.getNumNodes(),filen,t.getName())){
+      return 1;
+    }
+    RankBasedAntSystem<> antHill(t.getDistances(),t.getXcoords(),t.getYcoords(),t.getNumNodes(),m);
     cout << ">" << flush;//----Checkpoint 4
-    for(int i = 0; i < argc;i++){
-      if (string(argv[i]) == "-b"){
-	antHill.setBeta(atof(argv[i+1]));
-      }
-      if (string(argv[i]) == "-r"){
-	antHill.setRho(atof(argv[i+1]));
-      }
+    //If any parameters need to be changed, they are modified from their defaults here.
+    antHill.configure(argc,argv);
+    antHill.setFused(fused);
+    if(profile != ""){
+      antHill.setProfiler(&profiler);
     }
     cout << ">" << flush;//----Checkpoint 5
+    antHill.setExplicitWeights(t.getExplicitWeights());
+    antHill.setCandidates(t.getCandidates(),t.getNumCandidates());
+    antHill.setGreedyDistance(t.getGreedyDistance(antHill.getInitialTour()));
     antHill.initialize();
+    t.updateCache(antHill.getCandidates(),antHill.getNumCandidates(),antHill.getGreedyDistance(),antHill.getInitialTour());
+    antHill.printMemory();
     cout << ">>\n" << flush;//----Checkpoint 6/7
-    O.writeHeader(antHill.getBeta(),antHill.getRho(),antHill.getNumAnts(),antHillType,t.getName());
-    clock_t t1, t2, t3;
-    t1 = t2 = t3 = clock();
+    cout << "Sharing tours on " << snapshot.getName() << "\n";
+    O.writeHeader(antHill.getBeta(),antHill.getRho(),antHill.getNumAnts(),antHillType,t.getName(),antHill.getLocalSearch());
+    double t1, t2, t3;
+    t1 = t2 = t3 = Profiler::now(); //wall clock, since clock() adds up the time of every backend thread
+    thrust::host_vector<int> shownTour; //the tour last copied from the colony, only copied again when the global best changes
+    double shownBest = -1;
     //Main control sequence.
     for(int i = 0; !stopping; i++){
       t2 = t3;
       antHill.forage();
-      t3 = clock();
-      O.write(i, antHill.getIterBestDist(), antHill.getGlobBestDist(), (double)(t3 - t1) / CLOCKS_PER_SEC, (double)(t3 - t2) / CLOCKS_PER_SEC);
+      t3 = Profiler::now();
+      O.write(i, antHill.getIterBestDist(), antHill.getGlobBestDist(), t3 - t1, t3 - t2, antHill.getLocalSearch() ? antHill.getLocalSearchTime() : -1);
       if(maxTime != 0){
-	if((double)(t3 - t1) / CLOCKS_PER_SEC > maxTime){
+	if((int)(t3 - t1) > maxTime){
 	  stopping = true;
 	}
       }
@@ -218,7 +750,78 @@ int main(int argc, char* argv[]){
 	  stopping = true;
 	}
       }
+      if(stopping || snapshot.due(t3 - t1)){
+	if(antHill.getGlobBestDist() != shownBest){
+	  shownTour = antHill.getGlobBestTour();
+	  shownBest = antHill.getGlobBestDist();
+	}
+	snapshot.publish(i, antHill.getIterBestDist(), antHill.getGlobBestDist(), t3 - t1, shownTour);
+      }
+    }
+    snapshot.finish();
+    if(profile != ""){
+      profiler.write(profile);
+    }
+  }else{
+    cout << ">" << flush;//----Checkpoint 2
+    TSPReader t;
+    t.setCache(cache);
+    if(!t.read(filen,!matrixFree && memBudget == 0)){
+      return 1;
+    }
+    cout << ">" << flush;//----Checkpoint 3
+    if(m == -1){
+      m = t.getNumNodes();
+    }
+    if(memBudget > 0 && !fitBudget(t,memBudget,antHillType,m,matrixFree,fused,argc,argv)){
+      return 1;
+    }
+    if(islands > 1){
+      //Several colonies run side by side and trade their best tours.
+      Archipelago archipelago(t,islands,m,argc,argv);
+      archipelago.setMigration(migrate,ring);
+      if(processes){
+	cout << ">>>\n" << flush;//----Checkpoint 4/5/6/7
+	archipelago.runProcesses(O,antHillType + " x" + Comm::intToString(islands),maxIter,maxTime,maxReps);
+      }else{
+	archipelago.initialize();
+	cout << ">>>\n" << flush;//----Checkpoint 4/5/6/7
+	archipelago.runThreads(O,antHillType + " x" + Comm::intToString(islands),maxIter,maxTime,maxReps);
+      }
+      return 0;
+    }
+    //Tours and candidate lists are kept in the narrowest type that holds every city, and pheromones and probabilities in 16 bits if asked for.
+    colonyRun run;
+    run.antHillType = antHillType;
+    run.m = m;
+    run.maxTime = maxTime;
+    run.maxIter = maxIter;
+    run.maxReps = maxReps;
+    run.fused = fused;
+    run.profile = profile;
+    run.asyncLog = asyncLog;
+    run.logEvery = logEvery;
+    run.logImproved = logImproved;
+    run.trace = trace;
+    run.checkpoint = checkpoint;
+    run.checkpointEvery = checkpointEvery;
+    run.resume = resume;
+    run.warmTour = warmTour;
+    run.warmWeight = warmWeight;
+    run.backend = backend;
+    run.threads = threads;
+    run.candidates = t.getCandidates();
+    run.numCandidates = t.getNumCandidates();
+    run.greedyDistance = t.getGreedyDistance(initialTour);
+    run.convergeEvery = convergeEvery;
+    run.stagnation = stagnation;
+    run.stagnantBranching = stagnantBranching;
+    run.stagnantSimilarity = stagnantSimilarity;
+    bool shortCities = t.getNumNodes() <= CITY_SHORT_MAX && !wideCities;
+    if(compact){
+      return shortCities ? runVariant<unsigned short,compactFloat>(t,run,O,traceLog,profiler,argc,argv) : runVariant<int,compactFloat>(t,run,O,traceLog,profiler,argc,argv);
     }
+    return shortCities ? runVariant<unsigned short,float>(t,run,O,traceLog,profiler,argc,argv) : runVariant<int,float>(t,run,O,traceLog,profiler,argc,argv);
   }		
 }
 
@@ -0,0 +1,403 @@
+/****************************************
+ * SolverDaemon.cu                      *
+ * Peter Ahrens                         *
+ * Serves jobs over a local socket      *
+ ****************************************/
+
+#include "SolverDaemon.h"
+
+//Constructor: Sets defaults. Nothing is opened until start.
+SolverDaemon::SolverDaemon(std::string newSocketPath, int newMaxPooled)
+{
+  socketPath = newSocketPath;
+  maxPooled = newMaxPooled;
+  listener = -1;
+}
+
+//Destructor: Closes and removes the socket and frees the pooled colonies.
+SolverDaemon::~SolverDaemon()
+{
+  if(listener >= 0){
+    close(listener);
+    unlink(socketPath.c_str());
+  }
+  for(std::map<std::string, pooledColony*>::iterator it = pool.begin(); it != pool.end(); it++){
+    delete it->second->colony;
+    delete it->second;
+  }
+  for(std::map<std::string, pooledColony*>::iterator it = sessions.begin(); it != sessions.end(); it++){
+    delete it->second->colony;
+    delete it->second;
+  }
+}
+
+//start: Binds and listens on the socket, replacing a stale one left by an earlier daemon. Returns false if it cannot.
+bool SolverDaemon::start()
+{
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if(socketPath.size() >= sizeof(address.sun_path)){
+    cout << "Socket path too long\n";
+    return false;
+  }
+  strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(listener < 0){
+    cout << "Failed to create socket\n";
+    return false;
+  }
+  unlink(socketPath.c_str());
+  if(bind(listener, (sockaddr*)&address, sizeof(address)) < 0 || listen(listener, 16) < 0){
+    cout << "Unable to listen on " << socketPath << "\n";
+    close(listener);
+    listener = -1;
+    return false;
+  }
+  return true;
+}
+
+//serve: Answers jobs one at a time, each on its own connection, until a "STOP" job arrives. Jobs starting with EDIT or DROP go to the kept colonies.
+//A connection that sends nothing for DAEMON_RECV_TIMEOUT seconds is closed unanswered, and a job that throws is answered with "ERROR:" and the exception.
+void SolverDaemon::serve()
+{
+  signal(SIGPIPE, SIG_IGN); //a client that has gone makes send fail instead of ending the daemon
+  cout << "Listening on " << socketPath << "\n" << flush;
+  while(true){
+    int connection = accept(listener, NULL, NULL);
+    if(connection < 0){
+      continue;
+    }
+    timeval timeout;
+    timeout.tv_sec = DAEMON_RECV_TIMEOUT;
+    timeout.tv_usec = 0;
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)); //a client that never sends its job cannot hold up the ones behind it
+    Comm C(connection, connection);
+    C.setTolerant(true); //a timed out or broken connection is dropped, not the daemon
+    std::string job = C.recieve();
+    if(job == "STOP"){
+      C.send("STOPPED");
+      close(connection);
+      break;
+    }
+    if(job != ""){
+      cout << "Job: " << job << "\n" << flush;
+      std::string answer;
+      try{
+	if(job.compare(0, 5, "EDIT ") == 0){
+	  answer = edit(job);
+	}else if(job.compare(0, 5, "DROP ") == 0){
+	  answer = drop(job);
+	}else{
+	  answer = solve(job);
+	}
+      }catch(std::exception& e){ //thrust reports device errors by throwing, which would otherwise end the daemon
+	answer = std::string("ERROR:") + e.what();
+      }
+      C.send(answer);
+    }
+    close(connection);
+  }
+}
+
+//submit: Sends a job to a running daemon and waits for its answer. Returns false if the daemon cannot be reached.
+bool SolverDaemon::submit(std::string socketPath, std::string job, std::string& result)
+{
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+  int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(connection < 0 || connect(connection, (sockaddr*)&address, sizeof(address)) < 0){
+    if(connection >= 0){
+      close(connection);
+    }
+    return false;
+  }
+  Comm C(connection, connection);
+  bool sent = C.send(job);
+  result = sent ? C.recieve() : "";
+  close(connection);
+  return result != "";
+}
+
+//solve: Runs one job on a pooled colony and returns its answer. A job must give -tsp and at least one of -maxIter, -maxTime and -maxReps, and may give any option configure takes.
+//With -session, the colony is kept under that name instead of going back to the pool. A later job of a kept session needs no -tsp, and carries on foraging from where the colony is, with the options it was configured with.
+std::string SolverDaemon::solve(std::string job)
+{
+  //split the job into arguments, with a spare empty one so an option missing its value reads ""
+  std::vector<std::string> args;
+  std::istringstream words(job);
+  for(std::string word; words >> word;){
+    args.push_back(word);
+  }
+  args.push_back("");
+  std::vector<char*> argv(args.size());
+  for(int i = 0; i < args.size(); i++){
+    argv[i] = &args[i][0];
+  }
+  int argc = args.size() - 1;
+  std::string filen = "";
+  int m = -1;
+  int maxIter = 0;
+  int maxTime = 0;
+  int maxReps = 0;
+  bool matrixFree = false;
+  bool cache = false;
+  std::string session = "";
+  for(int i = 0; i < argc; i++){
+    if (args[i] == "-tsp"){
+      filen = args[i+1];
+    }
+    if (args[i] == "-m"){
+      m = atoi(argv[i+1]);
+    }
+    if (args[i] == "-maxIter"){
+      maxIter = atoi(argv[i+1]);
+    }
+    if (args[i] == "-maxTime"){
+      maxTime = atoi(argv[i+1]);
+    }
+    if (args[i] == "-maxReps"){
+      maxReps = atoi(argv[i+1]);
+    }
+    if (args[i] == "-matrixFree"){
+      matrixFree = true;
+    }
+    if (args[i] == "-cache"){
+      cache = true;
+    }
+    if (args[i] == "-session"){
+      session = args[i+1];
+    }
+  }
+  std::map<std::string, pooledColony*>::iterator kept = sessions.find(session);
+  bool hot = session != "" && kept != sessions.end();
+  if(filen == "" && !hot){
+    return "ERROR:no -tsp given";
+  }
+  if(maxIter == 0 && maxTime == 0 && maxReps == 0){
+    return "ERROR:no -maxIter, -maxTime or -maxReps given";
+  }
+  TSPReader t;
+  pooledColony* pooled;
+  std::string sizeClass;
+  if(hot){
+    pooled = kept->second;
+  }else{
+    t.setCache(cache);
+    if(!t.read(&filen[0], !matrixFree)){
+      return "ERROR:unable to read " + filen;
+    }
+    if(m == -1){
+      m = t.getNumNodes();
+    }
+    sizeClass = sizeClassOf(t.getNumNodes(), m, !matrixFree);
+    pooled = acquire(t, m, !matrixFree);
+  }
+  RankBasedAntSystem<>& antHill = *pooled->colony;
+  std::string result;
+  try{
+    if(!hot){
+      antHill.configure(argc, &argv[0]);
+      antHill.setExplicitWeights(t.getExplicitWeights());
+      antHill.setCandidates(t.getCandidates(), t.getNumCandidates());
+      antHill.setGreedyDistance(t.getGreedyDistance(antHill.getInitialTour()));
+      antHill.initialize();
+      t.updateCache(antHill.getCandidates(), antHill.getNumCandidates(), antHill.getGreedyDistance(), antHill.getInitialTour());
+    }
+    //Main control sequence.
+    double t1 = now();
+    double time = 0;
+    int i = 0;
+    for(bool stopping = false; !stopping; i++){
+      antHill.forage();
+      time = now() - t1;
+      if(maxTime != 0 && time > maxTime){
+	stopping = true;
+      }
+      if(maxIter != 0 && i >= maxIter){
+	stopping = true;
+      }
+      if(maxReps != 0 && antHill.getReps() >= maxReps){
+	stopping = true;
+      }
+    }
+    result = Comm::floatToString(antHill.getGlobBestDist()) + ":" + Comm::intToString(i) + ":" + Comm::floatToString(time) + ":" + antHill.getTour();
+  }catch(...){ //a colony left halfway through a job is not trusted with another one
+    if(hot){
+      sessions.erase(kept);
+    }
+    delete pooled->colony;
+    delete pooled;
+    throw;
+  }
+  if(session != ""){
+    sessions[session] = pooled;
+  }else{
+    release(sizeClass, pooled);
+  }
+  return result;
+}
+
+//edit: Applies "EDIT name ..." to the colony kept by session name, where ... is any number of "insert x y", "remove city" and "move city x y", applied in order.
+//A removed city's index goes to the last city, and an inserted one takes the next index. Every edit is checked against the cities the edits before it leave before any is applied, so a job is applied whole or not at all.
+//Answers "numCities:globBest", with the global best tour already repaired, or "ERROR:reason". An edit that fails or throws once the job is being applied drops the session, since it is then only partly edited.
+std::string SolverDaemon::edit(std::string job)
+{
+  std::istringstream words(job);
+  std::string command;
+  std::string session;
+  words >> command >> session;
+  std::map<std::string, pooledColony*>::iterator kept = sessions.find(session);
+  if(kept == sessions.end()){
+    return "ERROR:no session " + session;
+  }
+  RankBasedAntSystem<>& antHill = *kept->second->colony;
+  if(antHill.getExplicitWeights()){
+    return "ERROR:session " + session + " has explicit edge weights, which edits cannot follow";
+  }
+  //check the whole job first
+  std::vector<cityEdit> edits;
+  int numCities = antHill.getNumCities();
+  for(cityEdit change; words >> change.change;){
+    change.city = -1;
+    if(change.change == "insert"){
+      if(!(words >> change.x >> change.y)){
+	return "ERROR:insert needs x y";
+      }
+      if(numCities >= antHill.getMaxCities()){
+	return "ERROR:more than " + Comm::intToString(antHill.getMaxCities()) + " cities";
+      }
+      numCities++;
+    }else if(change.change == "remove"){
+      if(!(words >> change.city)){
+	return "ERROR:remove needs a city";
+      }
+      if(change.city < 0 || change.city >= numCities){
+	return "ERROR:no city " + Comm::intToString(change.city);
+      }
+      if(numCities - 1 < antHill.getMinCities()){
+	return "ERROR:fewer than " + Comm::intToString(antHill.getMinCities()) + " cities";
+      }
+      numCities--;
+    }else if(change.change == "move"){
+      if(!(words >> change.city >> change.x >> change.y)){
+	return "ERROR:move needs a city, x and y";
+      }
+      if(change.city < 0 || change.city >= numCities){
+	return "ERROR:no city " + Comm::intToString(change.city);
+      }
+    }else{
+      return "ERROR:unknown edit " + change.change;
+    }
+    edits.push_back(change);
+  }
+  //then apply it, rebuilding the buffers sized by the number of cities once at the end
+  bool applied = true;
+  try{
+    for(int e = 0; e < edits.size() && applied; e++){
+      if(edits[e].change == "insert"){
+	applied = antHill.insertCity(edits[e].x, edits[e].y) >= 0;
+      }else if(edits[e].change == "remove"){
+	applied = antHill.removeCity(edits[e].city);
+      }else{
+	applied = antHill.moveCity(edits[e].city, edits[e].x, edits[e].y);
+      }
+    }
+    if(applied){
+      antHill.finishEdits();
+    }
+  }catch(...){ //the cities may be half relabelled, so the session is dropped
+    endSession(kept);
+    throw;
+  }
+  if(!applied){
+    endSession(kept);
+    return "ERROR:an edit failed partway through, so session " + session + " was dropped";
+  }
+  return Comm::intToString(antHill.getNumCities()) + ":" + Comm::floatToString(antHill.getGlobBestDist());
+}
+
+//drop: Frees the colony kept by the session name in "DROP name". Its matrix may have been edited to another size, so it does not go back to the pool.
+std::string SolverDaemon::drop(std::string job)
+{
+  std::string session = job.substr(5);
+  session.erase(session.find_last_not_of(" ") + 1);
+  std::map<std::string, pooledColony*>::iterator kept = sessions.find(session);
+  if(kept == sessions.end()){
+    return "ERROR:no session " + session;
+  }
+  endSession(kept);
+  return "DROPPED";
+}
+
+//endSession: Frees the colony kept by a session and forgets the session.
+void SolverDaemon::endSession(std::map<std::string, pooledColony*>::iterator kept)
+{
+  delete kept->second->colony;
+  delete kept->second;
+  sessions.erase(kept);
+}
+
+//acquire: Takes the pooled colony of this size class out of the pool, copies the instance into its matrix and resets it. If there is none, a new one is built.
+pooledColony* SolverDaemon::acquire(TSPReader& t, int numAnts, bool dense)
+{
+  std::string sizeClass = sizeClassOf(t.getNumNodes(), numAnts, dense);
+  std::map<std::string, pooledColony*>::iterator found = pool.find(sizeClass);
+  if(found != pool.end()){
+    pooledColony* pooled = found->second;
+    pool.erase(found);
+    recent.remove(sizeClass);
+    if(dense){
+      thrust::copy(t.getDistances().begin(), t.getDistances().end(), pooled->distances.begin());
+    }
+    pooled->colony->reset(t.getXcoords(), t.getYcoords());
+    return pooled;
+  }
+  pooledColony* pooled = new pooledColony;
+  if(dense){
+    pooled->distances = t.getDistances();
+  }
+  pooled->colony = new RankBasedAntSystem<>(pooled->distances, t.getXcoords(), t.getYcoords(), t.getNumNodes(), numAnts);
+  return pooled;
+}
+
+//release: Returns a colony to the pool, dropping the least recently used ones while the pool is over maxPooled.
+void SolverDaemon::release(std::string sizeClass, pooledColony* pooled)
+{
+  pool[sizeClass] = pooled;
+  recent.push_back(sizeClass);
+  while((int)pool.size() > maxPooled){
+    std::string oldest = recent.front();
+    recent.pop_front();
+    delete pool[oldest]->colony;
+    delete pool[oldest];
+    pool.erase(oldest);
+  }
+}
+
+//sizeClassOf: Names the size class of a colony. Colonies only share a class if every buffer has the same size.
+std::string SolverDaemon::sizeClassOf(int numCities, int numAnts, bool dense)
+{
+  return Comm::intToString(numCities) + "x" + Comm::intToString(numAnts) + (dense ? "" : "f");
+}
+
+//now: Returns the wall clock time in seconds.
+double SolverDaemon::now()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
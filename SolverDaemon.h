@@ -0,0 +1,81 @@
+/****************************************
+ * SolverDaemon.h                       *
+ * Peter Ahrens                         *
+ * Serves jobs over a local socket      *
+ ****************************************/
+
+#ifndef SOLVERDAEMON_H
+#define SOLVERDAEMON_H
+#include "RankBasedAntSystem.h"
+#include "TSPReader.h"
+#include "Comm.h"
+#include <map>
+#include <list>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <exception>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+
+//Daemon Values
+#define DAEMON_RECV_TIMEOUT 10 // Seconds a connection may take to send its job before the daemon gives up on it.
+
+//pooledColony: A colony kept between jobs with the matrix it reads, which a new instance of the same size is copied into.
+struct pooledColony
+{
+  thrust::device_vector<float> distances; // Empty for a matrix-free colony.
+  RankBasedAntSystem<>* colony;
+};
+
+//cityEdit: One edit of an EDIT job, "insert", "remove" or "move", read and checked before any edit of the job is applied.
+struct cityEdit
+{
+  std::string change;
+  int city; // The city removed or moved, -1 for an insert.
+  float x;
+  float y;
+};
+
+//SolverDaemon: A long-lived solver that takes jobs over a Unix domain socket. A job is one message holding command line options, such as "-tsp file.tsp -maxIter 100 -b 5".
+//It is answered with "globBest:iterations:time:tour", or "ERROR:reason", which is also how an exception thrown by a job, such as a failed device allocation, is answered. Colonies are pooled by size class, so a job of a size seen before skips the allocation and the maps and keys.
+//A job given "-session name" keeps its colony hot under that name, and later jobs of the session carry on with it without -tsp. "EDIT name ..." moves, inserts and removes cities of a kept colony in place, and "DROP name" frees it.
+class SolverDaemon
+{
+ public:
+  SolverDaemon(std::string newSocketPath, int newMaxPooled); // Sets defaults. At most newMaxPooled colonies are kept between jobs.
+  ~SolverDaemon();
+  bool start(); // Binds and listens on the socket, replacing a stale one. Returns false if it cannot.
+  void serve(); // Answers jobs one at a time until a "STOP" job arrives.
+  static bool submit(std::string socketPath, std::string job, std::string& result); // Sends a job to a running daemon and waits for its answer.
+ private:
+  std::string solve(std::string job); // Runs one job and returns its answer.
+  std::string edit(std::string job); // Edits the cities of a kept colony and returns its answer.
+  std::string drop(std::string job); // Frees a kept colony.
+  void endSession(std::map<std::string, pooledColony*>::iterator kept); // Frees the colony of a session and forgets the session.
+  pooledColony* acquire(TSPReader& t, int numAnts, bool dense); // Returns the pooled colony of this size class with the instance copied in, building one if there is none.
+  void release(std::string sizeClass, pooledColony* pooled); // Returns a colony to the pool, dropping the least recently used one if the pool is full.
+  static std::string sizeClassOf(int numCities, int numAnts, bool dense);
+  static double now();
+  std::string socketPath;
+  int maxPooled;
+  int listener;
+  std::map<std::string, pooledColony*> pool;
+  std::list<std::string> recent; // Size classes in the pool, least recently used first.
+  std::map<std::string, pooledColony*> sessions; // Colonies kept hot by name, outside the pool, until dropped.
+};
+
+#endif
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
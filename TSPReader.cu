@@ -6,6 +6,86 @@
 
 #include "TSPReader.h"
 
+//blank: Checks for the whitespace that separates tokens.
+static inline bool blank(const char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+//digit: Checks for a decimal digit.
+static inline bool digit(const char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+//scanNumber: Reads the next number at or after p and leaves p just past it. Returns false if there is no number before end.
+static bool scanNumber(const char*& p, const char* end, double& value)
+{
+  static const double powers[] = {1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+  while(p < end && blank(*p)){
+    p++;
+  }
+  bool negative = false;
+  if(p < end && (*p == '-' || *p == '+')){
+    negative = *p == '-';
+    p++;
+  }
+  unsigned long long mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool any = false;
+  for(; p < end && digit(*p); p++){
+    any = true;
+    if(digits < 19){
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += mantissa != 0;
+    }else{
+      exponent++;
+    }
+  }
+  if(p < end && *p == '.'){
+    for(p++; p < end && digit(*p); p++){
+      any = true;
+      if(digits < 19){
+	mantissa = mantissa * 10 + (*p - '0');
+	digits += mantissa != 0;
+	exponent--;
+      }
+    }
+  }
+  if(!any){
+    return false;
+  }
+  if(p < end && (*p == 'e' || *p == 'E')){
+    p++;
+    bool negativeExponent = false;
+    if(p < end && (*p == '-' || *p == '+')){
+      negativeExponent = *p == '-';
+      p++;
+    }
+    int e = 0;
+    for(; p < end && digit(*p); p++){
+      if(e < 10000){
+	e = e * 10 + (*p - '0');
+      }
+    }
+    exponent += negativeExponent ? -e : e;
+  }
+  //exact when the mantissa fits a double and the power of ten is exact
+  value = (double)mantissa;
+  if(exponent < 0 && exponent >= -22){
+    value /= powers[-exponent];
+  }else if(exponent > 0 && exponent <= 22){
+    value *= powers[exponent];
+  }else if(exponent != 0){
+    value *= pow(10.0, exponent);
+  }
+  if(negative){
+    value = -value;
+  }
+  return true;
+}
+
 //destructor
 TSPReader::~TSPReader()
 {	
@@ -14,85 +94,400 @@ TSPReader::~TSPReader()
   delete[] Ycoords;
 }
 
-//read: Reads a given tsp file and extracts data.
-bool TSPReader::read(char* filen)
+//read: Reads a given tsp file and extracts data. The distance matrix is only built if dense is set or the file gives explicit weights.
+//The file is mapped into memory and numbers are streamed straight into their final arrays.
+bool TSPReader::read(char* filen, bool dense)
 {	
-  ifstream infile(filen, ios_base::in);
-  if(!infile){
+  int fd = open(filen, O_RDONLY);
+  struct stat info;
+  if(fd < 0 || fstat(fd, &info) < 0){
     cout << "\n" << "Unable to open file: " << filen << "\n";
+    if(fd >= 0){
+      close(fd);
+    }
     return false;
   }
-  string line;
+  if(caching){
+    cacheName = string(filen) + ".cache";
+    if(loadCache(dense, info)){
+      close(fd);
+      finishDistances();
+      return true;
+    }
+  }
+  size_t length = info.st_size;
+  void* data = length > 0 ? mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  if(data == MAP_FAILED){
+    cout << "\n" << "Unable to map file: " << filen << "\n";
+    return false;
+  }
+  madvise(data, length, MADV_SEQUENTIAL);
+  const char* begin = (const char*)data;
+  bool result = parse(begin, begin + length, dense);
+  munmap(data, length);
+  if(result && caching){
+    saveCache(info);
+  }
+  finishDistances();
+  return result;
+}
+
+//densify: Builds the distance matrix from the coordinates, if read was asked not to and the file did not give explicit weights.
+void TSPReader::densify()
+{
+  if(distances.size() == 0 && staging.size() == 0 && Xcoords != 0){
+    calculateDistances();
+    finishDistances();
+  }
+}
+
+//loadCache: Loads the instance from its binary cache, if the cache was built from the current source file and holds everything needed.
+bool TSPReader::loadCache(bool dense, const struct stat& source)
+{
+  int fd = open(cacheName.c_str(), O_RDONLY);
+  struct stat info;
+  if(fd < 0 || fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(CacheHeader)){
+    if(fd >= 0){
+      close(fd);
+    }
+    return false;
+  }
+  size_t length = info.st_size;
+  void* data = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(data == MAP_FAILED){
+    return false;
+  }
+  const CacheHeader* header = (const CacheHeader*)data;
+  const size_t n = header->numCities;
+  const size_t expected = sizeof(CacheHeader) + 2 * n * sizeof(float) + (header->hasDistances ? n * n * sizeof(float) : 0) + n * header->numCandidates * sizeof(int);
+  bool valid = memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+    header->version == CACHE_VERSION &&
+    header->sourceSize == (long long)source.st_size &&
+    header->sourceTime == (long long)source.st_mtime &&
+    (header->hasDistances || !(dense || header->explicitWeights)) &&
+    length >= expected;
+  if(valid){
+    madvise(data, length, MADV_SEQUENTIAL);
+    name = string(header->name, strnlen(header->name, sizeof(header->name)));
+    numCities = n;
+    explicitWeights = header->explicitWeights;
+    const float* X = (const float*)(header + 1);
+    const float* Y = X + n;
+    const float* D = Y + n;
+    const int* C = (const int*)(D + (header->hasDistances ? n * n : 0));
+    delete[] cityNames;
+    delete[] Xcoords;
+    delete[] Ycoords;
+    cityNames = new string [n];
+    Xcoords = new float [n];
+    Ycoords = new float [n];
+    memcpy(Xcoords, X, n * sizeof(float));
+    memcpy(Ycoords, Y, n * sizeof(float));
+    char label[16];
+    for(size_t i = 0; i < n; i++){
+      sprintf(label, "%d", (int)i + 1);
+      cityNames[i] = label;
+    }
+    if(header->hasDistances && (dense || explicitWeights) && n > 0){
+      memcpy(allocateDistances(), D, n * n * sizeof(float));
+    }
+    numCachedCandidates = header->numCandidates;
+    cachedCandidates.assign(C, C + n * numCachedCandidates);
+    cachedGreedy = header->greedyDistance;
+    cachedGreedyTour = header->greedyTour;
+  }
+  munmap(data, length);
+  return valid;
+}
+
+//saveCache: Writes the parsed instance to its binary cache. The file is written aside and renamed, so a cache is never seen half written.
+void TSPReader::saveCache(const struct stat& source)
+{
+  CacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+  header.version = CACHE_VERSION;
+  header.numCities = numCities;
+  header.sourceSize = source.st_size;
+  header.sourceTime = source.st_mtime;
+  const float* D = hostDistances();
+  header.hasDistances = D != 0;
+  header.explicitWeights = explicitWeights;
+  header.numCandidates = 0;
+  header.greedyDistance = -1;
+  strncpy(header.name, name.c_str(), sizeof(header.name) - 1);
+  string temp = cacheName + ".tmp";
+  FILE* f = fopen(temp.c_str(), "wb");
+  if(!f){
+    return;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+    fwrite(Xcoords, sizeof(float), numCities, f) == (size_t)numCities &&
+    fwrite(Ycoords, sizeof(float), numCities, f) == (size_t)numCities &&
+    (D == 0 || fwrite(D, sizeof(float), (size_t)numCities * numCities, f) == (size_t)numCities * numCities);
+  ok = fclose(f) == 0 && ok;
+  if(!ok || rename(temp.c_str(), cacheName.c_str()) != 0){
+    remove(temp.c_str());
+  }
+}
+
+//updateCache: Adds candidate lists and the greedy tour length computed by the Colony to the cache, if they are not in it already. A length built another way than the cached one replaces it.
+void TSPReader::updateCache(const thrust::host_vector<int>& candidates, int numCandidates, float greedyDistance, int greedyTour)
+{
+  if(!caching){
+    return;
+  }
+  int fd = open(cacheName.c_str(), O_RDWR);
+  if(fd < 0){
+    return;
+  }
+  CacheHeader header;
+  if(pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) && header.numCities == numCities){
+    const size_t n = numCities;
+    off_t offset = sizeof(CacheHeader) + 2 * n * sizeof(float) + (header.hasDistances ? n * n * sizeof(float) : 0);
+    bool changed = false;
+    if(numCandidates > 0 && numCandidates != header.numCandidates && candidates.size() == n * numCandidates){
+      size_t bytes = n * numCandidates * sizeof(int);
+      if(pwrite(fd, &candidates[0], bytes, offset) == (ssize_t)bytes && ftruncate(fd, offset + bytes) == 0){
+	header.numCandidates = numCandidates;
+	changed = true;
+      }
+    }
+    if(greedyDistance >= 0 && (header.greedyDistance < 0 || header.greedyTour != greedyTour)){
+      header.greedyDistance = greedyDistance;
+      header.greedyTour = greedyTour;
+      changed = true;
+    }
+    if(changed){
+      pwrite(fd, &header, sizeof(header), 0);
+    }
+  }
+  close(fd);
+}
+
+//parse: Parses a whole tsp file held in memory.
+bool TSPReader::parse(const char* p, const char* end, bool dense)
+{
   string tag;
   string value;
-  while(infile.good()){
-    getline(infile,line);
-    if(line.length() > 1){
-      if(!isprint(line[line.length()-1])) line.erase(line.length()-1,1);
-      if(line.find(":") != string::npos){
-	tag = line.substr(0,line.find(":"));
-	value = line.substr(line.find(":") + 1, line.length() - line.find(":") - 1);
-      }else{
-	tag = line;
-	value = "";
+  string weightType = "EUC_2D";
+  string weightFormat = "";
+  bool weights = false;
+  while(p < end){
+    const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+    if(lineEnd == 0){
+      lineEnd = end;
+    }
+    const char* colon = (const char*)memchr(p, ':', lineEnd - p);
+    tag.clear();
+    value.clear();
+    for(const char* c = p; c < (colon ? colon : lineEnd); c++){
+      if(!blank(*c)) tag += *c;
+    }
+    if(colon){
+      for(const char* c = colon + 1; c < lineEnd; c++){
+	if(!blank(*c)) value += *c;
       }
-      while(tag.find(" ") != string::npos){
-	tag.replace(tag.find(" "),1,"");
+    }
+    p = lineEnd + 1;
+    if(tag == "NAME"){
+      name = value;
+    }else if(tag == "TYPE"){
+      if(value != "TSP" && value != "STSP"){
+	cout << "\n" << "Invalid problem type: " << value << "\n";
+	return false;
+      }
+    }else if(tag == "DIMENSION"){
+      numCities = atoi(value.c_str());
+    }else if(tag == "EDGE_WEIGHT_TYPE"){
+      if(value != "EUC_2D" && value != "EXPLICIT"){
+	cout << "\n" << "Invalid edge weight type: " << value << "\n";
+	return false;
       }
-      while(value.find(" ") != string::npos){
-	value.replace(value.find(" "),1,"");
+      weightType = value;
+      explicitWeights = value == "EXPLICIT";
+    }else if(tag == "EDGE_WEIGHT_FORMAT"){
+      if(value != "FULL_MATRIX" && value != "UPPER_ROW" && value != "LOWER_DIAG_ROW"){
+	cout << "\n" << "Invalid edge weight format: " << value << "\n";
+	return false;
       }
-      if(tag == "NAME"){
-	name = value;
-      }else if(tag == "TYPE"){
-	if(value != "TSP" && value != "STSP"){
-	  cout << "\n" << "Invalid problem type: " << value << "\n";
-	  return false;
-	}
-      }else if(tag == "DIMENSION"){
-	numCities = atoi(value.c_str());
-      }else if(tag == "EDGE_WEIGHT_TYPE"){
-	if(value != "EUC_2D"){
-	  cout << "\n" << "Invalid edge weight type: " << value << "\n";
-	  return false;
-	}
-      }else if(tag == "NODE_COORD_SECTION"){
-	//Set coord arrays to appropriate lengths
-	cityNames = new string [numCities];
-	Xcoords = new float [numCities];
-	Ycoords = new float [numCities];
-	for(int i = 0; infile.good() && i < numCities; i++){
-	  getline(infile,line);
-	  if(!isprint(line[line.length()-1])) line.erase(line.length()-1,1);
-	  if(line == "EOF"){
-	    return false;
-	  }
-	  cityNames[i] = line.substr(0,line.find(" "));
-	  Xcoords[i] = atof(line.substr(line.find(" ") + 1, line.find_last_of(" ") - line.find(" ") - 1).c_str());
-	  Ycoords[i] = atof(line.substr(line.find_last_of(" ") + 1, line.length() - line.find_last_of(" ") - 1).c_str());
-	}
+      weightFormat = value;
+    }else if(tag == "NODE_COORD_SECTION" || tag == "DISPLAY_DATA_SECTION"){
+      if(!parseCoords(p, end)){
+	return false;
       }
-      if(line == "EOF"){
-        break;
+    }else if(tag == "EDGE_WEIGHT_SECTION"){
+      if(!parseWeights(p, end, weightFormat)){
+	return false;
       }
+      weights = true;
+    }else if(tag == "EOF"){
+      break;
+    }
+  }
+  if(weightType == "EXPLICIT"){
+    if(!weights){
+      cout << "\n" << "Missing EDGE_WEIGHT_SECTION\n";
+      return false;
+    }
+    if(Xcoords == 0){ //no display data, so the cities all sit at the origin
+      cityNames = new string [numCities];
+      Xcoords = new float [numCities]();
+      Ycoords = new float [numCities]();
+      char label[16];
+      for(int i = 0; i < numCities; i++){
+	sprintf(label, "%d", i + 1);
+	cityNames[i] = label;
+      }
+    }
+  }else{
+    if(Xcoords == 0){
+      cout << "\n" << "Missing NODE_COORD_SECTION\n";
+      return false;
+    }
+    if(dense){
+      calculateDistances();
     }
   }
-  calculateDistances();
   return true;
 }
 
-//calculateDistances: Calculates distances on the CPU.
-void TSPReader::calculateDistances(){
-  distances = thrust::host_vector<float> (numCities*numCities);
-  float k;
+//parseCoords: Streams a coordinate section into Xcoords and Ycoords.
+bool TSPReader::parseCoords(const char*& p, const char* end)
+{
+  delete[] cityNames;
+  delete[] Xcoords;
+  delete[] Ycoords;
+  cityNames = new string [numCities];
+  Xcoords = new float [numCities];
+  Ycoords = new float [numCities];
+  double x, y;
   for(int i = 0; i < numCities; i++){
-    for(int j = 0; j < numCities; j++){
-      k = sqrt(pow(Xcoords[i]-Xcoords[j],2)+pow(Ycoords[i]-Ycoords[j],2));
-      if(i == j)
-	k = std::numeric_limits<float>::max();
-      distances[i * numCities + j] = k;
+    while(p < end && blank(*p)){
+      p++;
+    }
+    const char* id = p;
+    while(p < end && !blank(*p)){
+      p++;
+    }
+    if(p == id || string(id, p) == "EOF" || !scanNumber(p, end, x) || !scanNumber(p, end, y)){
+      return false;
+    }
+    cityNames[i].assign(id, p - id);
+    Xcoords[i] = x;
+    Ycoords[i] = y;
+  }
+  return true;
+}
+
+//parseWeights: Streams an explicit edge weight section into the distance matrix.
+bool TSPReader::parseWeights(const char*& p, const char* end, string format)
+{
+  const size_t n = numCities;
+  float* d = allocateDistances();
+  double w;
+  for(size_t i = 0; i < n; i++){
+    size_t first = 0;
+    size_t last = n;
+    if(format == "UPPER_ROW"){
+      first = i + 1;
+    }else if(format == "LOWER_DIAG_ROW"){
+      last = i + 1;
+    }else if(format != "FULL_MATRIX"){
+      cout << "\n" << "Invalid edge weight format: " << format << "\n";
+      return false;
+    }
+    for(size_t j = first; j < last; j++){
+      if(!scanNumber(p, end, w)){
+	return false;
+      }
+      d[i * n + j] = w;
+      if(format != "FULL_MATRIX"){
+	d[j * n + i] = w;
+      }
+    }
+  }
+  for(size_t i = 0; i < n; i++){
+    d[i * n + i] = std::numeric_limits<float>::max();
+  }
+  return true;
+}
+
+//allocateDistances: Allocates the distance matrix and returns a host pointer to fill it through.
+//On host backends the device vector is host memory, so it is filled in place; on the GPU it is staged on the host.
+float* TSPReader::allocateDistances()
+{
+  size_t size = (size_t)numCities * numCities;
+#if THRUST_DEVICE_SYSTEM == THRUST_DEVICE_SYSTEM_CUDA
+  staging = thrust::host_vector<float>(size);
+  return size > 0 ? &staging[0] : 0;
+#else
+  distances = thrust::device_vector<float>(size);
+  return size > 0 ? thrust::raw_pointer_cast(&distances[0]) : 0;
+#endif
+}
+
+//hostDistances: Returns a host pointer to the filled distance matrix, or null if there is none.
+float* TSPReader::hostDistances()
+{
+#if THRUST_DEVICE_SYSTEM == THRUST_DEVICE_SYSTEM_CUDA
+  return staging.size() > 0 ? &staging[0] : 0;
+#else
+  return distances.size() > 0 ? thrust::raw_pointer_cast(&distances[0]) : 0;
+#endif
+}
+
+//finishDistances: Moves the filled matrix to the device, if it was not filled in place.
+void TSPReader::finishDistances()
+{
+  if(staging.size() > 0){
+    distances = staging;
+    thrust::host_vector<float>().swap(staging);
+  }
+}
+
+//calculateDistances: Calculates distances on the CPU. The upper triangle is computed once in square tiles, in parallel if OpenMP is enabled, and each tile is mirrored into the lower triangle while it is still in cache.
+void TSPReader::calculateDistances(){
+  float* d = allocateDistances();
+  if(numCities == 0){
+    return;
+  }
+  const float* X = Xcoords;
+  const float* Y = Ycoords;
+  const size_t n = numCities;
+  const int tile = 64;
+  const int numTiles = (numCities + tile - 1) / tile;
+#pragma omp parallel for schedule(dynamic)
+  for(int t = 0; t < numTiles * numTiles; t++){
+    const int bi = t / numTiles;
+    const int bj = t % numTiles;
+    if(bj < bi){
+      continue;
+    }
+    const int iEnd = min((bi + 1) * tile, numCities);
+    const int jEnd = min((bj + 1) * tile, numCities);
+    for(int i = bi * tile; i < iEnd; i++){
+      const float xi = X[i];
+      const float yi = Y[i];
+      float* row = d + i * n;
+      for(int j = (bi == bj) ? i + 1 : bj * tile; j < jEnd; j++){
+	const double dx = xi - X[j];
+	const double dy = yi - Y[j];
+	row[j] = sqrt(dx * dx + dy * dy);
+      }
+    }
+    for(int j = bj * tile; j < jEnd; j++){
+      float* column = d + j * n;
+      for(int i = bi * tile; i < iEnd && i < j; i++){
+	column[i] = d[i * n + j];
+      }
     }
   }
+  for(size_t i = 0; i < n; i++){
+    d[i * n + i] = std::numeric_limits<float>::max();
+  }
 }
 	
 string TSPReader::getName()
@@ -110,12 +505,75 @@ float* TSPReader::getYcoords()
   return Ycoords; 
 }
 	
+void TSPReader::setCache(bool newCaching)
+{
+  caching = newCaching;
+}
+
+thrust::host_vector<int>& TSPReader::getCandidates()
+{
+  return cachedCandidates;
+}
+
+int TSPReader::getNumCandidates()
+{
+  return numCachedCandidates;
+}
+
+//readTour: Reads the cities of a tour into tour. After a TOUR_SECTION line cities are 1-based and end at -1, as TSPLIB writes them. Without one the file is taken as 0-based cities separated by commas or whitespace.
+bool TSPReader::readTour(char* filen, thrust::host_vector<int>& tour)
+{
+  ifstream in(filen);
+  if(!in){
+    cout << "Unable to open tour " << filen << "\n";
+    return false;
+  }
+  tour.clear();
+  string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+  size_t start = text.find("TOUR_SECTION");
+  bool TSPLIB = start != string::npos;
+  const char* p = text.c_str() + (TSPLIB ? start + strlen("TOUR_SECTION") : 0);
+  while(*p){
+    if(!(isdigit(*p) || *p == '-')){
+      p++;
+      continue;
+    }
+    char* next;
+    long city = strtol(p, &next, 10);
+    if(next == p){
+      p++;
+      continue;
+    }
+    p = next;
+    if(TSPLIB && city < 0){
+      break;
+    }
+    tour.push_back(TSPLIB ? city - 1 : city);
+  }
+  if(tour.empty()){
+    cout << "No cities found in tour " << filen << "\n";
+    return false;
+  }
+  return true;
+}
+
+//getGreedyDistance: Returns the cached greedy tour length, unless it is unknown or its tour was built another way than greedyTour, since nearest neighbour and curve tours differ by about 10%.
+float TSPReader::getGreedyDistance(int greedyTour)
+{
+  return cachedGreedyTour == greedyTour ? cachedGreedy : -1;
+}
+
 int TSPReader::getNumNodes()
 { 
   return numCities;
 }
+
+bool TSPReader::getExplicitWeights()
+{
+  return explicitWeights;
+}
 	
-thrust::host_vector<float> TSPReader::getDistances()
+thrust::device_vector<float>& TSPReader::getDistances()
 { 
   return distances; 
 }
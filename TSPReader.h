@@ -9,12 +9,41 @@
 #include <iostream>	// Used for command line I/O
 #include <fstream>	// Used for file Input
 #include <string>
+#include <cstring>
+#include <cstdio>
 #include <math.h>
 #include <cctype>
+#include <cstdlib>
+#include <iterator>
 #include <float.h> // Used to find maximum float
+#include <algorithm>
+#include <fcntl.h>	// Used to map files into memory
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <thrust/host_vector.h>
+#include <thrust/device_vector.h>
 using namespace std;
 
+#define CACHE_MAGIC "EXANTSC"
+#define CACHE_VERSION 2
+
+//CacheHeader: The start of a binary instance cache. It is followed by numCities X coords, numCities Y coords, the numCities*numCities distance matrix if hasDistances is set, and numCities*numCandidates candidate lists.
+struct CacheHeader
+{
+  char magic[8];
+  int version;
+  int numCities;
+  long long sourceSize; // Size of the .tsp file the cache was built from.
+  long long sourceTime; // Modification time of the .tsp file the cache was built from.
+  int hasDistances;
+  int explicitWeights;
+  int numCandidates;
+  float greedyDistance; // Negative if unknown.
+  int greedyTour; // How the tour of greedyDistance was built, TOUR_NEAREST or TOUR_CURVE of Colony.h.
+  char name[64];
+};
+
 //TSPReader: Used to read .tsp files.
 class TSPReader
 {	
@@ -23,21 +52,45 @@ class TSPReader
   float* Xcoords;		// X coords
   float* Ycoords;		// Y coords
   string* cityNames;
-  thrust::host_vector<float> distances;	// Distances between cities
+  thrust::device_vector<float> distances;	// Distances between cities
+  thrust::host_vector<float> staging;	// Host copy of distances, only used when the device cannot be written from the host
+  bool explicitWeights;	// Set if the distances came from an EDGE_WEIGHT_SECTION rather than coordinates
+  bool caching;			// Set if instances are read from and saved to a binary cache next to the .tsp file
+  string cacheName;
+  thrust::host_vector<int> cachedCandidates;	// Candidate lists found in the cache
+  int numCachedCandidates;
+  float cachedGreedy;		// Greedy tour length found in the cache, negative if unknown
+  int cachedGreedyTour;		// How the tour of cachedGreedy was built
 	
  public:
   //Constructors/Destructors
-  TSPReader(){}
+  TSPReader() : numCities(0), Xcoords(0), Ycoords(0), cityNames(0), explicitWeights(false), caching(false), numCachedCandidates(0), cachedGreedy(-1), cachedGreedyTour(0) {}
   ~TSPReader();
 	
 
-  bool read(char* filen);	// Reads a given tsp file and extracts data.
+  bool read(char* filen, bool dense = true);	// Reads a given tsp file and extracts data. The distance matrix is only built if dense is set or the file gives explicit weights.
+  void densify(); // Builds the distance matrix from the coordinates, if read left it out.
   string getName();
   float* getXcoords();
   float* getYcoords();
   int getNumNodes();
-  thrust::host_vector<float> getDistances();
+  bool getExplicitWeights(); // Returns true if the distances came from an EDGE_WEIGHT_SECTION, so the coordinates say nothing about them.
+  thrust::device_vector<float>& getDistances(); // Returns the distance matrix itself, so that colonies can read it without a copy.
+  void setCache(bool newCaching); // If set, read uses and refreshes the binary cache <file>.cache.
+  thrust::host_vector<int>& getCandidates(); // Candidate lists from the cache, empty if none.
+  int getNumCandidates();
+  float getGreedyDistance(int greedyTour); // Greedy tour length from the cache, negative if none was built the way greedyTour asks.
+  void updateCache(const thrust::host_vector<int>& candidates, int numCandidates, float greedyDistance, int greedyTour); // Adds what the Colony computed to the cache.
+  static bool readTour(char* filen, thrust::host_vector<int>& tour); // Reads a TSPLIB .tour file, or a list of 0-based cities as Setup prints them. Returns false if no cities are found.
  private:
+  bool parse(const char* p, const char* end, bool dense); // Parses a whole tsp file held in memory.
+  bool parseCoords(const char*& p, const char* end); // Streams a coordinate section into Xcoords and Ycoords.
+  bool parseWeights(const char*& p, const char* end, string format); // Streams an explicit edge weight section into the distance matrix.
+  bool loadCache(bool dense, const struct stat& source); // Loads the instance from its cache, if the cache matches the source file.
+  void saveCache(const struct stat& source); // Writes the parsed instance to its cache.
+  float* allocateDistances(); // Allocates the distance matrix and returns a host pointer to fill it through.
+  float* hostDistances(); // Returns a host pointer to the filled distance matrix, or null if there is none.
+  void finishDistances(); // Moves the filled matrix to the device, if it was not filled in place.
   void calculateDistances(); // Calculates distances on the CPU.
 };
 
@@ -0,0 +1,126 @@
+/****************************************
+ * TourSnapshot.cpp                     *
+ * Peter Ahrens                         *
+ * Shares the best tour with the GUI    *
+ ****************************************/
+
+#include "TourSnapshot.h"
+
+//Constructor: Sets defaults. Nothing is shared until open.
+TourSnapshot::TourSnapshot()
+{
+  numCities = 0;
+  rate = 20;
+  lastPublish = -1;
+  slotBytes = 0;
+  regionBytes = 0;
+  region = NULL;
+}
+
+//Destructor: Unmaps and removes the region. A reader that has it mapped keeps its copy.
+TourSnapshot::~TourSnapshot()
+{
+  if(region){
+    munmap(region, regionBytes);
+    shm_unlink(name.c_str());
+  }
+}
+
+//open: Creates the region under /dev/shm, replacing a stale one, and writes the header. Returns false if it cannot.
+bool TourSnapshot::open(string newName, int newNumCities, string TSPFile, string TSPName)
+{
+  name = newName[0] == '/' ? newName : "/" + newName;
+  numCities = newNumCities;
+  slotBytes = (sizeof(snapshotSlot) + numCities * sizeof(int) + 7) / 8 * 8;
+  regionBytes = sizeof(snapshotHeader) + 2 * slotBytes;
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+  if(fd < 0 || ftruncate(fd, regionBytes) < 0){
+    cout << "Unable to create shared memory " << name << "\n";
+    if(fd >= 0){
+      close(fd);
+    }
+    return false;
+  }
+  void* mapped = mmap(NULL, regionBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(mapped == MAP_FAILED){
+    cout << "Unable to map shared memory " << name << "\n";
+    shm_unlink(name.c_str());
+    return false;
+  }
+  region = (char*)mapped;
+  memset(region, 0, regionBytes);
+  snapshotHeader* header = (snapshotHeader*)region;
+  header->numCities = numCities;
+  header->latest = -1;
+  strncpy(header->TSPFile, TSPFile.c_str(), SNAPSHOT_PATH - 1);
+  strncpy(header->TSPName, TSPName.c_str(), SNAPSHOT_NAME - 1);
+  __sync_synchronize();
+  memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)); //written last, so a reader never sees a half written header
+  return true;
+}
+
+void TourSnapshot::setRate(double newRate)
+{
+  rate = newRate;
+}
+
+//due: Returns true if a publish at time would keep to the rate.
+bool TourSnapshot::due(double time)
+{
+  return region && (rate <= 0 || lastPublish < 0 || time - lastPublish >= 1 / rate);
+}
+
+//publish: Fills the slot not last published, marking it odd while it is written, then makes it the latest.
+void TourSnapshot::publish(int iteration, double iterBest, double globBest, double time, const thrust::host_vector<int>& tour)
+{
+  if(!region){
+    return;
+  }
+  snapshotHeader* header = (snapshotHeader*)region;
+  int k = header->latest == 0 ? 1 : 0;
+  snapshotSlot* s = slot(k);
+  s->sequence++;
+  __sync_synchronize();
+  s->iteration = iteration;
+  s->iterBest = iterBest;
+  s->globBest = globBest;
+  s->time = time;
+  memcpy((char*)s + sizeof(snapshotSlot), &tour[0], min((size_t)numCities, tour.size()) * sizeof(int));
+  __sync_synchronize();
+  s->sequence++;
+  __sync_synchronize();
+  header->latest = k;
+  lastPublish = time;
+}
+
+//finish: Tells readers that the solver is done, so the last snapshot is final.
+void TourSnapshot::finish()
+{
+  if(region){
+    __sync_synchronize();
+    ((snapshotHeader*)region)->done = 1;
+  }
+}
+
+string TourSnapshot::getName()
+{
+  return name;
+}
+
+snapshotSlot* TourSnapshot::slot(int k)
+{
+  return (snapshotSlot*)(region + sizeof(snapshotHeader) + k * slotBytes);
+}
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
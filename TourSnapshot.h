@@ -0,0 +1,83 @@
+/****************************************
+ * TourSnapshot.h                       *
+ * Peter Ahrens                         *
+ * Shares the best tour with the GUI    *
+ ****************************************/
+
+#ifndef TOURSNAPSHOT_H
+#define TOURSNAPSHOT_H
+#include <thrust/host_vector.h>
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using namespace std;
+
+//Snapshot Values
+#define SNAPSHOT_MAGIC "EXSNAP01" // First 8 bytes of the region.
+#define SNAPSHOT_PATH 256 // Bytes kept for the path of the .tsp file.
+#define SNAPSHOT_NAME 64 // Bytes kept for the name of the instance.
+
+//snapshotHeader: Starts the shared region. Display.py reads the same layout with struct format "<8s4i256s64s".
+struct snapshotHeader
+{
+  char magic[8];
+  int numCities;
+  int latest; // The slot last published, -1 before the first.
+  int done; // Set once the solver has finished.
+  int spare;
+  char TSPFile[SNAPSHOT_PATH];
+  char TSPName[SNAPSHOT_NAME];
+};
+
+//snapshotSlot: One of the two buffers, followed in the region by numCities ints of tour. Display.py reads it with struct format "<Ii3d".
+//sequence is odd while the slot is being written, so a reader that sees it change or odd retries.
+struct snapshotSlot
+{
+  unsigned int sequence;
+  int iteration;
+  double iterBest;
+  double globBest;
+  double time;
+};
+
+//TourSnapshot: A POSIX shared memory region holding two copies of the best tour and the iteration stats, which the GUI reads without any file I/O or pipe.
+//Each publish fills the slot not last published and then points latest at it, so a reader always finds one complete snapshot. Publishes are limited to rate per second.
+class TourSnapshot
+{
+ public:
+  TourSnapshot(); // Sets defaults. Nothing is shared until open.
+  ~TourSnapshot(); // Unmaps and removes the region.
+  bool open(string newName, int numCities, string TSPFile, string TSPName); // Creates the region under /dev/shm/newName. Returns false if it cannot.
+  void setRate(double newRate); // Publishes at most newRate times a second. 0 publishes every time.
+  bool due(double time); // Returns true if enough time has passed since the last publish, with time counted from the same start as publish's.
+  void publish(int iteration, double iterBest, double globBest, double time, const thrust::host_vector<int>& tour); // Copies the stats and tour into the free slot and makes it the latest.
+  void finish(); // Tells readers the solver is done.
+  string getName();
+ private:
+  snapshotSlot* slot(int k); // Returns slot k of the region.
+  string name;
+  int numCities;
+  double rate;
+  double lastPublish;
+  size_t slotBytes;
+  size_t regionBytes;
+  char* region;
+};
+
+#endif
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
@@ -0,0 +1,189 @@
+/****************************************
+ * TraceLog.cpp                         *
+ * Peter Ahrens                         *
+ * Logs iterations off the main thread  *
+ ****************************************/
+
+#include "TraceLog.h"
+
+//Constructor: Sets defaults. Every iteration is kept and nothing is traced.
+TraceLog::TraceLog(Writer& newO) : O ( newO )
+{
+  trace = NULL;
+  every = 1;
+  improvedOnly = false;
+  quiet = false;
+  lastBest = -1;
+  running = false;
+  stopping = false;
+  head = 0;
+  tail = 0;
+  dropped = 0;
+}
+
+//Destructor: Stops the drain thread if it is running and closes the trace.
+TraceLog::~TraceLog()
+{
+  stop();
+  if(trace){
+    fclose(trace);
+  }
+}
+
+void TraceLog::setSampling(int newEvery, bool newImprovedOnly)
+{
+  every = newEvery > 0 ? newEvery : 1;
+  improvedOnly = newImprovedOnly;
+}
+
+//setTrace: Opens a binary trace file that every kept record is also written to. Returns false if it cannot be opened.
+bool TraceLog::setTrace(std::string filen)
+{
+  trace = fopen(filen.c_str(), "wb");
+  if(!trace){
+    cout << "Unable to open trace file " << filen << "\n";
+    return false;
+  }
+  return true;
+}
+
+void TraceLog::setQuiet(bool newQuiet)
+{
+  quiet = newQuiet;
+}
+
+//start: Writes the Writer header and the trace header, then starts the drain thread. Returns false if the thread cannot be started, in which case log does nothing.
+bool TraceLog::start(float beta, float rho, int numAnts, std::string ACO, std::string TSPName, bool localSearch, bool convergence)
+{
+  O.writeHeader(beta, rho, numAnts, ACO, TSPName, localSearch, convergence);
+  if(trace){
+    traceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.beta = beta;
+    header.rho = rho;
+    header.numAnts = numAnts;
+    header.localSearch = localSearch;
+    header.convergence = convergence;
+    strncpy(header.ACO, ACO.c_str(), sizeof(header.ACO) - 1);
+    strncpy(header.TSPName, TSPName.c_str(), sizeof(header.TSPName) - 1);
+    fwrite(&header, sizeof(header), 1, trace);
+  }
+  stopping = false;
+  running = pthread_create(&thread, NULL, drainThread, this) == 0;
+  if(!running){
+    cout << "Unable to start the log thread\n";
+  }
+  return running;
+}
+
+//log: Queues a record if sampling keeps it or force is set. The slot is filled before head is published, so the drain thread never reads a half written record. A full ring drops a sampled record instead of waiting, but a forced one waits for the drain thread to free a slot.
+void TraceLog::log(int iter, double iterBest, double globBest, double time, double iterTime, double localSearchTime, double branching, double similarity, bool force)
+{
+  bool improved = lastBest < 0 || globBest < lastBest;
+  lastBest = globBest;
+  if(!running || !(force || (improvedOnly ? improved : iter % every == 0))){
+    return;
+  }
+  while(head - __atomic_load_n(&tail, __ATOMIC_ACQUIRE) >= TRACE_RING){
+    if(!force){
+      dropped++;
+      return;
+    }
+    usleep(TRACE_IDLE_US);
+  }
+  traceRecord& record = ring[head & (TRACE_RING - 1)];
+  record.iter = iter;
+  record.spare = 0;
+  record.iterBest = iterBest;
+  record.globBest = globBest;
+  record.time = time;
+  record.iterTime = iterTime;
+  record.localSearchTime = localSearchTime;
+  record.branching = branching;
+  record.similarity = similarity;
+  __atomic_store_n(&head, head + 1, __ATOMIC_RELEASE);
+}
+
+//stop: Tells the drain thread to finish, waits for it to write what is left, and reports any dropped records.
+void TraceLog::stop()
+{
+  if(!running){
+    return;
+  }
+  __atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+  pthread_join(thread, NULL);
+  running = false;
+  if(trace){
+    fflush(trace);
+  }
+  if(dropped > 0){
+    cout << dropped << " log records dropped while the log was full\n";
+  }
+}
+
+void* TraceLog::drainThread(void* arg)
+{
+  TraceLog* log = (TraceLog*)arg;
+  while(true){
+    bool last = __atomic_load_n(&log->stopping, __ATOMIC_ACQUIRE); //read before draining, so nothing queued before stop is missed
+    log->drain();
+    if(last){
+      break;
+    }
+    usleep(TRACE_IDLE_US);
+  }
+  return NULL;
+}
+
+//drain: Writes every queued record to the trace and the Writer, then frees their slots.
+void TraceLog::drain()
+{
+  unsigned long end = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+  for(unsigned long r = tail; r < end; r++){
+    traceRecord& record = ring[r & (TRACE_RING - 1)];
+    if(trace){
+      fwrite(&record, sizeof(record), 1, trace);
+    }
+    if(!quiet){
+      O.write(record.iter, record.iterBest, record.globBest, record.time, record.iterTime, record.localSearchTime, record.branching, record.similarity);
+    }
+    __atomic_store_n(&tail, r + 1, __ATOMIC_RELEASE);
+  }
+}
+
+//convert: Reads a binary trace and writes it to O as if it had been logged there, header first. Returns false if the file is missing or not a trace.
+bool TraceLog::convert(std::string filen, Writer& O)
+{
+  FILE* f = fopen(filen.c_str(), "rb");
+  if(!f){
+    cout << "Unable to open trace file " << filen << "\n";
+    return false;
+  }
+  traceHeader header;
+  if(fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0){
+    cout << filen << " is not a trace file\n";
+    fclose(f);
+    return false;
+  }
+  header.ACO[sizeof(header.ACO) - 1] = '\0';
+  header.TSPName[sizeof(header.TSPName) - 1] = '\0';
+  O.writeHeader(header.beta, header.rho, header.numAnts, header.ACO, header.TSPName, header.localSearch, header.convergence);
+  traceRecord record;
+  while(fread(&record, sizeof(record), 1, f) == 1){
+    O.write(record.iter, record.iterBest, record.globBest, record.time, record.iterTime, record.localSearchTime, record.branching, record.similarity);
+  }
+  fclose(f);
+  return true;
+}
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
@@ -0,0 +1,91 @@
+/****************************************
+ * TraceLog.h                           *
+ * Peter Ahrens                         *
+ * Logs iterations off the main thread  *
+ ****************************************/
+
+#ifndef TRACELOG_H
+#define TRACELOG_H
+#include "Writer.h"
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <pthread.h>
+#include <unistd.h>
+
+//Trace Values
+#define TRACE_RING 4096 // Records the ring holds, a power of two. When it is full, sampled records are dropped rather than waited on, forced ones wait for a free slot.
+#define TRACE_MAGIC "EXTRACE2" // First 8 bytes of a trace file.
+#define TRACE_IDLE_US 1000 // How long the drain thread sleeps when the ring is empty.
+
+//traceHeader: Starts a trace file, holding what Writer::writeHeader prints.
+struct traceHeader
+{
+  char magic[8];
+  float beta;
+  float rho;
+  int numAnts;
+  int localSearch;
+  int convergence; // Set if the records carry the convergence metrics.
+  char ACO[32];
+  char TSPName[64];
+};
+
+//traceRecord: One iteration in a trace file, the arguments of Writer::write.
+struct traceRecord
+{
+  int iter;
+  int spare;
+  double iterBest;
+  double globBest;
+  double time;
+  double iterTime;
+  double localSearchTime; // Negative if there is no local search.
+  double branching; // Negative if convergence is not measured.
+  double similarity;
+};
+
+//TraceLog: Takes the per-iteration output of the main loop into a single producer, single consumer ring, and writes it to a Writer and an optional binary trace on a background thread.
+//log only blocks for a forced record when the ring is full, and never touches stdout or the disk. Records can be sampled every Nth iteration or only when the global best improves.
+class TraceLog
+{
+ public:
+  TraceLog(Writer& newO); // Sets defaults. Records go to newO once start is called.
+  ~TraceLog(); // Stops the drain thread if it is running.
+  void setSampling(int newEvery, bool newImprovedOnly); // Keeps every newEvery'th iteration, or if newImprovedOnly is set only those that improve the global best.
+  bool setTrace(std::string filen); // Also writes every kept record to a binary trace file. Returns false if it cannot be opened.
+  void setQuiet(bool newQuiet); // Leaves the records out of the Writer, so only the trace is written.
+  bool start(float beta, float rho, int numAnts, std::string ACO, std::string TSPName, bool localSearch, bool convergence = false); // Writes the headers and starts the drain thread.
+  void log(int iter, double iterBest, double globBest, double time, double iterTime, double localSearchTime = -1, double branching = -1, double similarity = -1, bool force = false); // Queues a record if sampling keeps it or force is set. A forced record is never dropped. Called from the main loop only.
+  void stop(); // Drains what is left and joins the drain thread.
+  static bool convert(std::string filen, Writer& O); // Writes a binary trace to O in the usual header and CSV layout.
+ private:
+  static void* drainThread(void* arg);
+  void drain(); // Writes every queued record. Called from the drain thread only.
+  Writer& O;
+  FILE* trace;
+  int every;
+  bool improvedOnly;
+  bool quiet;
+  double lastBest;
+  bool running;
+  bool stopping; // Set by stop, read by the drain thread.
+  pthread_t thread;
+  traceRecord ring[TRACE_RING];
+  unsigned long head; // Records pushed, only written by the main thread.
+  unsigned long tail; // Records drained, only written by the drain thread.
+  unsigned long dropped;
+};
+
+#endif
+
+//Copyright (c) 2012, Peter Ahrens
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//
+//    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//    Neither the name of Excellants nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
@@ -36,7 +36,7 @@ bool Writer::setFile(char* filen)
 }
 
 //writeHeader: Writes a header to the file and (if in writing mode) to the file.
-void Writer::writeHeader(float beta, float rho, int numAnts, string ACO, string TSPName)
+void Writer::writeHeader(float beta, float rho, int numAnts, string ACO, string TSPName, bool localSearch, bool convergence)
 {
   time_t rawtime;
   time ( &rawtime );
@@ -46,23 +46,70 @@ void Writer::writeHeader(float beta, float rho, int numAnts, string ACO, string
       "ACO: " << ACO << "\n" <<
       "numAnts: " << numAnts << "\n" << 
       "Alpha: 1 " << "Beta: " << beta << " Rho: " << rho << "\n" <<
-      "Iteration, Iteration_Best, Global_Best, Time, Iteration_Time\n" << flush;
+      "Iteration, Iteration_Best, Global_Best, Time, Iteration_Time" << (localSearch ? ", Local_Search_Time" : "") << (convergence ? ", Branching, Similarity" : "") << "\n" << flush;
   }
   cout << "\n" << "Date: " << ctime (&rawtime) <<
     "TSP: " << TSPName << "\n" <<
     "ACO: " << ACO << "\n" <<
     "numAnts: " << numAnts << "\n" << 
     "Alpha: 1 " << "Beta: " << beta << " Rho: " << rho << "\n" <<
-    std::left << setw(10) << "Iteration"<< setw(10) << "Iter_Best" << setw(10) << "Glob_Best" << setw(10) << "Time" << setw(10) << "Iter_Time" << "\n";
+    std::left << setw(10) << "Iteration"<< setw(10) << "Iter_Best" << setw(10) << "Glob_Best" << setw(10) << "Time" << setw(10) << "Iter_Time";
+  if(localSearch){
+    cout << setw(10) << "LS_Time";
+  }
+  if(convergence){
+    cout << setw(10) << "Branching" << setw(10) << "Similarity";
+  }
+  cout << "\n";
+}
+
+//write: Writes a standard line of output to stdout and (if in writing mode) to the file. The convergence metrics follow the local search time, if they are given.
+void Writer::write(int iter, double iterBest, double globBest, double time, double iterTime, double localSearchTime, double branching, double similarity)
+{
+  if(writing){
+    f << iter << "," << iterBest << "," << globBest << "," << time << "," << iterTime;
+    if(localSearchTime >= 0){
+      f << "," << localSearchTime;
+    }
+    if(branching >= 0){
+      f << "," << branching << "," << similarity;
+    }
+    f << "\n" << flush;
+  }
+  cout << std::left << setw(10) << iter << setw(10) << iterBest << setw(10) << globBest << setw(10) << time << setw(10) << iterTime;
+  if(localSearchTime >= 0){
+    cout << setw(10) << localSearchTime;
+  }
+  if(branching >= 0){
+    cout << setw(10) << branching << setw(10) << similarity;
+  }
+  cout << "\n";
+}
+
+void Writer::writeRecordHeader(float beta, float rho, int numAnts, string ACO)
+{
+  time_t rawtime;
+  time ( &rawtime );
+  if(writing){
+    f << "\n" << "Date: " << ctime (&rawtime) <<
+      "ACO: " << ACO << "\n" <<
+      "numAnts: " << numAnts << "\n" <<
+      "Alpha: 1 " << "Beta: " << beta << " Rho: " << rho << "\n" <<
+      "TSP, Cities, Global_Best, Iterations, Time, Tour" << "\n" << flush;
+  }
+  cout << "\n" << "Date: " << ctime (&rawtime) <<
+    "ACO: " << ACO << "\n" <<
+    "numAnts: " << numAnts << "\n" <<
+    "Alpha: 1 " << "Beta: " << beta << " Rho: " << rho << "\n" <<
+    std::left << setw(20) << "TSP" << setw(10) << "Cities" << setw(10) << "Glob_Best" << setw(10) << "Iterations" << setw(10) << "Time" << "\n";
 }
 
-//write: Writes a standard line of output to stdout and (if in writing mode) to the file.
-void Writer::write(int iter, double iterBest, double globBest, double time, double iterTime)
+void Writer::writeRecord(string TSPName, int numCities, double globBest, int iterations, double time, string tour)
 {
   if(writing){
-    f << iter << "," << iterBest << "," << globBest << "," << time << "," << iterTime << "\n" << flush;
+    f << TSPName << "," << numCities << "," << globBest << "," << iterations << "," << time << "," << tour << "\n" << flush;
   }
-  cout << std::left << setw(10) << iter << setw(10) << iterBest << setw(10) << globBest << setw(10) << time << setw(10) << iterTime << "\n";
+  cout << std::left << setw(20) << TSPName << setw(10) << numCities << setw(10) << globBest << setw(10) << iterations << setw(10) << time << "\n";
 }
 
 //Copyright (c) 2012, Peter Ahrens
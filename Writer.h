@@ -20,8 +20,10 @@ class Writer
   Writer(char* filen); // Sets defaults and opens the given file.
   ~Writer();
   bool setFile(char* filen); // Tries to open given file. If it does, it is changed to writing mode.
-  void writeHeader(float beta, float rho, int numAnts,string ACO, string TSPName); // Writes a header to the file and (if in writing mode) to the file.
-  void write(int iter, double iterBest, double globBest, double time, double iterTime); // Writes a standard line of output to stdout and (if in writing mode) to the file.
+  void writeHeader(float beta, float rho, int numAnts,string ACO, string TSPName, bool localSearch = false, bool convergence = false); // Writes a header to the file and (if in writing mode) to the file. The convergence columns are only named if convergence is set.
+  void writeRecordHeader(float beta, float rho, int numAnts, string ACO); // Writes a header for batch records to stdout and (if in writing mode) to the file.
+  void writeRecord(string TSPName, int numCities, double globBest, int iterations, double time, string tour); // Writes the record of one solved instance to stdout and (if in writing mode) to the file. The tour only goes to the file.
+  void write(int iter, double iterBest, double globBest, double time, double iterTime, double localSearchTime = -1, double branching = -1, double similarity = -1); // Writes a standard line of output to stdout and (if in writing mode) to the file. A negative localSearchTime, or branching and similarity, are left out.
  private:
   char* fileName;
   ofstream f; // this is the file